@@ -5,7 +5,8 @@ if ! vk_installed=$(which glslc > /dev/null 2>&1); then
     exit 1;
 fi
 
-if [ ! -f external/glfw-3.4.bin.WIN64/lib-mingw-w64/glfw3.dll ]; then
+# GLFW is only vendored on Windows, other platforms link the system library
+if [ "$OS" == "Windows_NT" ] && [ ! -f external/glfw-3.4.bin.WIN64/lib-mingw-w64/glfw3.dll ]; then
     echo "GLFW library not found, run 'make download'";
     exit 1;
 fi
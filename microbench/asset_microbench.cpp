@@ -0,0 +1,482 @@
+// CPU-only microbenchmarks for the asset pipeline hot paths and per frame CPU culling. Inputs are generated, so no assets or GPU are needed.
+// Each case runs one untimed warmup, then timed repetitions until both a minimum count and a minimum wall time are reached.
+// Throughput is reported as mean +/- the 95% confidence interval over the repetitions.
+
+#include "frustum.hpp"
+#include "geometry.hpp"
+#include "geometry_private.hpp"
+#include "vk_image_private.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace asset_microbench {
+    struct Settings {
+        size_t min_repetitions;
+        size_t max_repetitions;
+        double min_seconds;
+        uint64_t max_triangles;
+        uint32_t max_image_size;
+        std::string filter;
+        std::string json_path;
+    };
+
+    struct Result {
+        std::string name;
+        std::string unit;
+        size_t repetitions;
+        // Throughput per repetition, in units per second
+        double mean;
+        double stddev;
+        double ci95;
+        double best_seconds;
+    };
+
+    // Stops the optimizer from dropping work whose result is otherwise unused
+    volatile uint64_t sink = 0;
+
+    void print_usage(const char* program) {
+        printf("Usage: %s [options]\n", program);
+        printf("  --quick                  Fewer sizes and shorter runs, for a fast sanity check\n");
+        printf("  --max-triangles <n>      Skip geometry cases above n triangles (default 10000000)\n");
+        printf("  --max-image <n>          Skip image cases above n x n pixels (default 8192)\n");
+        printf("  --min-reps <n>           Minimum timed repetitions per case (default 5)\n");
+        printf("  --min-time <seconds>     Minimum timed wall time per case (default 1.0)\n");
+        printf("  --filter <substring>     Only run cases whose name contains substring\n");
+        printf("  --json <path>            Also write the results as JSON\n");
+        printf("  --help                   Show this message\n");
+    }
+
+    uint64_t parse_unsigned(const char* flag, const char* value) {
+        char* end = nullptr;
+        unsigned long long parsed = strtoull(value, &end, 10);
+        if (end == value || *end != '\0') {
+            printf("%s expects a non-negative integer, got '%s'\n", flag, value);
+            exit(EXIT_FAILURE);
+        }
+        return static_cast<uint64_t>(parsed);
+    }
+
+    Settings parse_settings(int argc, char** argv) {
+        Settings settings = {
+            .min_repetitions = 5,
+            .max_repetitions = 200,
+            .min_seconds = 1.0,
+            .max_triangles = 10000000,
+            .max_image_size = 8192,
+            .filter = "",
+            .json_path = ""
+        };
+
+        for (int arg = 1; arg < argc; ++arg) {
+            auto value = [&](const char* flag) {
+                if (arg + 1 >= argc) {
+                    printf("%s expects a value\n", flag);
+                    exit(EXIT_FAILURE);
+                }
+                return argv[++arg];
+            };
+
+            if (strcmp(argv[arg], "--quick") == 0) {
+                settings.min_repetitions = 3;
+                settings.min_seconds = 0.2;
+                settings.max_triangles = 100000;
+                settings.max_image_size = 1024;
+            }
+            else if (strcmp(argv[arg], "--max-triangles") == 0) {
+                settings.max_triangles = parse_unsigned("--max-triangles", value("--max-triangles"));
+            }
+            else if (strcmp(argv[arg], "--max-image") == 0) {
+                settings.max_image_size = static_cast<uint32_t>(parse_unsigned("--max-image", value("--max-image")));
+            }
+            else if (strcmp(argv[arg], "--min-reps") == 0) {
+                // At least two repetitions are needed for a spread
+                settings.min_repetitions = std::max<size_t>(2, parse_unsigned("--min-reps", value("--min-reps")));
+                settings.max_repetitions = std::max(settings.max_repetitions, settings.min_repetitions);
+            }
+            else if (strcmp(argv[arg], "--min-time") == 0) {
+                settings.min_seconds = atof(value("--min-time"));
+            }
+            else if (strcmp(argv[arg], "--filter") == 0) {
+                settings.filter = value("--filter");
+            }
+            else if (strcmp(argv[arg], "--json") == 0) {
+                settings.json_path = value("--json");
+            }
+            else if (strcmp(argv[arg], "--help") == 0) {
+                print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            else {
+                printf("Unknown option %s\n", argv[arg]);
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        return settings;
+    }
+
+    // Two sided 97.5% quantile of Student's t distribution, for 1 through 30 degrees of freedom
+    double t_quantile_975(const size_t degrees_of_freedom) {
+        static const double table[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+        };
+        if (degrees_of_freedom == 0) {
+            return 0.0;
+        }
+        if (degrees_of_freedom <= 30) {
+            return table[degrees_of_freedom - 1];
+        }
+        return 1.960;
+    }
+
+    // Times body repeatedly. work is how many units one call of body processes, e.g. triangles or bytes
+    bool run_case(const Settings& settings, std::vector<Result>& results, const std::string& name, const std::string& unit, const double work, const std::function<void()>& body) {
+        if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos) {
+            return false;
+        }
+
+        // Warmup, to fault in pages and settle the allocator
+        body();
+
+        std::vector<double> seconds;
+        double total_seconds = 0.0;
+        while (seconds.size() < settings.max_repetitions && (seconds.size() < settings.min_repetitions || total_seconds < settings.min_seconds)) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto end = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(end - start).count();
+            seconds.push_back(elapsed);
+            total_seconds += elapsed;
+        }
+
+        Result result = {};
+        result.name = name;
+        result.unit = unit;
+        result.repetitions = seconds.size();
+        result.best_seconds = seconds[0];
+        for (double elapsed : seconds) {
+            result.mean += work / elapsed;
+            result.best_seconds = std::min(result.best_seconds, elapsed);
+        }
+        result.mean /= static_cast<double>(seconds.size());
+        double variance = 0.0;
+        for (double elapsed : seconds) {
+            double deviation = work / elapsed - result.mean;
+            variance += deviation * deviation;
+        }
+        variance /= static_cast<double>(seconds.size() - 1);
+        result.stddev = std::sqrt(variance);
+        result.ci95 = t_quantile_975(seconds.size() - 1) * result.stddev / std::sqrt(static_cast<double>(seconds.size()));
+
+        printf("%-36s %12.3f M%s/s +/- %5.1f%%  (n=%zu, best %.3fms)\n",
+            name.c_str(), result.mean / 1e6, unit.c_str(),
+            result.mean > 0.0 ? 100.0 * result.ci95 / result.mean : 0.0,
+            result.repetitions, result.best_seconds * 1000.0);
+        fflush(stdout);
+        results.push_back(result);
+        return true;
+    }
+
+    void write_json(const std::string& path, const std::vector<Result>& results) {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            printf("Unable to open %s for writing the microbenchmark results\n", path.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        fprintf(file, "{\n  \"cases\": [");
+        for (size_t index = 0; index < results.size(); ++index) {
+            const Result& result = results[index];
+            fprintf(file, "%s\n    {\"name\": \"%s\", \"unit\": \"%s/s\", \"repetitions\": %zu, \"mean\": %.3f, \"stddev\": %.3f, \"ci95\": %.3f, \"best_seconds\": %.9f}",
+                index == 0 ? "" : ",", result.name.c_str(), result.unit.c_str(), result.repetitions,
+                result.mean, result.stddev, result.ci95, result.best_seconds);
+        }
+        fprintf(file, "\n  ]\n}\n");
+        fclose(file);
+    }
+
+    // A gently rolling height field, which is about what a scanned or sculpted mesh looks like to the loader:
+    // every interior vertex is shared by six triangles, and faces are banded across a handful of materials
+    struct SyntheticMesh {
+        uint32_t side;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> texture_coordinates;
+        std::vector<tinyobj::shape_t> shapes;
+        uint64_t triangle_count;
+    };
+
+    constexpr int32_t SYNTHETIC_MATERIAL_COUNT = 4;
+
+    SyntheticMesh make_synthetic_mesh(const uint64_t target_triangles) {
+        SyntheticMesh mesh = {};
+        mesh.side = std::max<uint32_t>(1, static_cast<uint32_t>(std::sqrt(static_cast<double>(target_triangles) / 2.0)));
+        const uint32_t vertex_side = mesh.side + 1;
+        const size_t vertex_count = static_cast<size_t>(vertex_side) * vertex_side;
+
+        mesh.positions.reserve(vertex_count);
+        mesh.normals.reserve(vertex_count);
+        mesh.texture_coordinates.reserve(vertex_count);
+        for (uint32_t row = 0; row < vertex_side; ++row) {
+            for (uint32_t column = 0; column < vertex_side; ++column) {
+                float u = static_cast<float>(column) / static_cast<float>(mesh.side);
+                float v = static_cast<float>(row) / static_cast<float>(mesh.side);
+                float height = 0.05f * std::sin(u * 37.0f) * std::cos(v * 23.0f);
+                mesh.positions.push_back(glm::vec3(u, height, v));
+                mesh.normals.push_back(glm::normalize(glm::vec3(-height, 1.0f, height)));
+                mesh.texture_coordinates.push_back(glm::vec2(u, v));
+            }
+        }
+
+        tinyobj::shape_t shape = {};
+        shape.name = "synthetic";
+        const size_t triangle_count = static_cast<size_t>(mesh.side) * mesh.side * 2;
+        shape.mesh.indices.reserve(triangle_count * 3);
+        shape.mesh.num_face_vertices.reserve(triangle_count);
+        shape.mesh.material_ids.reserve(triangle_count);
+        auto push_vertex = [&](const uint32_t row, const uint32_t column) {
+            int index = static_cast<int>(row * vertex_side + column);
+            tinyobj::index_t obj_index = {};
+            obj_index.vertex_index = index;
+            obj_index.normal_index = index;
+            obj_index.texcoord_index = index;
+            shape.mesh.indices.push_back(obj_index);
+        };
+        for (uint32_t row = 0; row < mesh.side; ++row) {
+            int material = static_cast<int>((static_cast<uint64_t>(row) * SYNTHETIC_MATERIAL_COUNT) / mesh.side);
+            for (uint32_t column = 0; column < mesh.side; ++column) {
+                push_vertex(row, column);
+                push_vertex(row + 1, column);
+                push_vertex(row + 1, column + 1);
+                push_vertex(row, column);
+                push_vertex(row + 1, column + 1);
+                push_vertex(row, column + 1);
+                for (int triangle = 0; triangle < 2; ++triangle) {
+                    shape.mesh.num_face_vertices.push_back(3);
+                    shape.mesh.material_ids.push_back(material);
+                }
+            }
+        }
+        mesh.triangle_count = triangle_count;
+        mesh.shapes.push_back(shape);
+        return mesh;
+    }
+
+    // Writes the synthetic mesh out as an obj and mtl pair so the full load_obj_model path, including parsing, can be timed
+    void write_synthetic_obj(const SyntheticMesh& mesh, const std::filesystem::path& directory, const std::string& obj_name) {
+        const std::string mtl_name = obj_name + ".mtl";
+        {
+            std::ofstream mtl(directory / mtl_name);
+            for (int32_t material = 0; material < SYNTHETIC_MATERIAL_COUNT; ++material) {
+                mtl << "newmtl m" << material << "\n";
+                mtl << "Kd " << 0.25f * static_cast<float>(material + 1) << " 0.5 0.5\n\n";
+            }
+        }
+
+        std::ofstream obj(directory / obj_name);
+        if (!obj.is_open()) {
+            printf("Unable to write %s\n", (directory / obj_name).string().c_str());
+            exit(EXIT_FAILURE);
+        }
+        obj << "mtllib " << mtl_name << "\n";
+        for (const auto& position : mesh.positions) {
+            obj << "v " << position.x << " " << position.y << " " << position.z << "\n";
+        }
+        for (const auto& normal : mesh.normals) {
+            obj << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+        }
+        for (const auto& coordinate : mesh.texture_coordinates) {
+            obj << "vt " << coordinate.x << " " << coordinate.y << "\n";
+        }
+
+        const auto& shape = mesh.shapes[0];
+        int current_material = -1;
+        for (size_t face = 0; face < shape.mesh.num_face_vertices.size(); ++face) {
+            if (shape.mesh.material_ids[face] != current_material) {
+                current_material = shape.mesh.material_ids[face];
+                obj << "usemtl m" << current_material << "\n";
+            }
+            obj << "f";
+            for (size_t vertex = 0; vertex < 3; ++vertex) {
+                // obj indices are 1 based
+                int index = shape.mesh.indices[face * 3 + vertex].vertex_index + 1;
+                obj << " " << index << "/" << index << "/" << index;
+            }
+            obj << "\n";
+        }
+    }
+
+    std::vector<unsigned char> make_noise(const size_t size, const uint32_t seed) {
+        std::mt19937 generator(seed);
+        std::vector<unsigned char> noise(size);
+        for (auto& value : noise) {
+            value = static_cast<unsigned char>(generator() & 0xFF);
+        }
+        return noise;
+    }
+
+    void run_geometry_cases(const Settings& settings, std::vector<Result>& results, const std::filesystem::path& scratch) {
+        const uint64_t triangle_counts[] = { 10000, 100000, 1000000, 10000000 };
+        for (uint64_t target : triangle_counts) {
+            if (target > settings.max_triangles) {
+                continue;
+            }
+            SyntheticMesh mesh = make_synthetic_mesh(target);
+            const double triangles = static_cast<double>(mesh.triangle_count);
+            const std::string suffix = "/" + std::to_string(target) + "tri";
+
+            run_case(settings, results, "make_pieces" + suffix, "tri", triangles, [&]() {
+                auto pieces = geometry::make_pieces(mesh.shapes);
+                sink += pieces.size();
+            });
+
+            auto pieces = geometry::make_pieces(mesh.shapes);
+            run_case(settings, results, "reindex_pieces" + suffix, "tri", triangles, [&]() {
+                auto indexed = geometry::reindex_pieces(pieces, mesh.positions, mesh.normals, mesh.texture_coordinates);
+                sink += indexed.positions.size();
+            });
+            pieces.clear();
+
+            const std::string obj_name = "synthetic_" + std::to_string(target) + ".obj";
+            // Written lazily in the untimed warmup, so filtered out cases don't pay for writing a large file
+            bool obj_written = false;
+            run_case(settings, results, "load_obj_model" + suffix, "tri", triangles, [&]() {
+                if (!obj_written) {
+                    write_synthetic_obj(mesh, scratch, obj_name);
+                    obj_written = true;
+                }
+                geometry::AxisAlignedBasis basis = { geometry::Direction::Right, geometry::Direction::Up, geometry::Direction::Forward };
+                auto model = geometry::load_obj_model(obj_name, scratch.string(), basis);
+                sink += model.vertex_attributes.positions.size();
+            });
+        }
+    }
+
+    void run_image_cases(const Settings& settings, std::vector<Result>& results) {
+        const uint32_t image_sizes[] = { 256, 1024, 4096, 8192 };
+        for (uint32_t size : image_sizes) {
+            if (size > settings.max_image_size) {
+                continue;
+            }
+            const std::string suffix = "/" + std::to_string(size) + "px";
+            const size_t pixel_count = static_cast<size_t>(size) * size;
+
+            {
+                std::vector<unsigned char> rgb = make_noise(pixel_count * 3, size);
+                run_case(settings, results, "extract_two_channels" + suffix, "B", static_cast<double>(rgb.size()), [&]() {
+                    auto rg = vk_image::extract_two_channels(rgb.data(), pixel_count, vk_image::ColorComponents::GB);
+                    sink += rg[rg.size() / 2];
+                });
+            }
+
+            {
+                // Cubemap crosses are four faces wide and three tall, so size is the width of the cross
+                const size_t cross_height = static_cast<size_t>(size) * 3 / 4;
+                std::vector<unsigned char> rgba = make_noise(static_cast<size_t>(size) * cross_height * 4, size + 1);
+                // Only half of the cross is face data, so count what actually gets copied
+                const double face_bytes = static_cast<double>((size / 4) * (cross_height / 3) * 4 * 6);
+                run_case(settings, results, "slice_cubemap_faces" + suffix, "B", face_bytes, [&]() {
+                    auto faces = vk_image::slice_cubemap_faces(rgba.data(), size, cross_height);
+                    sink += faces[faces.size() / 2];
+                });
+            }
+        }
+    }
+
+    void run_transform_cases(const Settings& settings, std::vector<Result>& results) {
+        // Every right handed axis aligned basis, so the branches see a realistic mix
+        std::vector<geometry::AxisAlignedBasis> bases;
+        const geometry::Direction directions[] = {
+            geometry::Direction::Left, geometry::Direction::Right, geometry::Direction::Up,
+            geometry::Direction::Down, geometry::Direction::Forward, geometry::Direction::Back
+        };
+        for (auto x : directions) {
+            for (auto y : directions) {
+                for (auto z : directions) {
+                    if (static_cast<int>(x) / 2 != static_cast<int>(y) / 2 && static_cast<int>(y) / 2 != static_cast<int>(z) / 2 && static_cast<int>(x) / 2 != static_cast<int>(z) / 2) {
+                        bases.push_back({ x, y, z });
+                    }
+                }
+            }
+        }
+
+        const size_t calls = 1000000;
+        run_case(settings, results, "make_x_right_y_up_z_forward_transform", "call", static_cast<double>(calls), [&]() {
+            float accumulator = 0.0f;
+            for (size_t call = 0; call < calls; ++call) {
+                glm::mat4 transform = geometry::make_x_right_y_up_z_forward_transform(bases[call % bases.size()]);
+                accumulator += transform[call & 3][(call >> 2) & 3];
+            }
+            sink += static_cast<uint64_t>(accumulator);
+        });
+    }
+
+    // Boxes of assorted sizes scattered through a cube around a camera looking down its middle, so roughly a third land in view
+    // and the rest are split between every side. Cull rate is the measure, not which pieces make it
+    geometry::PieceBounds make_scattered_bounds(const size_t piece_count) {
+        std::mt19937 generator(static_cast<uint32_t>(piece_count));
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> size(0.05f, 2.0f);
+        geometry::PieceBounds bounds = {};
+        for (size_t piece = 0; piece < piece_count; ++piece) {
+            glm::vec3 extent = glm::vec3(size(generator), size(generator), size(generator));
+            bounds.center_x.push_back(position(generator));
+            bounds.center_y.push_back(position(generator));
+            bounds.center_z.push_back(position(generator));
+            bounds.extent_x.push_back(extent.x);
+            bounds.extent_y.push_back(extent.y);
+            bounds.extent_z.push_back(extent.z);
+            bounds.radius.push_back(glm::length(extent));
+        }
+        return bounds;
+    }
+
+    void run_culling_cases(const Settings& settings, std::vector<Result>& results) {
+        const size_t piece_counts[] = { 10000, 100000, 1000000 };
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, -60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 1.0f, 1000.0f);
+        const frustum::Planes planes = frustum::extract_planes(projection * view);
+        for (size_t piece_count : piece_counts) {
+            geometry::PieceBounds bounds = make_scattered_bounds(piece_count);
+            std::vector<uint8_t> visible;
+            const std::string name = std::string("frustum_cull_") + frustum::instruction_set() + "/" + std::to_string(piece_count) + "piece";
+            run_case(settings, results, name, "piece", static_cast<double>(piece_count), [&]() {
+                sink += frustum::cull_pieces(planes, bounds, visible);
+            });
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    asset_microbench::Settings settings = asset_microbench::parse_settings(argc, argv);
+
+    std::filesystem::path scratch = std::filesystem::temp_directory_path() / "galaxy-jar-microbench";
+    std::filesystem::create_directories(scratch);
+
+    std::vector<asset_microbench::Result> results;
+    asset_microbench::run_transform_cases(settings, results);
+    asset_microbench::run_culling_cases(settings, results);
+    asset_microbench::run_image_cases(settings, results);
+    asset_microbench::run_geometry_cases(settings, results, scratch);
+
+    std::filesystem::remove_all(scratch);
+
+    if (!settings.json_path.empty()) {
+        asset_microbench::write_json(settings.json_path, results);
+    }
+    return EXIT_SUCCESS;
+}
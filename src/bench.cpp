@@ -0,0 +1,167 @@
+#include "bench.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace bench {
+    uint64_t peak_host_memory_bytes() {
+        #ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters = {};
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return 0;
+        }
+        return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+        #else
+        struct rusage usage = {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        // Linux reports kilobytes, macOS reports bytes
+        #ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+        #else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+        #endif
+        #endif
+    }
+
+    uint64_t device_memory_usage_bytes(const VmaAllocator allocator) {
+        const VkPhysicalDeviceMemoryProperties* memory_props = nullptr;
+        vmaGetMemoryProperties(allocator, &memory_props);
+
+        std::vector<VmaBudget> budgets(memory_props->memoryHeapCount);
+        vmaGetHeapBudgets(allocator, budgets.data());
+
+        uint64_t usage = 0;
+        for (const auto& budget : budgets) {
+            usage += budget.usage;
+        }
+        return usage;
+    }
+
+    void print_report(const Report& report) {
+        printf("Benchmark on %s, %ux%u, %llu warmup + %llu measured frames\n",
+            report.device_name.c_str(), report.width, report.height,
+            static_cast<unsigned long long>(report.warmup_frames),
+            static_cast<unsigned long long>(report.measured_frames));
+        printf("Load time %.3fms, peak host memory %.1fMiB, peak device memory %.1fMiB\n",
+            report.load_time_ms,
+            static_cast<double>(report.peak_host_memory_bytes) / (1024.0 * 1024.0),
+            static_cast<double>(report.peak_device_memory_bytes) / (1024.0 * 1024.0));
+        frame_stats::print_summary("CPU frame time", "ms", report.cpu_frame_ms);
+        frame_stats::print_summary("GPU frame time", "ms", report.gpu_frame_ms);
+        if (report.dynamic_resolution_target_ms > 0.0) {
+            frame_stats::print_summary("Resolution scale", "", report.resolution_scale);
+        }
+        if (report.frustum_culling) {
+            printf("CPU frustum culling skipped %.1f pieces per frame\n", report.cpu_frustum_culled_pieces);
+            frame_stats::print_summary("Frustum cull time", "ms", report.frustum_cull_ms);
+        }
+        if (report.occlusion_culling) {
+            printf("Pieces per frame: %.1f drawn early, %.1f drawn late, %.1f frustum culled, %.1f occlusion culled\n",
+                report.early_drawn_pieces, report.late_drawn_pieces, report.frustum_culled_pieces, report.occlusion_culled_pieces);
+        }
+    }
+
+    void write_report_json(const std::string& path, const Report& report, const vk_profiler::GpuProfiler& profiler) {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            printf("Unable to open %s for writing the benchmark report\n", path.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"device\": ");
+        frame_stats::write_json_string(file, report.device_name);
+        fprintf(file, ",\n  \"scene\": ");
+        frame_stats::write_json_string(file, report.scene);
+        fprintf(file, ",\n");
+        fprintf(file, "  \"width\": %u,\n", report.width);
+        fprintf(file, "  \"height\": %u,\n", report.height);
+        fprintf(file, "  \"headless\": %s,\n", report.headless ? "true" : "false");
+        fprintf(file, "  \"fused_compose\": %s,\n", report.fused_compose ? "true" : "false");
+        fprintf(file, "  \"classified_compose\": %s,\n", report.classified_compose ? "true" : "false");
+        fprintf(file, "  \"direct_compose\": %s,\n", report.direct_compose ? "true" : "false");
+        fprintf(file, "  \"jar_mask\": \"%s\",\n", report.jar_mask.c_str());
+        fprintf(file, "  \"depth_prepass\": %s,\n", report.depth_prepass ? "true" : "false");
+        fprintf(file, "  \"visibility_buffer\": %s,\n", report.visibility_buffer ? "true" : "false");
+        fprintf(file, "  \"occlusion_culling\": %s,\n", report.occlusion_culling ? "true" : "false");
+        fprintf(file, "  \"early_drawn_pieces\": %.6f,\n", report.early_drawn_pieces);
+        fprintf(file, "  \"late_drawn_pieces\": %.6f,\n", report.late_drawn_pieces);
+        fprintf(file, "  \"frustum_culled_pieces\": %.6f,\n", report.frustum_culled_pieces);
+        fprintf(file, "  \"occlusion_culled_pieces\": %.6f,\n", report.occlusion_culled_pieces);
+        fprintf(file, "  \"frustum_culling\": %s,\n", report.frustum_culling ? "true" : "false");
+        fprintf(file, "  \"cpu_frustum_culled_pieces\": %.6f,\n", report.cpu_frustum_culled_pieces);
+        fprintf(file, "  \"async_compute\": %s,\n", report.async_compute ? "true" : "false");
+        fprintf(file, "  \"vertex_pulling\": %s,\n", report.vertex_pulling ? "true" : "false");
+        fprintf(file, "  \"instance_count\": %u,\n", report.instance_count);
+        fprintf(file, "  \"light_count\": %u,\n", report.light_count);
+        fprintf(file, "  \"dynamic_resolution_target_ms\": %.6f,\n", report.dynamic_resolution_target_ms);
+        fprintf(file, "  \"frames_in_flight\": %u,\n", report.frames_in_flight);
+        fprintf(file, "  \"warmup_frames\": %llu,\n", static_cast<unsigned long long>(report.warmup_frames));
+        fprintf(file, "  \"measured_frames\": %llu,\n", static_cast<unsigned long long>(report.measured_frames));
+        fprintf(file, "  \"load_time_ms\": %.6f,\n", report.load_time_ms);
+        fprintf(file, "  \"peak_host_memory_bytes\": %llu,\n", static_cast<unsigned long long>(report.peak_host_memory_bytes));
+        fprintf(file, "  \"peak_device_memory_bytes\": %llu,\n", static_cast<unsigned long long>(report.peak_device_memory_bytes));
+        fprintf(file, "  \"cpu_frame_ms\": ");
+        frame_stats::write_summary_json(file, report.cpu_frame_ms);
+        fprintf(file, ",\n  \"gpu_frame_ms\": ");
+        frame_stats::write_summary_json(file, report.gpu_frame_ms);
+        fprintf(file, ",\n  \"resolution_scale\": ");
+        frame_stats::write_summary_json(file, report.resolution_scale);
+        fprintf(file, ",\n  \"frustum_cull_ms\": ");
+        frame_stats::write_summary_json(file, report.frustum_cull_ms);
+        fprintf(file, ",\n  \"render_targets\": {");
+        uint64_t target_bytes = 0;
+        for (size_t index = 0; index < report.target_traffic.size(); ++index) {
+            const render_formats::TargetTraffic& target = report.target_traffic[index];
+            fprintf(file, "%s\n    \"%s\": { \"format\": \"%s\", \"bytes_per_frame\": %llu }", (index == 0) ? "" : ",", target.name,
+                render_formats::format_name(target.format), static_cast<unsigned long long>(target.bytes_per_frame));
+            target_bytes += target.bytes_per_frame;
+        }
+        fprintf(file, "\n  },\n  \"render_target_bytes_per_frame\": %llu", static_cast<unsigned long long>(target_bytes));
+        fprintf(file, ",\n  \"gpu_pass_ms\": {");
+        bool first = true;
+        for (size_t pass_index = 0; pass_index < vk_profiler::PASS_COUNT; ++pass_index) {
+            vk_profiler::Pass pass = static_cast<vk_profiler::Pass>(pass_index);
+            frame_stats::Summary summary = vk_profiler::summarize_pass(profiler, pass, false);
+            if (pass == vk_profiler::Pass::Frame || summary.count == 0) {
+                continue;
+            }
+            fprintf(file, "%s\n    \"%s\": ", first ? "" : ",", vk_profiler::pass_name(pass));
+            frame_stats::write_summary_json(file, summary);
+            first = false;
+        }
+        fprintf(file, "\n  },\n  \"fragment_invocations\": {");
+        first = true;
+        for (size_t pass_index = 0; pass_index < vk_profiler::PASS_COUNT; ++pass_index) {
+            vk_profiler::Pass pass = static_cast<vk_profiler::Pass>(pass_index);
+            frame_stats::Summary summary = vk_profiler::summarize_fragment_invocations(profiler, pass);
+            if (summary.count == 0) {
+                continue;
+            }
+            fprintf(file, "%s\n    \"%s\": ", first ? "" : ",", vk_profiler::pass_name(pass));
+            frame_stats::write_summary_json(file, summary);
+            first = false;
+        }
+        fprintf(file, "\n  }");
+        frame_stats::Summary async_overlap = vk_profiler::summarize_async_overlap(profiler);
+        if (async_overlap.count > 0) {
+            fprintf(file, ",\n  \"async_overlap_ms\": ");
+            frame_stats::write_summary_json(file, async_overlap);
+        }
+        fprintf(file, "\n}\n");
+        fclose(file);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vk_mem_alloc.h"
+#include "frame_stats.hpp"
+#include "vk_profiler.hpp"
+#include "render_formats.hpp"
+
+namespace bench {
+    struct Report {
+        std::string device_name;
+        std::string scene;
+        uint32_t width;
+        uint32_t height;
+        bool headless;
+        bool fused_compose;
+        bool classified_compose;
+        bool direct_compose;
+        // How the jar is masked: "color", "stencil" or "stencil_feathered"
+        std::string jar_mask;
+        // Format and per frame traffic of each render target
+        std::vector<render_formats::TargetTraffic> target_traffic;
+        bool depth_prepass;
+        bool visibility_buffer;
+        bool occlusion_culling;
+        // Pieces per frame on average. Culled ones are split by which test culled them, drawn ones by which phase drew them. All zero without occlusion culling
+        double early_drawn_pieces;
+        double late_drawn_pieces;
+        double frustum_culled_pieces;
+        double occlusion_culled_pieces;
+        bool frustum_culling;
+        // Pieces per frame the CPU frustum test skipped, and how long testing took each frame. Zero without frustum culling
+        double cpu_frustum_culled_pieces;
+        frame_stats::Summary frustum_cull_ms;
+        // Whether the grid pass ran on the compute queue. How long it overlapped graphics is taken from the GPU profile
+        bool async_compute;
+        bool vertex_pulling;
+        // Instances drawn by instanced drawables each frame
+        uint32_t instance_count;
+        uint32_t light_count;
+        // Zero when dynamic resolution is off
+        double dynamic_resolution_target_ms;
+        // Fraction of the full width and height rendered, one sample per measured frame. Always 1 without dynamic resolution
+        frame_stats::Summary resolution_scale;
+        uint32_t frames_in_flight;
+        uint64_t warmup_frames;
+        uint64_t measured_frames;
+        // From process start to the first frame, covering init, asset loading, and pipeline builds
+        double load_time_ms;
+        frame_stats::Summary cpu_frame_ms;
+        frame_stats::Summary gpu_frame_ms;
+        uint64_t peak_host_memory_bytes;
+        uint64_t peak_device_memory_bytes;
+    };
+
+    // Peak resident set size of the process so far
+    uint64_t peak_host_memory_bytes();
+
+    // Current usage across every memory heap, as tracked by VMA's budget queries
+    uint64_t device_memory_usage_bytes(const VmaAllocator allocator);
+
+    void print_report(const Report& report);
+
+    // Writes the report along with the per pass GPU breakdown from the profiler
+    void write_report_json(const std::string& path, const Report& report, const vk_profiler::GpuProfiler& profiler);
+}
+
+#endif // BENCH_H_
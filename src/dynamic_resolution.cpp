@@ -0,0 +1,51 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dynamic_resolution {
+    namespace {
+        // Fraction of the way to the measured ideal covered per measurement. Measurements lag by the frames in flight, so going all the way overshoots
+        const float DAMPING = 0.3f;
+        // Relative distance from the target that's treated as on target
+        const double DEADBAND = 0.05;
+        const uint32_t EXTENT_STEP = 8;
+    }
+
+    Controller init(const Settings& settings) {
+        Controller controller = {};
+        controller.settings = settings;
+        controller.scale = settings.max_scale;
+        controller.last_measured_frame = 0;
+        controller.measured = false;
+        return controller;
+    }
+
+    void update(Controller& controller, const uint64_t measured_frame, const double gpu_frame_ms) {
+        if (gpu_frame_ms <= 0.0 || (controller.measured && measured_frame <= controller.last_measured_frame)) {
+            return;
+        }
+        controller.measured = true;
+        controller.last_measured_frame = measured_frame;
+
+        double ratio = controller.settings.target_frame_ms / gpu_frame_ms;
+        if (std::abs(1.0 / ratio - 1.0) < DEADBAND) {
+            return;
+        }
+        float ideal = controller.scale * static_cast<float>(std::sqrt(ratio));
+        float next = controller.scale + DAMPING * (ideal - controller.scale);
+        controller.scale = std::clamp(next, controller.settings.min_scale, controller.settings.max_scale);
+    }
+
+    VkExtent2D scaled_extent(const VkExtent2D full_extent, const float scale) {
+        if ((full_extent.width == 0) || (full_extent.height == 0)) {
+            return full_extent;
+        }
+        // Rounding each axis on its own would stretch the image a little differently at every step
+        uint32_t width = static_cast<uint32_t>(std::lround(static_cast<double>(full_extent.width) * scale / EXTENT_STEP)) * EXTENT_STEP;
+        width = std::clamp(width, std::min(EXTENT_STEP, full_extent.width), full_extent.width);
+        uint32_t height = static_cast<uint32_t>(std::lround(static_cast<double>(width) * full_extent.height / full_extent.width));
+        height = std::clamp(height, 1u, full_extent.height);
+        return { width, height };
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+// Renders into a shrinking or growing corner of the full size targets, steered by measured GPU frame time. The final blit scales it back up
+namespace dynamic_resolution {
+    struct Settings {
+        // GPU frame time the scale is steered towards
+        double target_frame_ms;
+        // Bounds on the fraction of the full extent rendered along each axis
+        float min_scale;
+        float max_scale;
+    };
+
+    struct Controller {
+        Settings settings;
+        float scale;
+        // Frame the last acted on measurement came from, so each measurement only moves the scale once
+        uint64_t last_measured_frame;
+        bool measured;
+    };
+
+    // Starts out at the maximum scale
+    Controller init(const Settings& settings);
+
+    // Moves the scale part of the way towards where the measurement says it should be. Pixel work goes with area, so the scale
+    // follows the square root of the time ratio. Measurements close to the target, or already seen, leave it alone
+    void update(Controller& controller, const uint64_t measured_frame, const double gpu_frame_ms);
+
+    // The extent rendered at this scale. The width moves in steps of a few pixels so small scale changes don't move it every frame,
+    // and the height follows the width so the aspect ratio stays that of full_extent. Never bigger than full_extent
+    VkExtent2D scaled_extent(const VkExtent2D full_extent, const float scale);
+}
+
+#endif // DYNAMIC_RESOLUTION_H_
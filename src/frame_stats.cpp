@@ -0,0 +1,70 @@
+#include "frame_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace frame_stats {
+    double percentile(const std::vector<double>& sorted_samples, double percentile) {
+        if (sorted_samples.empty()) {
+            return 0.0;
+        }
+        double rank = (std::clamp(percentile, 0.0, 100.0) / 100.0) * static_cast<double>(sorted_samples.size() - 1);
+        size_t lower = static_cast<size_t>(std::floor(rank));
+        size_t upper = std::min(lower + 1, sorted_samples.size() - 1);
+        double blend = rank - static_cast<double>(lower);
+        return sorted_samples[lower] + (sorted_samples[upper] - sorted_samples[lower]) * blend;
+    }
+
+    Summary summarize(std::vector<double> samples) {
+        Summary summary = {};
+        if (samples.empty()) {
+            return summary;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        summary.count = samples.size();
+        summary.min = samples.front();
+        summary.max = samples.back();
+        summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+        summary.p50 = percentile(samples, 50.0);
+        summary.p95 = percentile(samples, 95.0);
+        summary.p99 = percentile(samples, 99.0);
+
+        return summary;
+    }
+
+    void print_summary(const char* label, const char* units, const Summary& summary) {
+        printf("%-16s n=%-6zu min %.3f%s  mean %.3f%s  p50 %.3f%s  p95 %.3f%s  p99 %.3f%s  max %.3f%s\n",
+            label, summary.count,
+            summary.min, units,
+            summary.mean, units,
+            summary.p50, units,
+            summary.p95, units,
+            summary.p99, units,
+            summary.max, units);
+    }
+
+    void write_summary_json(FILE* file, const Summary& summary) {
+        fprintf(file, "{ \"count\": %zu, \"min\": %.6f, \"mean\": %.6f, \"p50\": %.6f, \"p95\": %.6f, \"p99\": %.6f, \"max\": %.6f }",
+            summary.count, summary.min, summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+    }
+
+    void write_json_string(FILE* file, const std::string& text) {
+        fputc('"', file);
+        for (const char c : text) {
+            const unsigned char byte = static_cast<unsigned char>(c);
+            if ((c == '"') || (c == '\\')) {
+                fprintf(file, "\\%c", c);
+            }
+            else if (byte < 0x20) {
+                fprintf(file, "\\u%04x", byte);
+            }
+            else {
+                fputc(c, file);
+            }
+        }
+        fputc('"', file);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef FRAME_STATS_H_
+#define FRAME_STATS_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace frame_stats {
+    struct Summary {
+        size_t count;
+        double min;
+        double mean;
+        double p50;
+        double p95;
+        double p99;
+        double max;
+    };
+
+    // Linearly interpolated percentile of an already sorted sample set. Percentile is in the range [0, 100]
+    double percentile(const std::vector<double>& sorted_samples, double percentile);
+
+    // Summarizes a set of samples. An empty set summarizes to all zeroes
+    Summary summarize(std::vector<double> samples);
+
+    // Prints a one line summary, labelled and suffixed with the sample units
+    void print_summary(const char* label, const char* units, const Summary& summary);
+
+    // Writes the summary as a single line JSON object
+    void write_summary_json(FILE* file, const Summary& summary);
+
+    // Writes the text as a quoted JSON string, escaping quotes, backslashes and control characters
+    void write_json_string(FILE* file, const std::string& text);
+}
+
+#endif // FRAME_STATS_H_
@@ -0,0 +1,202 @@
+#include "frustum.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define FRUSTUM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_SSE2
+#endif
+
+namespace frustum {
+    namespace {
+        // Broadcast parts of one plane. The box reaches furthest along the plane's normal at its corner on the normal's side,
+        // which is the center plus the extent weighted by the absolute normal
+        struct PlaneTerms {
+            float normal_x;
+            float normal_y;
+            float normal_z;
+            float offset;
+            float reach_x;
+            float reach_y;
+            float reach_z;
+        };
+
+        std::array<PlaneTerms, 6> plane_terms(const Planes& planes) {
+            std::array<PlaneTerms, 6> terms = {};
+            for (size_t plane = 0; plane < planes.planes.size(); ++plane) {
+                const glm::vec4& p = planes.planes[plane];
+                terms[plane] = { p.x, p.y, p.z, p.w, std::abs(p.x), std::abs(p.y), std::abs(p.z) };
+            }
+            return terms;
+        }
+
+        // Tests the pieces from first on one at a time, for the tail the vector loop leaves or when there's no vector unit
+        uint32_t cull_scalar(const std::array<PlaneTerms, 6>& terms, const geometry::PieceBounds& bounds, const size_t first, std::vector<uint8_t>& visible) {
+            uint32_t culled = 0;
+            for (size_t piece = first; piece < bounds.size(); ++piece) {
+                bool inside = true;
+                for (const PlaneTerms& plane : terms) {
+                    float distance = plane.normal_x * bounds.center_x[piece] + plane.normal_y * bounds.center_y[piece] + plane.normal_z * bounds.center_z[piece] + plane.offset;
+                    float box_reach = plane.reach_x * bounds.extent_x[piece] + plane.reach_y * bounds.extent_y[piece] + plane.reach_z * bounds.extent_z[piece];
+                    // Whichever of the box and sphere stays closer to the center decides
+                    inside = inside && (distance + std::min(box_reach, bounds.radius[piece]) >= 0.0f);
+                }
+                visible[piece] = inside ? 1 : 0;
+                culled += inside ? 0 : 1;
+            }
+            return culled;
+        }
+
+#if defined(FRUSTUM_AVX2) || defined(FRUSTUM_SSE2)
+        // Bit i set becomes byte i set to 1, for spreading four lanes' results over the visible flags in one store
+        const std::array<uint32_t, 16> LANE_FLAGS = [] {
+            std::array<uint32_t, 16> flags = {};
+            for (uint32_t bits = 0; bits < flags.size(); ++bits) {
+                for (uint32_t lane = 0; lane < 4; ++lane) {
+                    flags[bits] |= ((bits >> lane) & 1u) << (lane * 8);
+                }
+            }
+            return flags;
+        }();
+#endif
+
+#if defined(FRUSTUM_AVX2)
+        const size_t LANES = 8;
+
+        struct PlaneVectors {
+            __m256 normal_x;
+            __m256 normal_y;
+            __m256 normal_z;
+            __m256 offset;
+            __m256 reach_x;
+            __m256 reach_y;
+            __m256 reach_z;
+        };
+
+        uint32_t cull_vector(const std::array<PlaneTerms, 6>& terms, const geometry::PieceBounds& bounds, std::vector<uint8_t>& visible, size_t& next) {
+            std::array<PlaneVectors, 6> planes = {};
+            for (size_t plane = 0; plane < terms.size(); ++plane) {
+                const PlaneTerms& term = terms[plane];
+                planes[plane] = { _mm256_set1_ps(term.normal_x), _mm256_set1_ps(term.normal_y), _mm256_set1_ps(term.normal_z), _mm256_set1_ps(term.offset),
+                                  _mm256_set1_ps(term.reach_x), _mm256_set1_ps(term.reach_y), _mm256_set1_ps(term.reach_z) };
+            }
+            uint32_t culled = 0;
+            const size_t vector_end = bounds.size() - bounds.size() % LANES;
+            const __m256 zero = _mm256_setzero_ps();
+            for (next = 0; next < vector_end; next += LANES) {
+                const __m256 center_x = _mm256_loadu_ps(&bounds.center_x[next]);
+                const __m256 center_y = _mm256_loadu_ps(&bounds.center_y[next]);
+                const __m256 center_z = _mm256_loadu_ps(&bounds.center_z[next]);
+                const __m256 extent_x = _mm256_loadu_ps(&bounds.extent_x[next]);
+                const __m256 extent_y = _mm256_loadu_ps(&bounds.extent_y[next]);
+                const __m256 extent_z = _mm256_loadu_ps(&bounds.extent_z[next]);
+                const __m256 radius = _mm256_loadu_ps(&bounds.radius[next]);
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (const PlaneVectors& plane : planes) {
+                    __m256 distance = _mm256_fmadd_ps(plane.normal_x, center_x, _mm256_fmadd_ps(plane.normal_y, center_y, _mm256_fmadd_ps(plane.normal_z, center_z, plane.offset)));
+                    __m256 box_reach = _mm256_fmadd_ps(plane.reach_x, extent_x, _mm256_fmadd_ps(plane.reach_y, extent_y, _mm256_mul_ps(plane.reach_z, extent_z)));
+                    __m256 reach = _mm256_min_ps(box_reach, radius);
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+                }
+                const uint32_t inside_bits = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+                const std::array<uint32_t, 2> flags = { LANE_FLAGS[inside_bits & 0xFu], LANE_FLAGS[inside_bits >> 4] };
+                std::memcpy(&visible[next], flags.data(), LANES);
+                culled += static_cast<uint32_t>(LANES - std::popcount(inside_bits));
+            }
+            return culled;
+        }
+#elif defined(FRUSTUM_SSE2)
+        const size_t LANES = 4;
+
+        struct PlaneVectors {
+            __m128 normal_x;
+            __m128 normal_y;
+            __m128 normal_z;
+            __m128 offset;
+            __m128 reach_x;
+            __m128 reach_y;
+            __m128 reach_z;
+        };
+
+        uint32_t cull_vector(const std::array<PlaneTerms, 6>& terms, const geometry::PieceBounds& bounds, std::vector<uint8_t>& visible, size_t& next) {
+            std::array<PlaneVectors, 6> planes = {};
+            for (size_t plane = 0; plane < terms.size(); ++plane) {
+                const PlaneTerms& term = terms[plane];
+                planes[plane] = { _mm_set1_ps(term.normal_x), _mm_set1_ps(term.normal_y), _mm_set1_ps(term.normal_z), _mm_set1_ps(term.offset),
+                                  _mm_set1_ps(term.reach_x), _mm_set1_ps(term.reach_y), _mm_set1_ps(term.reach_z) };
+            }
+            uint32_t culled = 0;
+            const size_t vector_end = bounds.size() - bounds.size() % LANES;
+            const __m128 zero = _mm_setzero_ps();
+            for (next = 0; next < vector_end; next += LANES) {
+                const __m128 center_x = _mm_loadu_ps(&bounds.center_x[next]);
+                const __m128 center_y = _mm_loadu_ps(&bounds.center_y[next]);
+                const __m128 center_z = _mm_loadu_ps(&bounds.center_z[next]);
+                const __m128 extent_x = _mm_loadu_ps(&bounds.extent_x[next]);
+                const __m128 extent_y = _mm_loadu_ps(&bounds.extent_y[next]);
+                const __m128 extent_z = _mm_loadu_ps(&bounds.extent_z[next]);
+                const __m128 radius = _mm_loadu_ps(&bounds.radius[next]);
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (const PlaneVectors& plane : planes) {
+                    __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane.normal_x, center_x), _mm_mul_ps(plane.normal_y, center_y)),
+                                                 _mm_add_ps(_mm_mul_ps(plane.normal_z, center_z), plane.offset));
+                    __m128 box_reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane.reach_x, extent_x), _mm_mul_ps(plane.reach_y, extent_y)), _mm_mul_ps(plane.reach_z, extent_z));
+                    __m128 reach = _mm_min_ps(box_reach, radius);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+                }
+                const uint32_t inside_bits = static_cast<uint32_t>(_mm_movemask_ps(inside));
+                std::memcpy(&visible[next], &LANE_FLAGS[inside_bits], LANES);
+                culled += static_cast<uint32_t>(LANES - std::popcount(inside_bits));
+            }
+            return culled;
+        }
+#endif
+    }
+
+    Planes extract_planes(const glm::mat4& clip_from_object) {
+        // glm is column major, so row i of the matrix is element i of every column
+        auto row = [&](const int index) {
+            return glm::vec4(clip_from_object[0][index], clip_from_object[1][index], clip_from_object[2][index], clip_from_object[3][index]);
+        };
+        const glm::vec4 x = row(0);
+        const glm::vec4 y = row(1);
+        const glm::vec4 z = row(2);
+        const glm::vec4 w = row(3);
+        // -w <= x <= w and -w <= y <= w, but depth only runs 0 <= z <= w
+        Planes planes = { { w + x, w - x, w + y, w - y, z, w - z } };
+        for (glm::vec4& plane : planes.planes) {
+            // An infinite far plane comes out with no normal, and everything is in front of it
+            const float normal_length = glm::length(glm::vec3(plane));
+            plane = (normal_length > 0.0f) ? plane / normal_length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+        return planes;
+    }
+
+    uint32_t cull_pieces(const Planes& planes, const geometry::PieceBounds& bounds, std::vector<uint8_t>& visible) {
+        visible.resize(bounds.size());
+        const std::array<PlaneTerms, 6> terms = plane_terms(planes);
+        size_t next = 0;
+        uint32_t culled = 0;
+#if defined(FRUSTUM_AVX2) || defined(FRUSTUM_SSE2)
+        culled += cull_vector(terms, bounds, visible, next);
+#endif
+        culled += cull_scalar(terms, bounds, next, visible);
+        return culled;
+    }
+
+    const char* instruction_set() {
+#if defined(FRUSTUM_AVX2)
+        return "avx2";
+#elif defined(FRUSTUM_SSE2)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+}
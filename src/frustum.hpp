@@ -0,0 +1,30 @@
+#ifndef FRUSTUM_H_
+#define FRUSTUM_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "geometry.hpp"
+#include "glmvk.hpp"
+
+// Rejects pieces outside the camera's view volume on the CPU, before any of their draws are recorded
+namespace frustum {
+    // Left, right, bottom, top, near and far, each facing inwards. Normalized, so dot(xyz, point) + w is a point's distance from the plane
+    struct Planes {
+        std::array<glm::vec4, 6> planes;
+    };
+
+    // The clip volume of a zero to one depth projection, in whatever space the matrix takes points from. Passing
+    // projection * view * model gives the planes in the model's own space, where its piece bounds are
+    Planes extract_planes(const glm::mat4& clip_from_object);
+
+    // Sets visible[piece] to 1 for every piece whose box and sphere both reach inside all six planes, 0 for the rest.
+    // visible is resized to the piece count. Returns how many pieces were culled
+    uint32_t cull_pieces(const Planes& planes, const geometry::PieceBounds& bounds, std::vector<uint8_t>& visible);
+
+    // Instruction set cull_pieces was compiled for: "avx2", "sse2" or "scalar"
+    const char* instruction_set();
+}
+
+#endif // FRUSTUM_H_
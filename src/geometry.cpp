@@ -1,24 +1,17 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "geometry.hpp"
+#include "geometry_private.hpp"
 #include "tiny_obj_loader.h"
 #include "vk_buffer.hpp"
+#include "trace.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <deque>
 #include <tuple>
 #include <unordered_map>
 
-// Local declarations and such
-namespace geometry {
-    struct PreprocessedPiece {
-        std::vector<uint32_t> position_indices;
-        std::vector<uint32_t> normal_indices;
-        std::vector<uint32_t> texture_coordinate_indices;
-        int32_t material_index;
-    };
-}
-
 namespace geometry {
 
     std::vector<TexturedVertex> zip_up_obj(tinyobj::attrib_t& attributes) {
@@ -84,6 +77,34 @@ namespace geometry {
         return pieces;
     }
 
+    // Box around every position the indices reference, and the sphere around its center. A piece without indices gets an empty box at the origin
+    void append_piece_bounds(PieceBounds& bounds, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices) {
+        glm::vec3 box_min = glm::vec3(0.0f);
+        glm::vec3 box_max = glm::vec3(0.0f);
+        if (!indices.empty()) {
+            box_min = positions[indices[0]];
+            box_max = box_min;
+        }
+        for (uint32_t index : indices) {
+            box_min = glm::min(box_min, positions[index]);
+            box_max = glm::max(box_max, positions[index]);
+        }
+        glm::vec3 center = (box_min + box_max) * 0.5f;
+        glm::vec3 extent = (box_max - box_min) * 0.5f;
+        float radius_squared = 0.0f;
+        for (uint32_t index : indices) {
+            glm::vec3 offset = positions[index] - center;
+            radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+        }
+        bounds.center_x.push_back(center.x);
+        bounds.center_y.push_back(center.y);
+        bounds.center_z.push_back(center.z);
+        bounds.extent_x.push_back(extent.x);
+        bounds.extent_y.push_back(extent.y);
+        bounds.extent_z.push_back(extent.z);
+        bounds.radius.push_back(std::sqrt(radius_squared));
+    }
+
     IndexedVertexData reindex_pieces(std::vector<PreprocessedPiece>& pieces, std::vector<glm::vec3>& raw_positions, std::vector<glm::vec3>& raw_normals, std::vector<glm::vec2>& raw_texture_coordinates) {
         IndexedVertexData indexed_data = {};
         
@@ -175,10 +196,15 @@ namespace geometry {
             indexed_data.texture_coordinates.push_back(std::get<2>(vertex.first));
         }
 
+        for (auto& piece : processed_piece_vector) {
+            append_piece_bounds(indexed_data.piece_bounds, indexed_data.positions, piece.indices);
+        }
+
         return indexed_data;
     }
 
     HostModel load_obj_model(std::string file_name, std::string base_path, AxisAlignedBasis coordinate_system) {
+        TRACE_ZONE("load_obj_model");
         tinyobj::attrib_t attrib = {};
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
@@ -268,6 +294,7 @@ namespace geometry {
     }
 
     GpuModel upload_model(vk_types::Context& context, const HostModel& host_model) {
+        TRACE_ZONE("upload_model");
         std::vector<vk_types::GpuMeshBuffers> mesh_resources = vk_buffer::create_mesh_buffers(context, host_model);
 
         const std::vector<VkDescriptorType> texture_descriptor_types = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
@@ -364,6 +391,7 @@ namespace geometry {
             diffuse_texture_indices,
             normal_texture_indices,
             specular_texture_indices,
+            host_model.vertex_attributes.piece_bounds,
         };
 
         return gpu_model;
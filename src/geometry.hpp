@@ -39,11 +39,28 @@ namespace geometry {
         int32_t material_index;
     };
 
+    // Object space bounds of every piece, one array per component so the frustum test can load several pieces at once.
+    // The box spans center - extent to center + extent, and the sphere around the same center just reaches its farthest vertex
+    struct PieceBounds {
+        std::vector<float> center_x;
+        std::vector<float> center_y;
+        std::vector<float> center_z;
+        std::vector<float> extent_x;
+        std::vector<float> extent_y;
+        std::vector<float> extent_z;
+        std::vector<float> radius;
+
+        size_t size() const {
+            return radius.size();
+        }
+    };
+
     struct IndexedVertexData {
         std::vector<glm::vec3> positions;
         std::vector<glm::vec3> normals;
         std::vector<glm::vec2> texture_coordinates;
         std::vector<Piece> pieces;
+        PieceBounds piece_bounds;
     };
 
     struct HostModel {
@@ -61,6 +78,7 @@ namespace geometry {
         std::vector<uint32_t> diffuse_texture_indices;
         std::vector<uint32_t> normal_texture_indices;
         std::vector<uint32_t> specular_texture_indices;
+        PieceBounds piece_bounds;
     };
 
     // Accepts a file name, and a path to search for the file and corresponding material as arguments
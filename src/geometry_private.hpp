@@ -0,0 +1,24 @@
+#ifndef GEOMETRY_PRIVATE_H
+#define GEOMETRY_PRIVATE_H
+
+#include "geometry.hpp"
+#include "tiny_obj_loader.h"
+
+#include <vector>
+
+// Stages of load_obj_model that run after tinyobj is done parsing. Exposed so they can be exercised on synthetic input
+namespace geometry {
+    struct PreprocessedPiece {
+        std::vector<uint32_t> position_indices;
+        std::vector<uint32_t> normal_indices;
+        std::vector<uint32_t> texture_coordinate_indices;
+        int32_t material_index;
+    };
+
+    // Splits the faces of every shape into one piece per material, keeping the obj's separate attribute indices
+    std::vector<PreprocessedPiece> make_pieces(std::vector<tinyobj::shape_t> shapes);
+
+    // Deduplicates (position, normal, texture coordinate) triples into a single index buffer per piece, and bounds each piece
+    IndexedVertexData reindex_pieces(std::vector<PreprocessedPiece>& pieces, std::vector<glm::vec3>& raw_positions, std::vector<glm::vec3>& raw_normals, std::vector<glm::vec2>& raw_texture_coordinates);
+}
+#endif
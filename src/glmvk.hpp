@@ -6,5 +6,6 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/constants.hpp"
 #include "glm/gtx/rotate_vector.hpp"
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "job_pool.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace job_pool {
+    size_t default_thread_count() {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    void run(const size_t job_count, const size_t thread_count, const char* worker_name, const std::function<void(const size_t)>& job) {
+        std::atomic<size_t> next_job = 0;
+        auto work = [&]() {
+            for (size_t index = next_job.fetch_add(1); index < job_count; index = next_job.fetch_add(1)) {
+                job(index);
+            }
+        };
+
+        // The calling thread pulls its weight too, so only the rest need spawning
+        size_t worker_count = std::min(std::max<size_t>(1, thread_count), job_count);
+        std::vector<std::thread> workers;
+        for (size_t worker = 1; worker < worker_count; ++worker) {
+            workers.emplace_back([&, worker]() {
+                std::string name = std::string(worker_name) + " " + std::to_string(worker);
+                TRACE_THREAD_NAME(name.c_str());
+                work();
+            });
+        }
+        work();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+}
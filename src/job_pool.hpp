@@ -0,0 +1,16 @@
+#ifndef JOB_POOL_H_
+#define JOB_POOL_H_
+
+#include <cstddef>
+#include <functional>
+
+namespace job_pool {
+    // One worker per hardware thread, or one if the platform can't tell
+    size_t default_thread_count();
+
+    // Runs job(index) for every index below job_count on up to thread_count threads, the calling thread included.
+    // Jobs are handed out in index order as threads free up. Returns once every job has finished
+    void run(const size_t job_count, const size_t thread_count, const char* worker_name, const std::function<void(const size_t)>& job);
+}
+
+#endif // JOB_POOL_H_
@@ -0,0 +1,71 @@
+#include "lights.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace lights {
+    namespace {
+        // Lights fill a shell around the jar, from just outside it to about where the camera sits
+        const float SHELL_INNER_RADIUS = 1.5f;
+        const float SHELL_OUTER_RADIUS = 5.0f;
+        // Radius and intensity at REFERENCE_COUNT lights, scaled by the cube root of the count from there
+        const float REFERENCE_COUNT = 1000.0f;
+        const float REFERENCE_RADIUS = 1.0f;
+        const float MAX_RADIUS = 4.0f;
+        const float REFERENCE_INTENSITY = 20000.0f;
+        const float MIN_ORBIT_SPEED = 0.001f;
+        const float MAX_ORBIT_SPEED = 0.005f;
+        const uint32_t SEED = 0x6a61726cu;
+    }
+
+    LightField generate(const uint32_t count) {
+        LightField field = {};
+        field.lights.reserve(count);
+        field.orbit_speeds.reserve(count);
+        if (count == 0) {
+            return field;
+        }
+
+        float radius = std::min(REFERENCE_RADIUS * std::cbrt(REFERENCE_COUNT / static_cast<float>(count)), MAX_RADIUS);
+        // Intensity follows the area the light covers so the scene stays about as bright at any count
+        float intensity = REFERENCE_INTENSITY * (radius * radius) / (REFERENCE_RADIUS * REFERENCE_RADIUS);
+
+        std::mt19937 generator(SEED);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        const glm::vec3 warm = glm::vec3(1.0f, 0.62f, 0.32f);
+        const glm::vec3 cool = glm::vec3(0.58f, 0.72f, 1.0f);
+        for (uint32_t index = 0; index < count; ++index) {
+            // Uniform direction, then a distance into the shell
+            float z = unit(generator) * 2.0f - 1.0f;
+            float azimuth = unit(generator) * glm::two_pi<float>();
+            float ring = std::sqrt(1.0f - z * z);
+            glm::vec3 direction = glm::vec3(ring * std::cos(azimuth), z, ring * std::sin(azimuth));
+            float distance = SHELL_INNER_RADIUS + unit(generator) * (SHELL_OUTER_RADIUS - SHELL_INNER_RADIUS);
+
+            PointLight light = {};
+            light.position_radius = glm::vec4(direction * distance, radius);
+            light.color_intensity = glm::vec4(glm::mix(warm, cool, unit(generator)), intensity);
+            field.lights.push_back(light);
+
+            float speed = MIN_ORBIT_SPEED + unit(generator) * (MAX_ORBIT_SPEED - MIN_ORBIT_SPEED);
+            field.orbit_speeds.push_back(unit(generator) < 0.5f ? -speed : speed);
+        }
+        return field;
+    }
+
+    void write_frame(const LightField& field, const uint64_t frame_num, PointLight* destination) {
+        for (size_t index = 0; index < field.lights.size(); ++index) {
+            // Wrapped in double precision, so the angle stays accurate however long the run goes
+            double angle = std::fmod(static_cast<double>(field.orbit_speeds[index]) * static_cast<double>(frame_num), glm::two_pi<double>());
+            float cos_angle = static_cast<float>(std::cos(angle));
+            float sin_angle = static_cast<float>(std::sin(angle));
+
+            const PointLight& start = field.lights[index];
+            PointLight light = start;
+            light.position_radius.x = start.position_radius.x * cos_angle - start.position_radius.z * sin_angle;
+            light.position_radius.z = start.position_radius.x * sin_angle + start.position_radius.z * cos_angle;
+            destination[index] = light;
+        }
+    }
+}
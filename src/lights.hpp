@@ -0,0 +1,34 @@
+#ifndef LIGHTS_H_
+#define LIGHTS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "glmvk.hpp"
+
+// Point lights scattered around the jar. Generated once, then moved along their orbits and written out every frame
+namespace lights {
+    // Matches PointLight in point_lights.glsl
+    struct PointLight {
+        // World space position, radius of influence in w
+        glm::vec4 position_radius;
+        // Linear color, intensity in w
+        glm::vec4 color_intensity;
+    };
+
+    struct LightField {
+        // Where each light starts, frame 0 of its orbit
+        std::vector<PointLight> lights;
+        // Radians per frame around the world y axis
+        std::vector<float> orbit_speeds;
+    };
+
+    // Deterministic for a given count so benchmark runs see the same lights. Radii shrink as the count grows,
+    // keeping roughly the same number of lights over any one point, so a larger count measures culling rather than shading
+    LightField generate(const uint32_t count);
+
+    // Writes every light as it is on this frame to destination, which must hold lights.size() of them
+    void write_frame(const LightField& field, const uint64_t frame_num, PointLight* destination);
+}
+
+#endif // LIGHTS_H_
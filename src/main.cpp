@@ -1,90 +1,104 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include <stdio.h>
 
 #include "vk_types.hpp"
 #include "vk_init.hpp"
+#include "vk_image.hpp"
 #include "vk_layer.hpp"
 #include "vk_buffer.hpp"
 #include "geometry.hpp"
+#include "frame_stats.hpp"
+#include "options.hpp"
+#include "vk_profiler.hpp"
+#include "trace.hpp"
+#include "scene.hpp"
+#include "bench.hpp"
+#include "vk_pipeline_cache.hpp"
+#include "job_pool.hpp"
+#include "workgroup_tuning.hpp"
+#include "dynamic_resolution.hpp"
+#include "render_formats.hpp"
 
-int main() {
-    glfwInit();
+int main(int argc, char** argv) {
+    auto program_start = std::chrono::steady_clock::now();
+    options::Options settings = options::parse(argc, argv);
+    if (settings.trace_path.has_value()) {
+        if (!trace::compiled_in()) {
+            printf("Tracing is not compiled into this build, rebuild with TRACE=1 to use --trace\n");
+        }
+        trace::Settings trace_settings = {
+            .first_frame = settings.trace_first_frame,
+            .frame_count = settings.trace_frame_count,
+            .events_per_thread = 1 << 16
+        };
+        trace::start(trace_settings);
+    }
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    //GLFWwindow* window = glfwCreateWindow(1600, 1200, "Galaxy Jar", nullptr, nullptr);
-    GLFWwindow* window = glfwCreateWindow(3000, 2000, "Galaxy Jar", nullptr, nullptr);
+    // Settled before the swapchain is made, since direct compose changes its format
+    if (settings.direct_compose && settings.png_path.has_value()) {
+        printf("Reading back the final frame needs it in the compose target, ignoring --direct-compose\n");
+        settings.direct_compose = false;
+    }
 
-    // Query glfw extensions
-    uint32_t extensionCount = 0;
-    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    GLFWwindow* window = nullptr;
+    vk_types::Context context = {};
+    // Debug labels are nice to have for captures and profiling, but nothing depends on them
+    std::vector<const char*> optional_instance_extensions = vk_profiler::optional_instance_extensions();
+    const uint8_t frames_in_flight = static_cast<uint8_t>(settings.frames_in_flight);
+    if (settings.headless) {
+        // No surface or swapchain, so no extensions are required. Runs fine under a software ICD like lavapipe
+        std::vector<const char*> required_device_extensions = {};
+        std::vector<const char*> instance_extensions = optional_instance_extensions;
+        VkExtent2D offscreen_extent = { settings.width, settings.height };
+        context = vk_init::init_headless(required_device_extensions, instance_extensions, offscreen_extent, frames_in_flight);
+    }
+    else {
+        glfwInit();
 
-    uint32_t glfw_extension_count = 0;
-    const char** glfw_extensions_data;
-    glfw_extensions_data = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-    std::vector<const char*> glfw_extensions(glfw_extensions_data, glfw_extensions_data+glfw_extension_count);
-    
-    // Dictate which extensions we need
-    std::vector<const char*> required_device_extensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
-    };
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        window = glfwCreateWindow(static_cast<int>(settings.width), static_cast<int>(settings.height), "Galaxy Jar", nullptr, nullptr);
 
-    // Initialize vulkan
-    vk_types::Context context = vk_init::init(required_device_extensions, glfw_extensions, window);
-    
-    /// Setup for skybox background draw
-    vk_layer::BufferedUniform<vk_layer::SkyboxUniforms> skybox_uniforms = vk_layer::build_skybox_uniforms(context, context.buffer_count, context.cleanup_procedures);
-    vk_image::HostImage skybox_image = vk_image::load_rgba_cubemap("../../../assets/skybox/space-skybox.png");
-    uint32_t skybox_texture_index = vk_layer::upload_skybox(context, skybox_image, context.cleanup_procedures);
-    vk_layer::Drawable skybox_cube;
-    {
-        geometry::AxisAlignedBasis basis = {
-            .x = geometry::Direction::Right,
-            .y = geometry::Direction::Up,
-            .z = geometry::Direction::Forward
-        };
-        geometry::HostModel cube_model = geometry::load_obj_model("cube.obj", "../../../assets/cube/", basis);
-        skybox_cube = vk_layer::make_drawable(context, cube_model);
-    }
-
-    /// Setup for main geometry draw
-    // Load other resources. We don't need the HostModel past upload so we can just dump it on the ground after upload since it can be pretty hefty.
-    vk_layer::Drawable dummy_drawable;
-    vk_layer::Drawable jar_drawable;
-    {
-        geometry::AxisAlignedBasis blender_basis = {
-            .x = geometry::Direction::Right,
-            .y = geometry::Direction::Back,
-            .z = geometry::Direction::Up
-        };
+        // Query glfw extensions
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
 
-        geometry::AxisAlignedBasis unmodified_basis = {
-            .x = geometry::Direction::Right,
-            .y = geometry::Direction::Up,
-            .z = geometry::Direction::Forward
+        uint32_t glfw_extension_count = 0;
+        const char** glfw_extensions_data;
+        glfw_extensions_data = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+        std::vector<const char*> glfw_extensions(glfw_extensions_data, glfw_extensions_data+glfw_extension_count);
+        glfw_extensions.insert(glfw_extensions.end(), optional_instance_extensions.begin(), optional_instance_extensions.end());
+        
+        // Dictate which extensions we need
+        std::vector<const char*> required_device_extensions = {
+            VK_KHR_SWAPCHAIN_EXTENSION_NAME
         };
-        //geometry::HostModel dummy_model = geometry::load_obj_model("exterior.obj", "../../../assets/bistro/", unmodified_basis);
-        geometry::HostModel dummy_model = geometry::load_obj_model("planetoid.obj", "../../../assets/planetoid/", blender_basis);
-        geometry::HostModel jar_model = geometry::load_obj_model("WATER_WORLD.obj", "../../../assets/planetoid/", blender_basis);
-        dummy_drawable = vk_layer::make_drawable(context, dummy_model);
-        jar_drawable = vk_layer::make_drawable(context, jar_model);
-        auto transform = jar_drawable.transform.get();
-        jar_drawable.transform.set(glm::scale(transform, glm::vec3(2.0f, 2.0f, 2.0f)));
-        jar_drawable.transform.push(0);
-        jar_drawable.transform.push(1);
+
+        // Initialize vulkan
+        context = vk_init::init(required_device_extensions, glfw_extensions, window, settings.direct_compose, frames_in_flight);
     }
+    
+    /// Load the scene into the geometry arena. Host side model data is dropped as soon as it's uploaded since it can be pretty hefty
+    vk_buffer::init_geometry_arena(context, settings.geometry_vertex_capacity, settings.geometry_index_capacity, context.cleanup_procedures);
+    scene::SceneDescription scene_description = settings.scene_path.has_value() ? 
+        scene::load_scene_file(settings.scene_path.value()) :
+        scene::default_scene();
+    scene::Scene loaded_scene = scene::load_scene(context, scene_description);
+    std::vector<vk_layer::Drawable>& main_drawables = loaded_scene.drawables;
+    std::vector<vk_layer::Drawable>& masking_jars = loaded_scene.masking_jars;
+    std::vector<vk_layer::InstancedDrawable>& instanced_drawables = loaded_scene.instanced_drawables;
 
-    std::vector<vk_layer::Drawable> main_drawables = {dummy_drawable};
-    std::vector<vk_layer::Drawable> masking_jars = {jar_drawable};
+    vk_layer::BufferedUniform<vk_layer::GlobalUniforms> global_uniforms = vk_layer::build_global_uniforms(context, context.buffer_count, context.cleanup_procedures);
 
+    // The skybox unprojects with the camera's own matrices
     std::vector<VkDescriptorSetLayout> skybox_descriptor_set_layouts = { 
-        skybox_uniforms.get_layout(),
+        global_uniforms.get_layout(),
         context.mega_descriptor_set.bundle.layout
     };
 
-    vk_layer::BufferedUniform<vk_layer::GlobalUniforms> global_uniforms = vk_layer::build_global_uniforms(context, context.buffer_count, context.cleanup_procedures);
-
     std::vector<VkDescriptorSetLayout> grid_descriptor_set_layouts = {
         context.mega_descriptor_set.bundle.layout
     };
@@ -106,35 +120,314 @@ int main() {
         context.mega_descriptor_set.bundle.layout
     };
 
+    // Shading from the visibility buffer needs the camera, everything else comes through the draw records and the mega set
+    std::vector<VkDescriptorSetLayout> visibility_shade_descriptor_set_layouts = {
+        global_uniforms.get_layout(),
+        context.mega_descriptor_set.bundle.layout
+    };
+
+    // Light culling reads the camera and the depth target, the lights come in by address
+    std::vector<VkDescriptorSetLayout> light_culling_descriptor_set_layouts = {
+        global_uniforms.get_layout(),
+        context.mega_descriptor_set.bundle.layout
+    };
+
+    // The pyramid and culling passes read depth and the pyramid through the mega set, bounds and draws come in by address
+    std::vector<VkDescriptorSetLayout> occlusion_culling_descriptor_set_layouts = {
+        context.mega_descriptor_set.bundle.layout
+    };
+
     vk_layer::DescriptorSetLayouts descriptor_layouts = {
         grid_descriptor_set_layouts,
         skybox_descriptor_set_layouts,
         jar_cutaway_mask_descriptor_set_layouts,
         graphics_descriptor_set_layouts,
-        compose_descriptor_set_layouts
+        compose_descriptor_set_layouts,
+        visibility_shade_descriptor_set_layouts,
+        light_culling_descriptor_set_layouts,
+        occlusion_culling_descriptor_set_layouts
     };
 
-    vk_layer::RenderTargets render_targets = vk_layer::build_render_targets(context, context.cleanup_procedures);
-    vk_layer::Pipelines pipelines = vk_layer::build_pipelines(context, descriptor_layouts, render_targets, context.cleanup_procedures);
+    vk_layer::RenderSettings render_settings = {
+        .fused_compose = settings.fused_compose,
+        .depth_prepass = settings.depth_prepass,
+        .visibility_buffer = settings.visibility_buffer,
+        .tiled_lights = settings.light_count > 0,
+        .classified_compose = settings.classified_compose,
+        .stencil_jar_mask = settings.stencil_jar_mask,
+        .feathered_jar_mask = settings.feathered_jar_mask,
+        .direct_compose = settings.direct_compose,
+        .occlusion_culling = settings.occlusion_culling,
+        .frustum_culling = settings.frustum_culling,
+        .async_compute = settings.async_compute,
+        .vertex_pulling = settings.vertex_pulling,
+        .instancing = !instanced_drawables.empty()
+    };
+    if (render_settings.direct_compose && !context.swapchain.storage) {
+        printf("No swapchain compute can write to, composing through the blit instead\n");
+        render_settings.direct_compose = false;
+    }
+    if (render_settings.async_compute && render_settings.fused_compose) {
+        printf("A fused compose has no grid pass to move, ignoring --async-compute\n");
+        render_settings.async_compute = false;
+    }
+    if (render_settings.async_compute && (context.queues.compute == VK_NULL_HANDLE)) {
+        printf("Device has no compute only queue family, running the grid pass on the graphics queue\n");
+        render_settings.async_compute = false;
+    }
+    if (render_settings.visibility_buffer && !vk_layer::supports_visibility_buffer(context)) {
+        printf("Device does not support the geometryShader feature the visibility buffer needs, forward shading instead\n");
+        render_settings.visibility_buffer = false;
+    }
+    if (render_settings.visibility_buffer && render_settings.instancing) {
+        printf("The visibility buffer has no draw records for instanced drawables, leaving them out\n");
+        render_settings.instancing = false;
+    }
+    if (render_settings.visibility_buffer && render_settings.depth_prepass) {
+        printf("The visibility buffer already shades each pixel once, ignoring --depth-prepass\n");
+        render_settings.depth_prepass = false;
+    }
+    if (render_settings.tiled_lights && !render_settings.visibility_buffer && !render_settings.depth_prepass) {
+        printf("Culling point lights needs the scene's depth first, turning on the depth pre-pass\n");
+        render_settings.depth_prepass = true;
+    }
+    vk_layer::VisibilityDrawRecords visibility_draw_records = {};
+    if (render_settings.visibility_buffer) {
+        visibility_draw_records = vk_layer::build_visibility_draw_records(context, main_drawables, context.cleanup_procedures);
+    }
+    if (settings.space_format.has_value()) {
+        render_settings.formats.space = render_formats::parse_color_format("--space-format", settings.space_format.value());
+    }
+    if (settings.grid_format.has_value()) {
+        render_settings.formats.grid = render_formats::parse_color_format("--grid-format", settings.grid_format.value());
+    }
+    if (settings.compose_format.has_value()) {
+        render_settings.formats.compose = render_formats::parse_color_format("--compose-format", settings.compose_format.value());
+    }
+    if (settings.mask_format.has_value()) {
+        render_settings.formats.jar_mask = render_formats::parse_mask_format("--mask-format", settings.mask_format.value());
+    }
+    render_settings = vk_layer::check_target_formats(context, render_settings);
+    vk_layer::RenderTargets render_targets = vk_layer::build_render_targets(context, render_settings, context.cleanup_procedures);
+    const std::vector<render_formats::TargetTraffic> target_traffic = vk_layer::target_traffic(render_settings, render_targets.compose_storage.image_extent);
+    render_formats::print_traffic(target_traffic, render_targets.compose_storage.image_extent);
+    vk_layer::LightResources light_resources = {};
+    if (render_settings.tiled_lights) {
+        light_resources = vk_layer::build_light_resources(context, settings.light_count, render_targets, context.cleanup_procedures);
+    }
+    vk_layer::OcclusionCulling occlusion_culling = {};
+    if (render_settings.occlusion_culling) {
+        occlusion_culling = vk_layer::build_occlusion_culling(context, main_drawables, render_targets, context.cleanup_procedures);
+    }
+    if (render_settings.fused_compose) {
+        uint64_t bytes_saved = vk_layer::fused_compose_bytes_saved(render_targets.compose_storage.image_extent, render_settings.formats.grid);
+        printf("Fused compose skips %.1fMiB of grid target traffic per frame\n", static_cast<double>(bytes_saved) / (1024.0 * 1024.0));
+    }
+    vk_pipeline_cache::PipelineCache pipeline_cache = vk_pipeline_cache::init_pipeline_cache(context, settings.pipeline_cache_path.value_or(""), context.cleanup_procedures);
+    vk_layer::PipelineSettings pipeline_settings = {
+        .thread_count = (settings.pipeline_threads > 0) ? settings.pipeline_threads : job_pool::default_thread_count(),
+        .shader_directory = settings.shader_directory.value_or(""),
+        .workgroup_sizes = workgroup_tuning::default_sizes()
+    };
+    if (settings.autotune) {
+        pipeline_settings.workgroup_sizes = vk_layer::autotune_workgroup_sizes(context, descriptor_layouts, render_targets, pipeline_cache, render_settings, pipeline_settings, context.cleanup_procedures);
+        workgroup_tuning::save(settings.workgroup_sizes_path, context.gpu, pipeline_settings.workgroup_sizes);
+    }
+    else if (auto saved_sizes = workgroup_tuning::load(settings.workgroup_sizes_path, context.gpu)) {
+        pipeline_settings.workgroup_sizes = *saved_sizes;
+    }
+    printf("Compute workgroup sizes: grid %ux%u, compose %ux%u\n",
+        pipeline_settings.workgroup_sizes.grid.width, pipeline_settings.workgroup_sizes.grid.height,
+        pipeline_settings.workgroup_sizes.compose.width, pipeline_settings.workgroup_sizes.compose.height);
+    auto pipelines_start = std::chrono::steady_clock::now();
+    vk_layer::Pipelines pipelines = vk_layer::build_pipelines(context, descriptor_layouts, render_targets, pipeline_cache, render_settings, pipeline_settings, context.cleanup_procedures);
+    double pipelines_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelines_start).count();
+    printf("Built pipelines on up to %zu threads in %.3fms\n", pipeline_settings.thread_count, pipelines_ms);
+    vk_pipeline_cache::print_report(pipeline_cache);
+    // Saved as soon as everything is built so a later crash doesn't cost the next launch a cold start
+    vk_pipeline_cache::save(pipeline_cache);
 
-    
+
+    vk_profiler::Settings profiler_settings = {
+        .timing = settings.gpu_profile,
+        .pipeline_statistics = settings.pipeline_statistics,
+        .debug_labels = !optional_instance_extensions.empty(),
+        .rolling_window = 240,
+        .report_interval = settings.gpu_profile_interval,
+        .async_compute = render_settings.async_compute
+    };
+    vk_profiler::GpuProfiler gpu_profiler = vk_profiler::init_profiler(context, profiler_settings, context.cleanup_procedures);
+
+    // Benchmarks run their warmup on top of the measured frames, and neither it nor the load is included in frame statistics
+    const bool benchmarking = settings.benchmark_path.has_value();
+    const uint64_t warmup_frames = benchmarking ? settings.warmup_frames : 0;
+    const uint64_t total_frames = (settings.frame_count > 0) ? settings.frame_count + warmup_frames : 0;
+    gpu_profiler.first_sampled_frame = warmup_frames;
 
     vk_layer::DrawState draw_state = {
         .buf_num = 0,
         .frame_num = 0,
         .frame_in_flight = 0,
         .main_dynamic_uniforms = global_uniforms,
-        .skybox_dynamic_uniforms = skybox_uniforms
+        .gpu_profiler = &gpu_profiler,
+        .animate_uniforms = benchmarking ? vk_layer::scripted_camera_path(global_uniforms.get()) : vk_layer::spin_view(),
+        .render_settings = render_settings,
+        .lights = &light_resources,
+        .resolution = nullptr,
+        .occlusion = &occlusion_culling,
+        .frustum_culled_pieces = 0,
+        .frustum_cull_ms = 0.0
     };
+    dynamic_resolution::Controller resolution_controller = {};
+    if (settings.dynamic_resolution_target_ms.has_value()) {
+        resolution_controller = dynamic_resolution::init({
+            .target_frame_ms = settings.dynamic_resolution_target_ms.value(),
+            .min_scale = settings.dynamic_resolution_min_scale,
+            .max_scale = 1.0f
+        });
+        draw_state.resolution = &resolution_controller;
+        printf("Dynamic resolution targeting %.2fms GPU frames, down to %.0f%% of %ux%u\n", resolution_controller.settings.target_frame_ms,
+            resolution_controller.settings.min_scale * 100.0f, render_targets.compose_storage.image_extent.width, render_targets.compose_storage.image_extent.height);
+    }
+
     
-    while(!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        draw_state = vk_layer::draw(context, pipelines, render_targets, main_drawables, masking_jars, skybox_cube, skybox_texture_index, draw_state);
+    std::vector<double> frame_times_ms;
+    frame_times_ms.reserve(settings.frame_count);
+    std::vector<double> resolution_scales;
+    resolution_scales.reserve(settings.frame_count);
+    std::vector<double> frustum_cull_times_ms;
+    frustum_cull_times_ms.reserve(settings.frame_count);
+    uint64_t frustum_culled_pieces = 0;
+    // What the last drawn frame rendered into, the rest of compose_storage is left over from earlier frames
+    VkExtent2D last_render_extent = render_targets.compose_storage.image_extent;
+    uint64_t peak_device_memory_bytes = benchmarking ? bench::device_memory_usage_bytes(context.allocator) : 0;
+    auto load_end = std::chrono::steady_clock::now();
+    double load_time_ms = std::chrono::duration<double, std::milli>(load_end - program_start).count();
+    auto previous_frame_end = load_end;
+    auto keep_drawing = [&]() {
+        if ((total_frames > 0) && (draw_state.frame_num >= total_frames)) {
+            return false;
+        }
+        return settings.headless || !glfwWindowShouldClose(window);
+    };
+    while(keep_drawing()) {
+        TRACE_FRAME_MARK();
+        if (!settings.headless) {
+            TRACE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
+        {
+            TRACE_ZONE("draw");
+            draw_state = vk_layer::draw(context, pipelines, render_targets, main_drawables, masking_jars, instanced_drawables, visibility_draw_records, loaded_scene.skybox_texture_index, draw_state);
+        }
+
+        auto frame_end = std::chrono::steady_clock::now();
+        // The draw leaves the controller at the scale it rendered with
+        const float frame_scale = (draw_state.resolution != nullptr) ? draw_state.resolution->scale : 1.0f;
+        last_render_extent = dynamic_resolution::scaled_extent(render_targets.compose_storage.image_extent, frame_scale);
+        // frame_num has already moved on to the next frame
+        if (draw_state.frame_num > warmup_frames) {
+            frame_times_ms.push_back(std::chrono::duration<double, std::milli>(frame_end - previous_frame_end).count());
+            resolution_scales.push_back(frame_scale);
+            frustum_cull_times_ms.push_back(draw_state.frustum_cull_ms);
+            frustum_culled_pieces += draw_state.frustum_culled_pieces;
+        }
+        previous_frame_end = frame_end;
+        if (benchmarking) {
+            peak_device_memory_bytes = std::max(peak_device_memory_bytes, bench::device_memory_usage_bytes(context.allocator));
+        }
+    }
+    vkDeviceWaitIdle(context.device);
+
+    if (settings.png_path.has_value()) {
+        // The last frame leaves compose_storage as a transfer source, whether or not it was blitted to a swapchain
+        vk_types::AllocatedImage rendered_corner = render_targets.compose_storage;
+        rendered_corner.image_extent = last_render_extent;
+        vk_image::HostImage final_image = vk_image::read_back_image_srgb8(context, rendered_corner, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vk_image::write_png(settings.png_path.value(), final_image);
+        printf("Wrote final frame to %s\n", settings.png_path.value().c_str());
+    }
+
+    if (settings.headless || settings.frame_count > 0) {
+        printf("Rendered %llu frames at %ux%u\n", static_cast<unsigned long long>(draw_state.frame_num), render_targets.compose_storage.image_extent.width, render_targets.compose_storage.image_extent.height);
+        frame_stats::print_summary("CPU frame time", "ms", frame_stats::summarize(frame_times_ms));
+    }
+
+    // Counted from every frame whose counters were read back, which leaves out the last few still in flight at exit
+    auto per_counted_frame = [&](const uint64_t total) {
+        return (occlusion_culling.counted_frames > 0) ? static_cast<double>(total) / static_cast<double>(occlusion_culling.counted_frames) : 0.0;
+    };
+    if (render_settings.occlusion_culling) {
+        printf("Occlusion culling over %llu frames, per frame: %.1f of %u pieces drawn early, %.1f drawn late, %.1f frustum culled, %.1f occlusion culled\n",
+            static_cast<unsigned long long>(occlusion_culling.counted_frames), per_counted_frame(occlusion_culling.early_drawn), occlusion_culling.piece_count,
+            per_counted_frame(occlusion_culling.late_drawn), per_counted_frame(occlusion_culling.frustum_culled), per_counted_frame(occlusion_culling.occlusion_culled));
+    }
+
+    if (settings.gpu_profile) {
+        // The last few frames are still sitting in their slots since nothing came along to reuse them
+        vk_profiler::resolve_outstanding(gpu_profiler, draw_state.buf_num);
+        vk_profiler::print_report(gpu_profiler, false);
+        if (settings.gpu_profile_json_path.has_value()) {
+            vk_profiler::write_json(gpu_profiler, settings.gpu_profile_json_path.value());
+            printf("Wrote GPU profile to %s\n", settings.gpu_profile_json_path.value().c_str());
+        }
+    }
+
+    if (benchmarking) {
+        bench::Report report = {};
+        report.device_name = gpu_profiler.device_name;
+        report.scene = settings.scene_path.value_or("default");
+        report.width = render_targets.compose_storage.image_extent.width;
+        report.height = render_targets.compose_storage.image_extent.height;
+        report.headless = settings.headless;
+        report.fused_compose = render_settings.fused_compose;
+        report.classified_compose = render_settings.classified_compose;
+        report.direct_compose = render_settings.direct_compose;
+        report.jar_mask = !render_settings.stencil_jar_mask ? "color" : (render_settings.feathered_jar_mask ? "stencil_feathered" : "stencil");
+        report.target_traffic = target_traffic;
+        report.depth_prepass = render_settings.depth_prepass;
+        report.visibility_buffer = render_settings.visibility_buffer;
+        report.occlusion_culling = render_settings.occlusion_culling;
+        report.early_drawn_pieces = per_counted_frame(occlusion_culling.early_drawn);
+        report.late_drawn_pieces = per_counted_frame(occlusion_culling.late_drawn);
+        report.frustum_culled_pieces = per_counted_frame(occlusion_culling.frustum_culled);
+        report.occlusion_culled_pieces = per_counted_frame(occlusion_culling.occlusion_culled);
+        report.frustum_culling = render_settings.frustum_culling;
+        report.async_compute = render_settings.async_compute;
+        report.vertex_pulling = render_settings.vertex_pulling;
+        report.instance_count = 0;
+        if (render_settings.instancing) {
+            for (const vk_layer::InstancedDrawable& instanced : instanced_drawables) {
+                report.instance_count += static_cast<uint32_t>(instanced.transforms.size());
+            }
+        }
+        report.cpu_frustum_culled_pieces = frustum_cull_times_ms.empty() ? 0.0 : static_cast<double>(frustum_culled_pieces) / static_cast<double>(frustum_cull_times_ms.size());
+        report.frustum_cull_ms = frame_stats::summarize(frustum_cull_times_ms);
+        report.light_count = settings.light_count;
+        report.dynamic_resolution_target_ms = settings.dynamic_resolution_target_ms.value_or(0.0);
+        report.resolution_scale = frame_stats::summarize(resolution_scales);
+        report.frames_in_flight = context.buffer_count;
+        report.warmup_frames = warmup_frames;
+        report.measured_frames = settings.frame_count;
+        report.load_time_ms = load_time_ms;
+        report.cpu_frame_ms = frame_stats::summarize(frame_times_ms);
+        report.gpu_frame_ms = vk_profiler::summarize_pass(gpu_profiler, vk_profiler::Pass::Frame, false);
+        report.peak_host_memory_bytes = bench::peak_host_memory_bytes();
+        report.peak_device_memory_bytes = peak_device_memory_bytes;
+        bench::print_report(report);
+        bench::write_report_json(settings.benchmark_path.value(), report, gpu_profiler);
+        printf("Wrote benchmark report to %s\n", settings.benchmark_path.value().c_str());
+    }
+
+    if (settings.trace_path.has_value() && trace::compiled_in()) {
+        trace::write_chrome_json(settings.trace_path.value());
     }
 
     vk_layer::cleanup(context, context.cleanup_procedures);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (!settings.headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
     
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,272 @@
+#include "options.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace options {
+    namespace {
+        const uint64_t DEFAULT_HEADLESS_FRAME_COUNT = 100;
+        const uint64_t DEFAULT_BENCHMARK_FRAME_COUNT = 600;
+        const uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+
+        void print_usage(const char* program_name) {
+            printf("Usage: %s [options]\n", program_name);
+            printf("  --headless                   Render offscreen without a window\n");
+            printf("  --width <pixels>             Window or offscreen target width (default 3000)\n");
+            printf("  --height <pixels>            Window or offscreen target height (default 2000)\n");
+            printf("  --frames <count>             Number of frames to draw before exiting (headless default %llu)\n", static_cast<unsigned long long>(DEFAULT_HEADLESS_FRAME_COUNT));
+            printf("  --png <path>                 Write the final composed image to a PNG on exit\n");
+            printf("  --frames-in-flight <count>   Frames the CPU may record ahead of the GPU, 1 to %u (default 2)\n", MAX_FRAMES_IN_FLIGHT);
+            printf("  --gpu-profile                Time each pass on the GPU and print rolling statistics\n");
+            printf("  --gpu-profile-interval <n>   Frames between GPU statistics printouts, 0 for only at exit (default 120)\n");
+            printf("  --gpu-profile-json <path>    Write per pass GPU statistics to a JSON file on exit, implies --gpu-profile\n");
+            printf("  --trace <path>               Write a Chrome trace of startup and a window of frames on exit (needs a tracing build)\n");
+            printf("  --trace-first-frame <n>      First frame of the trace window (default 0)\n");
+            printf("  --trace-frames <count>       Number of frames in the trace window (default 120)\n");
+            printf("  --scene <path>               Load a scene file instead of the built in scene\n");
+            printf("  --benchmark <path>           Run a scripted camera path and write a JSON report, --frames are measured (default %llu)\n", static_cast<unsigned long long>(DEFAULT_BENCHMARK_FRAME_COUNT));
+            printf("  --warmup <count>             Unmeasured frames before a benchmark (default 60)\n");
+            printf("  --pipeline-cache <path>      Pipeline cache file to load and save (default pipeline_cache.bin)\n");
+            printf("  --no-pipeline-cache          Don't load or save a pipeline cache, every pipeline is compiled cold\n");
+            printf("  --pipeline-threads <count>   Threads compiling pipelines at startup, 0 for one per hardware thread (default 0)\n");
+            printf("  --shader-dir <path>          Load compiled .spv shaders from a directory instead of the embedded ones\n");
+            printf("  --fused-compose              Draw the grid inside the compose pass, skipping the grid target\n");
+            printf("  --classify-compose           Compose tiles the jar mask fully covers or misses with a plain copy, blending only its outline\n");
+            printf("  --stencil-jar-mask           Mark the jar in the space depth buffer's stencil and only draw the space scene inside it\n");
+            printf("  --feathered-jar-mask         Soften the stencil jar mask's edge with a half resolution mask, implies --stencil-jar-mask\n");
+            printf("  --direct-compose             Compose straight into the swapchain when it allows storage, skipping the final blit\n");
+            printf("  --depth-prepass              Draw space scene depth first so each pixel is shaded once\n");
+            printf("  --visibility-buffer          Rasterize draw and triangle IDs for the space scene, then shade each pixel once in compute\n");
+            printf("  --occlusion-culling          Skip drawing pieces of the space scene hidden behind nearer ones or outside the jar\n");
+            printf("  --no-frustum-culling         Record draws for every piece of the space scene, even those outside the camera's view\n");
+            printf("  --async-compute              Run the grid pass on a compute only queue, overlapping the raster passes\n");
+            printf("  --vertex-pulling             Fetch space scene vertices through buffer addresses instead of bound vertex buffers\n");
+            printf("  --geometry-vertices <count>  Vertices the geometry buffer shared by every model holds (default 2097152)\n");
+            printf("  --geometry-indices <count>   Indices the geometry buffer shared by every model holds (default 8388608)\n");
+            printf("  --lights <count>             Add point lights around the jar, culled into screen tiles against depth (default 0)\n");
+            printf("  --dynamic-resolution <ms>    Scale render resolution to keep GPU frame time near a target, implies --gpu-profile\n");
+            printf("  --min-resolution-scale <f>   Smallest fraction of full resolution dynamic resolution may use, 0.1 to 1 (default 0.5)\n");
+            printf("  --space-format <format>      Space target format: rgba16, rgba16f, b10g11r11, a2b10g10r10 or rgba8 (default rgba16)\n");
+            printf("  --grid-format <format>       Grid target format, same choices (default rgba16)\n");
+            printf("  --compose-format <format>    Compose target format, same choices (default rgba16)\n");
+            printf("  --mask-format <format>       Jar mask format: r16 or r8 (default r16)\n");
+            printf("  --pipeline-stats             Count fragment shader invocations per pass, implies --gpu-profile\n");
+            printf("  --autotune                   Time compute workgroup size candidates on this device and save the fastest\n");
+            printf("  --workgroup-sizes <path>     File of autotuned workgroup sizes per device (default workgroup_sizes.txt)\n");
+        }
+
+        // Grabs the value following a flag, bailing if there isn't one
+        const char* next_value(int argc, char** argv, int& index) {
+            if (index + 1 >= argc) {
+                printf("Missing value for argument %s\n", argv[index]);
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            return argv[++index];
+        }
+
+        uint64_t parse_unsigned(const char* flag, const char* value) {
+            char* end = nullptr;
+            unsigned long long parsed = strtoull(value, &end, 10);
+            if (end == value || *end != '\0') {
+                printf("Expected an unsigned integer for %s, got %s\n", flag, value);
+                exit(EXIT_FAILURE);
+            }
+            return static_cast<uint64_t>(parsed);
+        }
+
+        double parse_double(const char* flag, const char* value) {
+            char* end = nullptr;
+            double parsed = strtod(value, &end);
+            if (end == value || *end != '\0') {
+                printf("Expected a number for %s, got %s\n", flag, value);
+                exit(EXIT_FAILURE);
+            }
+            return parsed;
+        }
+    }
+
+    Options parse(int argc, char** argv) {
+        Options parsed = {};
+        bool frame_count_given = false;
+
+        for (int index = 1; index < argc; ++index) {
+            const char* argument = argv[index];
+            if (strcmp(argument, "--headless") == 0) {
+                parsed.headless = true;
+            }
+            else if (strcmp(argument, "--width") == 0) {
+                parsed.width = static_cast<uint32_t>(parse_unsigned(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--height") == 0) {
+                parsed.height = static_cast<uint32_t>(parse_unsigned(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--frames") == 0) {
+                parsed.frame_count = parse_unsigned(argument, next_value(argc, argv, index));
+                frame_count_given = true;
+            }
+            else if (strcmp(argument, "--png") == 0) {
+                parsed.png_path = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--frames-in-flight") == 0) {
+                parsed.frames_in_flight = static_cast<uint32_t>(parse_unsigned(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--gpu-profile") == 0) {
+                parsed.gpu_profile = true;
+            }
+            else if (strcmp(argument, "--gpu-profile-interval") == 0) {
+                parsed.gpu_profile_interval = parse_unsigned(argument, next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--gpu-profile-json") == 0) {
+                parsed.gpu_profile_json_path = std::string(next_value(argc, argv, index));
+                parsed.gpu_profile = true;
+            }
+            else if (strcmp(argument, "--trace") == 0) {
+                parsed.trace_path = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--trace-first-frame") == 0) {
+                parsed.trace_first_frame = parse_unsigned(argument, next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--trace-frames") == 0) {
+                parsed.trace_frame_count = parse_unsigned(argument, next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--scene") == 0) {
+                parsed.scene_path = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--benchmark") == 0) {
+                parsed.benchmark_path = std::string(next_value(argc, argv, index));
+                parsed.gpu_profile = true;
+            }
+            else if (strcmp(argument, "--warmup") == 0) {
+                parsed.warmup_frames = parse_unsigned(argument, next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--pipeline-cache") == 0) {
+                parsed.pipeline_cache_path = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--no-pipeline-cache") == 0) {
+                parsed.pipeline_cache_path = std::nullopt;
+            }
+            else if (strcmp(argument, "--pipeline-threads") == 0) {
+                parsed.pipeline_threads = static_cast<uint32_t>(parse_unsigned(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--shader-dir") == 0) {
+                parsed.shader_directory = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--fused-compose") == 0) {
+                parsed.fused_compose = true;
+            }
+            else if (strcmp(argument, "--classify-compose") == 0) {
+                parsed.classified_compose = true;
+            }
+            else if (strcmp(argument, "--stencil-jar-mask") == 0) {
+                parsed.stencil_jar_mask = true;
+            }
+            else if (strcmp(argument, "--feathered-jar-mask") == 0) {
+                parsed.stencil_jar_mask = true;
+                parsed.feathered_jar_mask = true;
+            }
+            else if (strcmp(argument, "--direct-compose") == 0) {
+                parsed.direct_compose = true;
+            }
+            else if (strcmp(argument, "--depth-prepass") == 0) {
+                parsed.depth_prepass = true;
+            }
+            else if (strcmp(argument, "--occlusion-culling") == 0) {
+                parsed.occlusion_culling = true;
+            }
+            else if (strcmp(argument, "--no-frustum-culling") == 0) {
+                parsed.frustum_culling = false;
+            }
+            else if (strcmp(argument, "--async-compute") == 0) {
+                parsed.async_compute = true;
+            }
+            else if (strcmp(argument, "--vertex-pulling") == 0) {
+                parsed.vertex_pulling = true;
+            }
+            else if (strcmp(argument, "--visibility-buffer") == 0) {
+                parsed.visibility_buffer = true;
+            }
+            else if (strcmp(argument, "--geometry-vertices") == 0) {
+                parsed.geometry_vertex_capacity = static_cast<uint32_t>(parse_unsigned(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--geometry-indices") == 0) {
+                parsed.geometry_index_capacity = static_cast<uint32_t>(parse_unsigned(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--lights") == 0) {
+                parsed.light_count = static_cast<uint32_t>(parse_unsigned(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--dynamic-resolution") == 0) {
+                parsed.dynamic_resolution_target_ms = parse_double(argument, next_value(argc, argv, index));
+                parsed.gpu_profile = true;
+            }
+            else if (strcmp(argument, "--min-resolution-scale") == 0) {
+                parsed.dynamic_resolution_min_scale = static_cast<float>(parse_double(argument, next_value(argc, argv, index)));
+            }
+            else if (strcmp(argument, "--space-format") == 0) {
+                parsed.space_format = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--grid-format") == 0) {
+                parsed.grid_format = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--compose-format") == 0) {
+                parsed.compose_format = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--mask-format") == 0) {
+                parsed.mask_format = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--pipeline-stats") == 0) {
+                parsed.pipeline_statistics = true;
+                parsed.gpu_profile = true;
+            }
+            else if (strcmp(argument, "--autotune") == 0) {
+                parsed.autotune = true;
+            }
+            else if (strcmp(argument, "--workgroup-sizes") == 0) {
+                parsed.workgroup_sizes_path = std::string(next_value(argc, argv, index));
+            }
+            else if (strcmp(argument, "--help") == 0) {
+                print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            else {
+                printf("Unknown argument %s\n", argument);
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (parsed.width == 0 || parsed.height == 0) {
+            printf("Width and height must be nonzero\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (parsed.frames_in_flight == 0 || parsed.frames_in_flight > MAX_FRAMES_IN_FLIGHT) {
+            printf("Frames in flight must be between 1 and %u\n", MAX_FRAMES_IN_FLIGHT);
+            exit(EXIT_FAILURE);
+        }
+
+        if (parsed.dynamic_resolution_target_ms.has_value() && !(*parsed.dynamic_resolution_target_ms > 0.0)) {
+            printf("Dynamic resolution target frame time must be positive\n");
+            exit(EXIT_FAILURE);
+        }
+        if (!(parsed.dynamic_resolution_min_scale >= 0.1f && parsed.dynamic_resolution_min_scale <= 1.0f)) {
+            printf("Minimum resolution scale must be between 0.1 and 1\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // There's no window to close when headless, so there has to be an end in sight. Benchmarks always have one
+        if (parsed.benchmark_path.has_value() && !frame_count_given) {
+            parsed.frame_count = DEFAULT_BENCHMARK_FRAME_COUNT;
+        }
+        else if (parsed.headless && !frame_count_given) {
+            parsed.frame_count = DEFAULT_HEADLESS_FRAME_COUNT;
+        }
+        if ((parsed.headless || parsed.benchmark_path.has_value()) && parsed.frame_count == 0) {
+            printf("Headless rendering and benchmarks need a nonzero frame count\n");
+            exit(EXIT_FAILURE);
+        }
+
+        return parsed;
+    }
+}
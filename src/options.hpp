@@ -0,0 +1,91 @@
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace options {
+    struct Options {
+        // Render offscreen without a window, surface, or swapchain
+        bool headless = false;
+        // Size of the window, or of the offscreen render targets when headless
+        uint32_t width = 3000;
+        uint32_t height = 2000;
+        // Number of frames to draw before exiting. 0 runs until the window is closed
+        uint64_t frame_count = 0;
+        // When set, the final composed image is read back and written to this path as a PNG on exit
+        std::optional<std::string> png_path;
+        // Number of frames the CPU may record ahead of the GPU
+        uint32_t frames_in_flight = 2;
+        // Time each pass on the GPU, printing rolling statistics every gpu_profile_interval frames
+        bool gpu_profile = false;
+        uint64_t gpu_profile_interval = 120;
+        // When set, per pass GPU statistics are written to this path as JSON on exit. Implies gpu_profile
+        std::optional<std::string> gpu_profile_json_path;
+        // When set, CPU zones from startup and the frame window below are written to this path as Chrome trace-event JSON on exit
+        std::optional<std::string> trace_path;
+        uint64_t trace_first_frame = 0;
+        uint64_t trace_frame_count = 120;
+        // Scene file to load instead of the built in scene
+        std::optional<std::string> scene_path;
+        // When set, runs warmup_frames followed by frame_count measured frames along a scripted camera path, then writes a report to this path as JSON.
+        // Implies gpu_profile
+        std::optional<std::string> benchmark_path;
+        uint64_t warmup_frames = 60;
+        // Pipeline cache blob to load at startup and save after pipelines are built. Unset keeps the cache in memory only
+        std::optional<std::string> pipeline_cache_path = std::string("pipeline_cache.bin");
+        // Threads compiling pipelines at startup. 0 uses one per hardware thread
+        uint32_t pipeline_threads = 0;
+        // Load compiled shaders from this directory instead of using the ones embedded in the binary, handy while iterating on shaders
+        std::optional<std::string> shader_directory;
+        // Evaluate the grid inside the compose pass instead of going through a full resolution grid target
+        bool fused_compose = false;
+        // Sort screen tiles by jar mask coverage before composing, so only tiles on the jar's outline do the full blend
+        bool classified_compose = false;
+        // Mark the jar's opening in the stencil of the space depth buffer rather than drawing a mask target, and skip the space scene outside it
+        bool stencil_jar_mask = false;
+        // Draw a half resolution mask as well to soften the stencil's hard edge. Implies stencil_jar_mask
+        bool feathered_jar_mask = false;
+        // Compose straight into the swapchain image when it can be written as a storage image, skipping the compose target and the blit
+        bool direct_compose = false;
+        // Draw the space scene's depth with a cheap pass first, so the full shading only runs for visible fragments
+        bool depth_prepass = false;
+        // Shade the space scene from a buffer of draw and triangle IDs instead of forward shading it. Overrides depth_prepass
+        bool visibility_buffer = false;
+        // Cull pieces of the space scene hidden behind nearer ones or outside the jar's opening on the GPU, against a depth pyramid
+        bool occlusion_culling = false;
+        // Skip recording draws for pieces whose bounds are outside the camera's frustum, tested on the CPU every frame
+        bool frustum_culling = true;
+        // Move the grid pass onto a compute only queue so it runs alongside the raster passes, when the device has one
+        bool async_compute = false;
+        // Have the space scene's vertex shaders read attributes through buffer addresses rather than from bound vertex buffers
+        bool vertex_pulling = false;
+        // Room in the geometry arena every model is sub-allocated from, fixed at startup. 32 bytes a vertex and 4 an index
+        uint32_t geometry_vertex_capacity = 1u << 21;
+        uint32_t geometry_index_capacity = 1u << 23;
+        // Scatter this many point lights around the jar and cull them into screen tiles. Brings in depth_prepass unless visibility_buffer is on
+        uint32_t light_count = 0;
+        // When set, the scene renders at whatever fraction of the full resolution keeps GPU frame time near this many milliseconds,
+        // scaled up to the window in the final blit. Implies gpu_profile
+        std::optional<double> dynamic_resolution_target_ms;
+        // Smallest fraction of the full width and height dynamic resolution may drop to
+        float dynamic_resolution_min_scale = 0.5f;
+        // Formats for the intermediate render targets by name, checked against the device at startup. Unset keeps each target's default
+        std::optional<std::string> space_format;
+        std::optional<std::string> grid_format;
+        std::optional<std::string> compose_format;
+        std::optional<std::string> mask_format;
+        // Count fragment shader invocations per pass and report them on exit. Implies gpu_profile
+        bool pipeline_statistics = false;
+        // Time each compute workgroup size candidate on this device at startup and save the fastest to workgroup_sizes_path
+        bool autotune = false;
+        // Workgroup sizes picked by an earlier autotune, keyed on device and driver. Devices without an entry use the defaults
+        std::string workgroup_sizes_path = "workgroup_sizes.txt";
+    };
+
+    // Parses the command line. Prints usage and exits on malformed or unknown arguments
+    Options parse(int argc, char** argv);
+}
+
+#endif // OPTIONS_H_
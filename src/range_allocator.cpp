@@ -0,0 +1,74 @@
+#include "range_allocator.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace range_allocator {
+    RangeAllocator init(const uint32_t capacity) {
+        RangeAllocator allocator = {};
+        allocator.capacity = capacity;
+        allocator.allocated = 0;
+        if (capacity > 0) {
+            allocator.free_ranges[0] = capacity;
+        }
+        return allocator;
+    }
+
+    std::optional<Range> allocate(RangeAllocator& allocator, const uint32_t size) {
+        if (size == 0) {
+            return Range{ 0, 0 };
+        }
+        // Models come and go a handful at a time, so a walk over the free list is cheap next to the upload that follows
+        auto best = allocator.free_ranges.end();
+        for (auto free_range = allocator.free_ranges.begin(); free_range != allocator.free_ranges.end(); ++free_range) {
+            if (free_range->second >= size && (best == allocator.free_ranges.end() || free_range->second < best->second)) {
+                best = free_range;
+            }
+        }
+        if (best == allocator.free_ranges.end()) {
+            return std::nullopt;
+        }
+
+        Range range = { best->first, size };
+        const uint32_t remaining = best->second - size;
+        allocator.free_ranges.erase(best);
+        if (remaining > 0) {
+            allocator.free_ranges[range.offset + size] = remaining;
+        }
+        allocator.allocated += size;
+        return range;
+    }
+
+    void release(RangeAllocator& allocator, const Range range) {
+        if (range.size == 0) {
+            return;
+        }
+        uint32_t offset = range.offset;
+        uint32_t size = range.size;
+
+        // Swallow the free range right after, then let the one right before swallow this
+        auto next = allocator.free_ranges.lower_bound(offset);
+        if (next != allocator.free_ranges.end() && next->first == offset + size) {
+            size += next->second;
+            next = allocator.free_ranges.erase(next);
+        }
+        if (next != allocator.free_ranges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                size += previous->second;
+                allocator.free_ranges.erase(previous);
+            }
+        }
+        allocator.free_ranges[offset] = size;
+        allocator.allocated -= range.size;
+    }
+
+    uint32_t largest_free(const RangeAllocator& allocator) {
+        uint32_t largest = 0;
+        for (const auto& [offset, size] : allocator.free_ranges) {
+            largest = std::max(largest, size);
+        }
+        return largest;
+    }
+}
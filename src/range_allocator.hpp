@@ -0,0 +1,36 @@
+#ifndef RANGE_ALLOCATOR_H_
+#define RANGE_ALLOCATOR_H_
+
+#include <cstdint>
+#include <map>
+#include <optional>
+
+// Sub-allocates ranges of a fixed size span, like elements of a buffer created up front. Only bookkeeping, nothing is touched on the GPU
+namespace range_allocator {
+    struct Range {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct RangeAllocator {
+        uint32_t capacity;
+        // Free ranges keyed by offset. Neighbours are always merged, so no two of them touch
+        std::map<uint32_t, uint32_t> free_ranges;
+        uint32_t allocated;
+    };
+
+    // Starts out with the whole span free
+    RangeAllocator init(const uint32_t capacity);
+
+    // Takes the smallest free range that fits, splitting off what's left over so big ranges stay whole for big requests.
+    // Nothing when no free range is large enough, however much is free in total. A size of 0 always succeeds and takes nothing
+    std::optional<Range> allocate(RangeAllocator& allocator, const uint32_t size);
+
+    // Hands a range from allocate back, merging it with any free neighbours
+    void release(RangeAllocator& allocator, const Range range);
+
+    // Size of the largest range allocate could hand out right now
+    uint32_t largest_free(const RangeAllocator& allocator);
+}
+
+#endif // RANGE_ALLOCATOR_H_
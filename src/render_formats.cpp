@@ -0,0 +1,145 @@
+#include "render_formats.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+
+namespace render_formats {
+    namespace {
+        struct FormatChoice {
+            const char* name;
+            VkFormat format;
+            uint32_t texel_bytes;
+        };
+
+        const std::array<FormatChoice, 5> COLOR_FORMATS = {{
+            { "rgba16", VK_FORMAT_R16G16B16A16_UNORM, 8 },
+            { "rgba16f", VK_FORMAT_R16G16B16A16_SFLOAT, 8 },
+            { "b10g11r11", VK_FORMAT_B10G11R11_UFLOAT_PACK32, 4 },
+            { "a2b10g10r10", VK_FORMAT_A2B10G10R10_UNORM_PACK32, 4 },
+            { "rgba8", VK_FORMAT_R8G8B8A8_UNORM, 4 }
+        }};
+
+        const std::array<FormatChoice, 2> MASK_FORMATS = {{
+            { "r16", VK_FORMAT_R16_UNORM, 2 },
+            { "r8", VK_FORMAT_R8_UNORM, 1 }
+        }};
+
+        // Only picked between by find_depth_stencil_format, listed so traffic can name and size them. D32S8 keeps its stencil in a plane of its own
+        const std::array<FormatChoice, 3> DEPTH_FORMATS = {{
+            { "d16", VK_FORMAT_D16_UNORM, 2 },
+            { "d24s8", VK_FORMAT_D24_UNORM_S8_UINT, 4 },
+            { "d32s8", VK_FORMAT_D32_SFLOAT_S8_UINT, 5 }
+        }};
+
+        template <size_t N>
+        VkFormat parse_format(const std::array<FormatChoice, N>& choices, const char* flag, const std::string& name) {
+            for (const FormatChoice& choice : choices) {
+                if (name == choice.name) {
+                    return choice.format;
+                }
+            }
+            printf("Unknown format %s for %s, expected one of:", name.c_str(), flag);
+            for (const FormatChoice& choice : choices) {
+                printf(" %s", choice.name);
+            }
+            printf("\n");
+            exit(EXIT_FAILURE);
+        }
+
+        const FormatChoice* find_choice(const VkFormat format) {
+            for (const FormatChoice& choice : COLOR_FORMATS) {
+                if (choice.format == format) {
+                    return &choice;
+                }
+            }
+            for (const FormatChoice& choice : MASK_FORMATS) {
+                if (choice.format == format) {
+                    return &choice;
+                }
+            }
+            for (const FormatChoice& choice : DEPTH_FORMATS) {
+                if (choice.format == format) {
+                    return &choice;
+                }
+            }
+            printf("Format %d is not a render target format\n", format);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    VkFormat parse_color_format(const char* flag, const std::string& name) {
+        return parse_format(COLOR_FORMATS, flag, name);
+    }
+
+    VkFormat parse_mask_format(const char* flag, const std::string& name) {
+        return parse_format(MASK_FORMATS, flag, name);
+    }
+
+    const char* format_name(const VkFormat format) {
+        return find_choice(format)->name;
+    }
+
+    uint32_t texel_bytes(const VkFormat format) {
+        return find_choice(format)->texel_bytes;
+    }
+
+    bool supports_usage(const VkPhysicalDevice gpu, const VkFormat format, const VkImageUsageFlags usage, const bool blended) {
+        VkFormatProperties3 properties3 = {};
+        properties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+        VkFormatProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2;
+        properties2.pNext = &properties3;
+        vkGetPhysicalDeviceFormatProperties2(gpu, format, &properties2);
+
+        VkFormatFeatureFlags2 required = 0;
+        if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
+            required |= VK_FORMAT_FEATURE_2_COLOR_ATTACHMENT_BIT;
+        }
+        if (blended) {
+            required |= VK_FORMAT_FEATURE_2_COLOR_ATTACHMENT_BLEND_BIT;
+        }
+        if (usage & VK_IMAGE_USAGE_SAMPLED_BIT) {
+            required |= VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        }
+        // The shaders declare storage images without a format, so any storage target needs formatless writes
+        if (usage & VK_IMAGE_USAGE_STORAGE_BIT) {
+            required |= VK_FORMAT_FEATURE_2_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_2_STORAGE_WRITE_WITHOUT_FORMAT_BIT;
+        }
+        if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            required |= VK_FORMAT_FEATURE_2_DEPTH_STENCIL_ATTACHMENT_BIT;
+        }
+        if (usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+            required |= VK_FORMAT_FEATURE_2_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_2_BLIT_SRC_BIT;
+        }
+        if (usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+            required |= VK_FORMAT_FEATURE_2_TRANSFER_DST_BIT;
+        }
+        return (properties3.optimalTilingFeatures & required) == required;
+    }
+
+    VkFormat find_depth_stencil_format(const VkPhysicalDevice gpu) {
+        const std::array<VkFormat, 2> candidates = { VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT };
+        for (const VkFormat format : candidates) {
+            VkFormatProperties properties = {};
+            vkGetPhysicalDeviceFormatProperties(gpu, format, &properties);
+            // Depth and stencil are only ever fetched, never filtered
+            const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+            if ((properties.optimalTilingFeatures & required) == required) {
+                return format;
+            }
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    void print_traffic(const std::vector<TargetTraffic>& targets, const VkExtent2D extent) {
+        printf("Render target traffic at %ux%u:\n", extent.width, extent.height);
+        uint64_t total_bytes = 0;
+        for (const TargetTraffic& target : targets) {
+            printf("  %-14s %-12s %u bytes/texel %8.1fMiB/frame\n", target.name, format_name(target.format), texel_bytes(target.format),
+                static_cast<double>(target.bytes_per_frame) / (1024.0 * 1024.0));
+            total_bytes += target.bytes_per_frame;
+        }
+        printf("  %-14s %-12s %13s %8.1fMiB/frame\n", "total", "", "", static_cast<double>(total_bytes) / (1024.0 * 1024.0));
+    }
+}
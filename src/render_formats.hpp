@@ -0,0 +1,47 @@
+#ifndef RENDER_FORMATS_H_
+#define RENDER_FORMATS_H_
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Formats the intermediate render targets can be created in. Smaller texels trade precision for less memory traffic per frame
+namespace render_formats {
+    struct TargetFormats {
+        VkFormat space = VK_FORMAT_R16G16B16A16_UNORM;
+        VkFormat grid = VK_FORMAT_R16G16B16A16_UNORM;
+        VkFormat compose = VK_FORMAT_R16G16B16A16_UNORM;
+        VkFormat jar_mask = VK_FORMAT_R16_UNORM;
+        // Not picked on the command line. Only swapped for a depth/stencil format when the jar mask goes into the space scene's stencil
+        VkFormat space_depth = VK_FORMAT_D16_UNORM;
+    };
+
+    // Memory traffic of one render target over a frame
+    struct TargetTraffic {
+        const char* name;
+        VkFormat format;
+        uint64_t bytes_per_frame;
+    };
+
+    // Looks up a format by the name the command line uses for it, e.g. "b10g11r11" or "r8". Prints the choices and exits on an unknown name.
+    // Color formats go for the space, grid and compose targets, mask formats for the jar mask
+    VkFormat parse_color_format(const char* flag, const std::string& name);
+    VkFormat parse_mask_format(const char* flag, const std::string& name);
+
+    // Command line name of one of the formats above, or of a depth format
+    const char* format_name(const VkFormat format);
+    uint32_t texel_bytes(const VkFormat format);
+
+    // Whether an optimally tiled image of this format can be created with this usage. Sampling includes linear filtering,
+    // storage includes writes from shaders that leave out the format, and transfer sources include blits. Blended targets
+    // also need blending on their color attachment writes
+    bool supports_usage(const VkPhysicalDevice gpu, const VkFormat format, const VkImageUsageFlags usage, const bool blended = false);
+
+    // Packed D24S8 where the device can render to, sample and clear it, otherwise D32S8. VK_FORMAT_UNDEFINED if neither will do
+    VkFormat find_depth_stencil_format(const VkPhysicalDevice gpu);
+
+    void print_traffic(const std::vector<TargetTraffic>& targets, const VkExtent2D extent);
+}
+
+#endif // RENDER_FORMATS_H_
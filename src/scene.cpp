@@ -0,0 +1,196 @@
+#include "scene.hpp"
+#include "trace.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace scene {
+    namespace {
+        // Instances fill a shell around the jar, out to about where the camera sits, the same every run
+        const float INSTANCE_SHELL_INNER_RADIUS = 1.5f;
+        const float INSTANCE_SHELL_OUTER_RADIUS = 5.0f;
+        const uint32_t INSTANCE_SEED = 0x726f636bu;
+
+        geometry::Direction parse_direction(const std::string& path, const size_t line_number, const std::string& word) {
+            if (word == "left")    { return geometry::Direction::Left; }
+            if (word == "right")   { return geometry::Direction::Right; }
+            if (word == "up")      { return geometry::Direction::Up; }
+            if (word == "down")    { return geometry::Direction::Down; }
+            if (word == "forward") { return geometry::Direction::Forward; }
+            if (word == "back")    { return geometry::Direction::Back; }
+            printf("%s:%zu: unknown direction '%s'\n", path.c_str(), line_number, word.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        ModelEntry parse_model_entry(const std::string& path, const size_t line_number, std::istringstream& tokens) {
+            ModelEntry entry = {};
+            std::string x;
+            std::string y;
+            std::string z;
+            if (!(tokens >> entry.file_name >> entry.base_path >> x >> y >> z)) {
+                printf("%s:%zu: expected <obj file> <base path> <x> <y> <z>\n", path.c_str(), line_number);
+                exit(EXIT_FAILURE);
+            }
+            entry.basis = {
+                .x = parse_direction(path, line_number, x),
+                .y = parse_direction(path, line_number, y),
+                .z = parse_direction(path, line_number, z)
+            };
+            // Scale is optional, but anything that's there has to be a number
+            entry.scale = 1.0f;
+            float scale = 1.0f;
+            if (tokens >> scale) {
+                entry.scale = scale;
+            }
+            else if (!tokens.eof()) {
+                printf("%s:%zu: expected a numeric scale\n", path.c_str(), line_number);
+                exit(EXIT_FAILURE);
+            }
+            return entry;
+        }
+
+        vk_layer::Drawable load_drawable(vk_types::Context& context, const ModelEntry& entry) {
+            // The HostModel can be pretty hefty, so it's dropped as soon as it's uploaded
+            vk_layer::Drawable drawable = {};
+            {
+                geometry::HostModel model = geometry::load_obj_model(entry.file_name, entry.base_path, entry.basis);
+                drawable = vk_layer::make_drawable(context, model);
+            }
+            if (entry.scale != 1.0f) {
+                drawable.transform.set(glm::scale(drawable.transform.get(), glm::vec3(entry.scale, entry.scale, entry.scale)));
+                for (size_t buffer_index = 0; buffer_index < context.buffer_count; ++buffer_index) {
+                    drawable.transform.push(buffer_index);
+                }
+            }
+            return drawable;
+        }
+
+        vk_layer::InstancedDrawable load_instanced_drawable(vk_types::Context& context, const InstancedEntry& entry, std::mt19937& generator) {
+            vk_layer::InstancedDrawable drawable = {};
+            {
+                geometry::HostModel model = geometry::load_obj_model(entry.model.file_name, entry.model.base_path, entry.model.basis);
+                drawable = vk_layer::make_instanced_drawable(context, model, entry.count);
+            }
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            auto random_direction = [&]() {
+                float z = unit(generator) * 2.0f - 1.0f;
+                float azimuth = unit(generator) * glm::two_pi<float>();
+                float ring = std::sqrt(1.0f - z * z);
+                return glm::vec3(ring * std::cos(azimuth), z, ring * std::sin(azimuth));
+            };
+            for (uint32_t instance = 0; instance < entry.count; ++instance) {
+                // Uniform direction, a distance into the shell, and any old orientation
+                glm::vec3 direction = random_direction();
+                float distance = INSTANCE_SHELL_INNER_RADIUS + unit(generator) * (INSTANCE_SHELL_OUTER_RADIUS - INSTANCE_SHELL_INNER_RADIUS);
+                glm::vec3 axis = random_direction();
+                float angle = unit(generator) * glm::two_pi<float>();
+
+                glm::mat4 transform = glm::translate(glm::mat4(1.0f), direction * distance);
+                transform = glm::rotate(transform, angle, axis);
+                transform = glm::scale(transform, glm::vec3(entry.model.scale, entry.model.scale, entry.model.scale));
+                vk_layer::add_instance(drawable, transform);
+            }
+            return drawable;
+        }
+    }
+
+    SceneDescription default_scene() {
+        geometry::AxisAlignedBasis blender_basis = {
+            .x = geometry::Direction::Right,
+            .y = geometry::Direction::Back,
+            .z = geometry::Direction::Up
+        };
+
+        SceneDescription description = {};
+        description.skybox_path = "../../../assets/skybox/space-skybox.png";
+        description.drawables = {
+            { "planetoid.obj", "../../../assets/planetoid/", blender_basis, 1.0f }
+        };
+        description.masking_jars = {
+            { "WATER_WORLD.obj", "../../../assets/planetoid/", blender_basis, 2.0f }
+        };
+        return description;
+    }
+
+    SceneDescription load_scene_file(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            printf("Unable to open scene file %s\n", path.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        SceneDescription description = {};
+        std::string line;
+        size_t line_number = 0;
+        while (std::getline(file, line)) {
+            line_number += 1;
+            size_t comment = line.find('#');
+            if (comment != std::string::npos) {
+                line.erase(comment);
+            }
+
+            std::istringstream tokens(line);
+            std::string kind;
+            if (!(tokens >> kind)) {
+                continue;
+            }
+
+            if (kind == "skybox") {
+                if (!(tokens >> description.skybox_path)) {
+                    printf("%s:%zu: expected a skybox image path\n", path.c_str(), line_number);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            else if (kind == "model") {
+                description.drawables.push_back(parse_model_entry(path, line_number, tokens));
+            }
+            else if (kind == "jar") {
+                description.masking_jars.push_back(parse_model_entry(path, line_number, tokens));
+            }
+            else if (kind == "instanced") {
+                InstancedEntry entry = {};
+                if (!(tokens >> entry.count) || (entry.count == 0)) {
+                    printf("%s:%zu: expected a positive instance count\n", path.c_str(), line_number);
+                    exit(EXIT_FAILURE);
+                }
+                entry.model = parse_model_entry(path, line_number, tokens);
+                description.instanced.push_back(entry);
+            }
+            else {
+                printf("%s:%zu: unknown entry '%s'\n", path.c_str(), line_number, kind.c_str());
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Pipeline layouts are derived from the first model and jar, so there has to be at least one of each
+        if (description.skybox_path.empty() || description.drawables.empty() || description.masking_jars.empty()) {
+            printf("Scene file %s needs a skybox and at least one model and jar\n", path.c_str());
+            exit(EXIT_FAILURE);
+        }
+        return description;
+    }
+
+    Scene load_scene(vk_types::Context& context, const SceneDescription& description) {
+        TRACE_ZONE("load_scene");
+        Scene loaded = {};
+
+        vk_image::HostImage skybox_image = vk_image::load_rgba_cubemap(description.skybox_path);
+        loaded.skybox_texture_index = vk_layer::upload_skybox(context, skybox_image, context.cleanup_procedures);
+
+        for (const auto& entry : description.drawables) {
+            loaded.drawables.push_back(load_drawable(context, entry));
+        }
+        for (const auto& entry : description.masking_jars) {
+            loaded.masking_jars.push_back(load_drawable(context, entry));
+        }
+        std::mt19937 generator(INSTANCE_SEED);
+        for (const auto& entry : description.instanced) {
+            loaded.instanced_drawables.push_back(load_instanced_drawable(context, entry, generator));
+        }
+        return loaded;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include <string>
+#include <vector>
+
+#include "geometry.hpp"
+#include "vk_layer.hpp"
+#include "vk_types.hpp"
+
+namespace scene {
+    struct ModelEntry {
+        std::string file_name;
+        std::string base_path;
+        geometry::AxisAlignedBasis basis;
+        float scale;
+    };
+
+    // Copies of one model scattered around the jar, each at the model's scale
+    struct InstancedEntry {
+        ModelEntry model;
+        uint32_t count;
+    };
+
+    // What to load, independent of any GPU state
+    struct SceneDescription {
+        std::string skybox_path;
+        std::vector<ModelEntry> drawables;
+        std::vector<ModelEntry> masking_jars;
+        std::vector<InstancedEntry> instanced;
+    };
+
+    // Everything uploaded and ready to draw
+    struct Scene {
+        uint32_t skybox_texture_index;
+        std::vector<vk_layer::Drawable> drawables;
+        std::vector<vk_layer::Drawable> masking_jars;
+        std::vector<vk_layer::InstancedDrawable> instanced_drawables;
+    };
+
+    // The planetoid in a jar
+    SceneDescription default_scene();
+
+    // Parses a scene file, one entry per line with '#' starting a comment:
+    //   skybox <cubemap image path>
+    //   model <obj file> <base path> <x direction> <y direction> <z direction> [scale]
+    //   jar <obj file> <base path> <x direction> <y direction> <z direction> [scale]
+    //   instanced <count> <obj file> <base path> <x direction> <y direction> <z direction> [scale]
+    // Directions are one of left, right, up, down, forward, back. Paths can't contain whitespace.
+    // Prints and exits on malformed files
+    SceneDescription load_scene_file(const std::string& path);
+
+    Scene load_scene(vk_types::Context& context, const SceneDescription& description);
+}
+
+#endif // SCENE_H_
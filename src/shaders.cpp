@@ -0,0 +1,117 @@
+#include "shaders.hpp"
+
+namespace shaders {
+    // Word aligned arrays of SPIR-V words, passed to the driver as is
+    namespace {
+        alignas(4) const uint32_t gradient_comp_code[] =
+            #include "shaders/gradient.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t compose_comp_code[] =
+            #include "shaders/compose.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t compose_fused_comp_code[] =
+            #include "shaders/compose_fused.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t compose_classify_comp_code[] =
+            #include "shaders/compose_classify.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t colored_triangle_vert_code[] =
+            #include "shaders/colored_triangle.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t colored_triangle_frag_code[] =
+            #include "shaders/colored_triangle.glsl.frag.spv.inc"
+        ;
+
+        alignas(4) const uint32_t colored_triangle_pulled_vert_code[] =
+            #include "shaders/colored_triangle_pulled.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t colored_triangle_instanced_vert_code[] =
+            #include "shaders/colored_triangle_instanced.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t depth_prepass_vert_code[] =
+            #include "shaders/depth_prepass.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t depth_prepass_frag_code[] =
+            #include "shaders/depth_prepass.glsl.frag.spv.inc"
+        ;
+
+        alignas(4) const uint32_t depth_prepass_pulled_vert_code[] =
+            #include "shaders/depth_prepass_pulled.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t depth_prepass_instanced_vert_code[] =
+            #include "shaders/depth_prepass_instanced.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t visibility_frag_code[] =
+            #include "shaders/visibility.glsl.frag.spv.inc"
+        ;
+
+        alignas(4) const uint32_t visibility_shade_comp_code[] =
+            #include "shaders/visibility_shade.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t light_culling_comp_code[] =
+            #include "shaders/light_culling.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t depth_pyramid_comp_code[] =
+            #include "shaders/depth_pyramid.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t occlusion_cull_comp_code[] =
+            #include "shaders/occlusion_cull.glsl.comp.spv.inc"
+        ;
+
+        alignas(4) const uint32_t skybox_vert_code[] =
+            #include "shaders/skybox.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t skybox_frag_code[] =
+            #include "shaders/skybox.glsl.frag.spv.inc"
+        ;
+
+        alignas(4) const uint32_t jar_cutaway_mask_vert_code[] =
+            #include "shaders/jar_cutaway_mask.glsl.vert.spv.inc"
+        ;
+
+        alignas(4) const uint32_t jar_cutaway_mask_frag_code[] =
+            #include "shaders/jar_cutaway_mask.glsl.frag.spv.inc"
+        ;
+
+        alignas(4) const uint32_t jar_stencil_frag_code[] =
+            #include "shaders/jar_stencil.glsl.frag.spv.inc"
+        ;
+    }
+
+    const EmbeddedShader gradient_comp = { "gradient.glsl.comp.spv", gradient_comp_code };
+    const EmbeddedShader compose_comp = { "compose.glsl.comp.spv", compose_comp_code };
+    const EmbeddedShader compose_fused_comp = { "compose_fused.glsl.comp.spv", compose_fused_comp_code };
+    const EmbeddedShader compose_classify_comp = { "compose_classify.glsl.comp.spv", compose_classify_comp_code };
+    const EmbeddedShader colored_triangle_vert = { "colored_triangle.glsl.vert.spv", colored_triangle_vert_code };
+    const EmbeddedShader colored_triangle_frag = { "colored_triangle.glsl.frag.spv", colored_triangle_frag_code };
+    const EmbeddedShader colored_triangle_pulled_vert = { "colored_triangle_pulled.glsl.vert.spv", colored_triangle_pulled_vert_code };
+    const EmbeddedShader colored_triangle_instanced_vert = { "colored_triangle_instanced.glsl.vert.spv", colored_triangle_instanced_vert_code };
+    const EmbeddedShader depth_prepass_vert = { "depth_prepass.glsl.vert.spv", depth_prepass_vert_code };
+    const EmbeddedShader depth_prepass_frag = { "depth_prepass.glsl.frag.spv", depth_prepass_frag_code };
+    const EmbeddedShader depth_prepass_pulled_vert = { "depth_prepass_pulled.glsl.vert.spv", depth_prepass_pulled_vert_code };
+    const EmbeddedShader depth_prepass_instanced_vert = { "depth_prepass_instanced.glsl.vert.spv", depth_prepass_instanced_vert_code };
+    const EmbeddedShader visibility_frag = { "visibility.glsl.frag.spv", visibility_frag_code };
+    const EmbeddedShader visibility_shade_comp = { "visibility_shade.glsl.comp.spv", visibility_shade_comp_code };
+    const EmbeddedShader light_culling_comp = { "light_culling.glsl.comp.spv", light_culling_comp_code };
+    const EmbeddedShader depth_pyramid_comp = { "depth_pyramid.glsl.comp.spv", depth_pyramid_comp_code };
+    const EmbeddedShader occlusion_cull_comp = { "occlusion_cull.glsl.comp.spv", occlusion_cull_comp_code };
+    const EmbeddedShader skybox_vert = { "skybox.glsl.vert.spv", skybox_vert_code };
+    const EmbeddedShader skybox_frag = { "skybox.glsl.frag.spv", skybox_frag_code };
+    const EmbeddedShader jar_cutaway_mask_vert = { "jar_cutaway_mask.glsl.vert.spv", jar_cutaway_mask_vert_code };
+    const EmbeddedShader jar_cutaway_mask_frag = { "jar_cutaway_mask.glsl.frag.spv", jar_cutaway_mask_frag_code };
+    const EmbeddedShader jar_stencil_frag = { "jar_stencil.glsl.frag.spv", jar_stencil_frag_code };
+}
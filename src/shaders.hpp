@@ -0,0 +1,39 @@
+#ifndef SHADERS_H_
+#define SHADERS_H_
+
+#include <cstdint>
+#include <span>
+
+// SPIR-V compiled into the binary. The Makefile runs glslc -mfmt=c on every shader in src/shaders, and shaders.cpp includes the results
+namespace shaders {
+    struct EmbeddedShader {
+        // Name of the compiled file, used to find a replacement when loading from a shader directory instead
+        const char* file_name;
+        std::span<const uint32_t> code;
+    };
+
+    extern const EmbeddedShader gradient_comp;
+    extern const EmbeddedShader compose_comp;
+    extern const EmbeddedShader compose_fused_comp;
+    extern const EmbeddedShader compose_classify_comp;
+    extern const EmbeddedShader colored_triangle_vert;
+    extern const EmbeddedShader colored_triangle_frag;
+    extern const EmbeddedShader colored_triangle_pulled_vert;
+    extern const EmbeddedShader colored_triangle_instanced_vert;
+    extern const EmbeddedShader depth_prepass_vert;
+    extern const EmbeddedShader depth_prepass_frag;
+    extern const EmbeddedShader depth_prepass_pulled_vert;
+    extern const EmbeddedShader depth_prepass_instanced_vert;
+    extern const EmbeddedShader visibility_frag;
+    extern const EmbeddedShader visibility_shade_comp;
+    extern const EmbeddedShader light_culling_comp;
+    extern const EmbeddedShader depth_pyramid_comp;
+    extern const EmbeddedShader occlusion_cull_comp;
+    extern const EmbeddedShader skybox_vert;
+    extern const EmbeddedShader skybox_frag;
+    extern const EmbeddedShader jar_cutaway_mask_vert;
+    extern const EmbeddedShader jar_cutaway_mask_frag;
+    extern const EmbeddedShader jar_stencil_frag;
+}
+
+#endif // SHADERS_H_
@@ -8,6 +8,9 @@ layout (location = 3) out vec3 normal_interp;
 layout (location = 4) out vec2 tex_interp;
 layout (location = 5) out vec3 position_interp;
 
+// Has to come out bit for bit the same as depth_prepass.glsl.vert for the EQUAL depth test after a pre-pass
+invariant gl_Position;
+
 //descriptor bindings for the pipeline
 layout(set = 0, binding = 0) uniform Transforms {
 	mat4 view;
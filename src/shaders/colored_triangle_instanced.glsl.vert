@@ -0,0 +1,31 @@
+#version 450
+// Attributes and the instance's model matrix are read through the addresses in push constants
+#extension GL_EXT_buffer_reference : require
+// For the shared attribute fetch
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 3) out vec3 normal_interp;
+layout (location = 4) out vec2 tex_interp;
+layout (location = 5) out vec3 position_interp;
+
+// Has to come out bit for bit the same as depth_prepass_instanced.glsl.vert for the EQUAL depth test after a pre-pass
+invariant gl_Position;
+
+//descriptor bindings for the pipeline
+layout(set = 0, binding = 0) uniform Transforms {
+	mat4 view;
+    mat4 projection;
+    vec4 sun_direction;
+} transforms;
+
+#include "pulled_vertex.glsl"
+
+void main() 
+{
+	mat4 model = instance_model();
+	vec3 vertex = pull_position();
+	gl_Position = transforms.projection * transforms.view * model * vec4(vertex, 1.0f);
+	normal_interp = normalize(transpose(inverse(mat3(transforms.view) * mat3(model))) * pull_normal());
+	tex_interp = pull_texture_coordinate();
+	position_interp = (transforms.view * model * vec4(vertex, 1.0f)).xyz;
+}
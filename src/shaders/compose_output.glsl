@@ -0,0 +1,19 @@
+// How compose writes its result. Pulled in with #include by both compose shaders
+#ifndef COMPOSE_OUTPUT_GLSL_
+#define COMPOSE_OUTPUT_GLSL_
+
+// Set when compose writes straight into a UNORM swapchain image, which gets no sRGB encoding from the hardware on store
+layout (constant_id = 4) const bool ENCODE_SRGB = false;
+
+vec3 linear_to_srgb(vec3 linear)
+{
+	vec3 clamped = clamp(linear, 0.0f, 1.0f);
+	return mix(clamped * 12.92f, 1.055f * pow(clamped, vec3(1.0f / 2.4f)) - 0.055f, greaterThan(clamped, vec3(0.0031308f)));
+}
+
+vec4 compose_output(vec4 color)
+{
+	return ENCODE_SRGB ? vec4(linear_to_srgb(color.rgb), color.a) : color;
+}
+
+#endif // COMPOSE_OUTPUT_GLSL_
@@ -0,0 +1,36 @@
+// Tile classes compose_classify.glsl.comp sorts the jar mask into, and the lists it sorts them into. Pulled in with #include, needs GL_EXT_buffer_reference
+#ifndef COMPOSE_TILES_GLSL_
+#define COMPOSE_TILES_GLSL_
+
+// Must match COMPOSE_TILE_SIZE and the class constants in vk_layer.cpp
+const uint COMPOSE_TILE_SIZE = 16;
+// The jar mask covers the whole tile, only the space scene shows through
+const uint TILE_CLASS_SPACE = 0;
+// The jar mask is clear over the whole tile, only the grid shows
+const uint TILE_CLASS_GRID = 1;
+// The jar's outline crosses the tile, so it has to blend
+const uint TILE_CLASS_EDGE = 2;
+const uint TILE_CLASS_COUNT = 3;
+// Not a class, compose runs one invocation per pixel of the target without looking at any lists
+const uint TILE_CLASS_ALL = 3;
+
+// Starts with one VkDispatchIndirectCommand per class. The class lists follow interleaved, a class's n-th tile at
+// COMPOSE_TILE_HEADER + n * TILE_CLASS_COUNT + class, so no list has to know how long the others can get
+const uint COMPOSE_TILE_HEADER = TILE_CLASS_COUNT * 3u;
+
+layout(buffer_reference, std430, buffer_reference_align = 4) buffer ComposeTiles {
+	uint values[];
+};
+
+uint pack_compose_tile(uvec2 tile) {
+	return tile.x | (tile.y << 16);
+}
+
+// The pixel this invocation composes, when each workgroup takes one tile of the class's list
+ivec2 compose_tile_texel(ComposeTiles tiles, uint tile_class) {
+	uint packed = tiles.values[COMPOSE_TILE_HEADER + gl_WorkGroupID.x * TILE_CLASS_COUNT + tile_class];
+	uvec2 tile = uvec2(packed & 0xffffu, packed >> 16);
+	return ivec2(tile * COMPOSE_TILE_SIZE + gl_LocalInvocationID.xy);
+}
+
+#endif // COMPOSE_TILES_GLSL_
@@ -0,0 +1,25 @@
+#version 450
+
+// For descriptor sampling
+#extension GL_EXT_nonuniform_qualifier : require 
+
+//shader input
+layout (location = 4) in vec2 tex_interp;
+
+layout(set = 1, binding = 0) uniform sampler2D combined_img_samplers[];
+
+// Starts the same as colored_triangle.glsl.frag so both share a pipeline layout, the light fields after these go unused
+layout( push_constant ) uniform PushConstants
+{
+	uint diffuse_texture_index;
+    uint specular_texture_index;
+    uint normal_texture_index;
+} indices;
+
+void main() 
+{
+	// Only the alpha test from the full shader, so cut out texels don't end up occluding what's behind them
+	if (texture(combined_img_samplers[nonuniformEXT(indices.diffuse_texture_index)], tex_interp).a < 0.1) {
+		discard;
+	}
+}
@@ -0,0 +1,26 @@
+#version 450
+
+//shader input. Normals are bound alongside but go unused
+layout (location = 0) in vec3 vertex;
+layout (location = 2) in vec2 tex_coord;
+layout (location = 4) out vec2 tex_interp;
+
+// Has to come out bit for bit the same as colored_triangle.glsl.vert for the space pass' EQUAL depth test to pass
+invariant gl_Position;
+
+//descriptor bindings for the pipeline
+layout(set = 0, binding = 0) uniform Transforms {
+	mat4 view;
+    mat4 projection;
+    vec4 sun_direction;
+} transforms;
+
+layout(set = 2, binding = 0) uniform ModelMatrix {
+	mat4x4 data;
+} model;
+
+void main() 
+{
+	gl_Position = transforms.projection * transforms.view * model.data * vec4(vertex, 1.0f);
+	tex_interp = tex_coord;
+}
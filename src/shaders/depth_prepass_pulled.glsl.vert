@@ -0,0 +1,30 @@
+#version 450
+// Attributes are read through the stream addresses in push constants
+#extension GL_EXT_buffer_reference : require
+// For the shared attribute fetch
+#extension GL_GOOGLE_include_directive : require
+
+// Normals are pushed alongside but never fetched
+layout (location = 4) out vec2 tex_interp;
+
+// Has to come out bit for bit the same as colored_triangle_pulled.glsl.vert for the space pass' EQUAL depth test to pass
+invariant gl_Position;
+
+//descriptor bindings for the pipeline
+layout(set = 0, binding = 0) uniform Transforms {
+	mat4 view;
+    mat4 projection;
+    vec4 sun_direction;
+} transforms;
+
+layout(set = 2, binding = 0) uniform ModelMatrix {
+	mat4x4 data;
+} model;
+
+#include "pulled_vertex.glsl"
+
+void main() 
+{
+	gl_Position = transforms.projection * transforms.view * model.data * vec4(pull_position(), 1.0f);
+	tex_interp = pull_texture_coordinate();
+}
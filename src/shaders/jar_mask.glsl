@@ -0,0 +1,35 @@
+// How compose and its classifier read the jar mask. Pulled in with #include after combined_img_samplers, needs GL_EXT_nonuniform_qualifier
+#ifndef JAR_MASK_GLSL_
+#define JAR_MASK_GLSL_
+
+// Must match the JAR_MASK_ constants in vk_layer.cpp. The color mask is the feathered one the jar pass draws at full resolution.
+// The stencil ones read the inner surfaces the jar pass marked in the space scene's stencil, hard edged on their own or softened by a half resolution feathered mask
+const uint JAR_MASK_COLOR = 0;
+const uint JAR_MASK_STENCIL = 1;
+const uint JAR_MASK_STENCIL_FEATHERED = 2;
+
+layout (constant_id = 3) const uint JAR_MASK_SOURCE = JAR_MASK_COLOR;
+
+// The stencil view sits in the same combined sampler array, read back as unsigned
+layout(set = 0, binding = 0) uniform usampler2D combined_uint_samplers[];
+
+// 1 inside the jar, where the space scene shows, falling to 0 outside. Either fetched at texel_coord or filtered at sampler_coord,
+// except that the half resolution feathered mask always has to be filtered up
+float read_jar_mask(uint mask_index, uint stencil_index, ivec2 texel_coord, vec2 sampler_coord, bool fetch)
+{
+	if (JAR_MASK_SOURCE == JAR_MASK_COLOR) {
+		if (fetch) {
+			return texelFetch(combined_img_samplers[nonuniformEXT(mask_index)], texel_coord, 0).r;
+		}
+		return texture(combined_img_samplers[nonuniformEXT(mask_index)], sampler_coord).r;
+	}
+
+	float inside = (texelFetch(combined_uint_samplers[nonuniformEXT(stencil_index)], texel_coord, 0).r != 0u) ? 1.0f : 0.0f;
+	if (JAR_MASK_SOURCE == JAR_MASK_STENCIL) {
+		return inside;
+	}
+	// The space scene was only drawn where the stencil is set, so the filtered feather mustn't reach past it
+	return inside * texture(combined_img_samplers[nonuniformEXT(mask_index)], sampler_coord).r;
+}
+
+#endif // JAR_MASK_GLSL_
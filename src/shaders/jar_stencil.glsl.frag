@@ -0,0 +1,14 @@
+#version 450
+
+//shader input
+layout (location = 3) in vec3 normal_interp;
+
+// No color output, the pipeline's stencil op marks every fragment that survives
+void main() 
+{
+	// Same inner surface test as jar_cutaway_mask.glsl.frag. Outer surfaces would mark the jar's whole silhouette, not just what the cutaway opens up
+	vec3 inward = vec3(0.0f, 0.0f, 1.0f);
+	if (dot(normal_interp, inward) < 0.0f) {
+		discard;
+	}
+}
@@ -0,0 +1,47 @@
+// Point lights and the per tile lists light_culling.glsl.comp bins them into. Pulled in with #include, needs GL_EXT_buffer_reference
+#ifndef POINT_LIGHTS_GLSL_
+#define POINT_LIGHTS_GLSL_
+
+#include "brdf.glsl"
+
+// Must match LIGHT_TILE_SIZE and MAX_LIGHTS_PER_TILE in vk_layer.cpp
+const uint LIGHT_TILE_SIZE = 16;
+const uint MAX_LIGHTS_PER_TILE = 255;
+// Each tile's list is its light count followed by that many light indices
+const uint LIGHT_TILE_STRIDE = MAX_LIGHTS_PER_TILE + 1u;
+
+// Matches lights::PointLight. World space position with the radius of influence in w, color with intensity in w
+struct PointLight {
+	vec4 position_radius;
+	vec4 color_intensity;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer PointLights {
+	PointLight lights[];
+};
+
+// Read only for shading, light_culling.glsl.comp writes the same memory through its own declaration
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer LightTiles {
+	uint values[];
+};
+
+uint light_tile_index(uvec2 pixel, uint tile_count_x) {
+	uvec2 tile = pixel / LIGHT_TILE_SIZE;
+	return tile.y * tile_count_x + tile.x;
+}
+
+// Sums up every light binned into the pixel's tile
+vec4 tile_point_lights(Surface surface, PointLights point_lights, LightTiles light_tiles, uint tile_index, mat4 view)
+{
+	vec4 light = vec4(0.0f);
+	uint tile_start = tile_index * LIGHT_TILE_STRIDE;
+	uint light_count = light_tiles.values[tile_start];
+	for (uint index = 0; index < light_count; ++index) {
+		PointLight point = point_lights.lights[light_tiles.values[tile_start + 1u + index]];
+		vec3 view_position = (view * vec4(point.position_radius.xyz, 1.0f)).xyz;
+		light += point_light(surface, view_position, point.position_radius.w, point.color_intensity);
+	}
+	return light;
+}
+
+#endif // POINT_LIGHTS_GLSL_
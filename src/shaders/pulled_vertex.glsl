@@ -0,0 +1,45 @@
+// Vertex attributes fetched straight from their buffers, for pipelines built without vertex input. Pulled in with #include, needs GL_EXT_buffer_reference
+#ifndef PULLED_VERTEX_GLSL_
+#define PULLED_VERTEX_GLSL_
+
+// Attributes are tightly packed, so they're read as scalars rather than as vec3 arrays with std430's padding
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer Floats {
+	float values[];
+};
+
+// One model matrix per instance of an instanced drawable, in instance order
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer InstanceTransforms {
+	mat4 models[];
+};
+
+// Matches VertexStreamPushConstants in vk_layer.hpp. Starts at PULLED_VERTEX_STREAMS_OFFSET, past the fragment stage's constants.
+// Instance transforms are only set for instanced drawables
+layout( push_constant ) uniform VertexStreams
+{
+	layout(offset = 32) Floats positions;
+	Floats normals;
+	Floats texture_coordinates;
+	InstanceTransforms instance_transforms;
+} streams;
+
+// gl_VertexIndex already has the draw's vertex offset added, so it indexes the streams as is
+vec3 pull_position() {
+	uint index = gl_VertexIndex;
+	return vec3(streams.positions.values[3 * index], streams.positions.values[3 * index + 1], streams.positions.values[3 * index + 2]);
+}
+
+vec3 pull_normal() {
+	uint index = gl_VertexIndex;
+	return vec3(streams.normals.values[3 * index], streams.normals.values[3 * index + 1], streams.normals.values[3 * index + 2]);
+}
+
+vec2 pull_texture_coordinate() {
+	uint index = gl_VertexIndex;
+	return vec2(streams.texture_coordinates.values[2 * index], streams.texture_coordinates.values[2 * index + 1]);
+}
+
+mat4 instance_model() {
+	return streams.instance_transforms.models[gl_InstanceIndex];
+}
+
+#endif // PULLED_VERTEX_GLSL_
@@ -0,0 +1,31 @@
+#version 450
+
+// For descriptor sampling
+#extension GL_EXT_nonuniform_qualifier : require 
+
+//shader input
+layout (location = 4) in vec2 tex_interp;
+
+//output write, draw and triangle packed together. 0 is left for pixels nothing covers
+layout (location = 0) out uint visibility;
+
+layout(set = 1, binding = 0) uniform sampler2D combined_img_samplers[];
+
+layout( push_constant ) uniform PushConstants
+{
+	uint diffuse_texture_index;
+    uint draw_id;
+} constants;
+
+// Must match VISIBILITY_TRIANGLE_BITS in vk_layer.cpp and visibility_shade.glsl.comp
+const uint TRIANGLE_BITS = 22;
+
+void main() 
+{
+	// Same alpha test as the forward pass, so cut out texels don't claim the pixel
+	if (texture(combined_img_samplers[nonuniformEXT(constants.diffuse_texture_index)], tex_interp).a < 0.1) {
+		discard;
+	}
+
+	visibility = ((constants.draw_id + 1u) << TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
@@ -13,5 +13,10 @@ namespace sync {
     void transition_image(const VkCommandBuffer cmd, const VkImage image, const VkImageLayout starting_layout, const VkImageLayout ending_layout);
     // Same but accepts aspect flags
     void transition_image(const VkCommandBuffer cmd, const VkImage image, const VkImageAspectFlagBits aspect_flags, const VkImageLayout starting_layout, const VkImageLayout ending_layout);
+    // Color image barrier handing the image from one queue family to another. Recorded identically on both queues, as the release on
+    // the source queue and the acquire on the destination, with a semaphore between the two submissions
+    void transfer_image(const VkCommandBuffer cmd, const VkImage image, const VkImageLayout starting_layout, const VkImageLayout ending_layout, const uint32_t source_family, const uint32_t destination_family);
+    // Same hamfisted barrier as a global memory barrier, for buffers written by one pass and read by the next
+    void memory_barrier(const VkCommandBuffer cmd);
 }
 #endif
\ No newline at end of file
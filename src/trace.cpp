@@ -0,0 +1,210 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+    namespace {
+        // Frame 0 is reserved for startup, frames proper start at 1 after the first mark
+        const uint64_t STARTUP_FRAME = 0;
+
+        struct Event {
+            const char* name;
+            uint64_t start_ns;
+            uint64_t duration_ns;
+            uint64_t frame;
+        };
+
+        // Only ever written by its own thread. Read by whoever exports the trace once writers are done
+        struct ThreadBuffer {
+            uint32_t thread_id;
+            std::string thread_name;
+            std::vector<Event> events;
+            uint64_t written;
+        };
+
+        struct Tracer {
+            std::mutex registry_mutex;
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+            std::atomic<bool> recording = false;
+            std::atomic<uint64_t> frame_index = STARTUP_FRAME;
+            Settings settings = {};
+            std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+            uint64_t last_frame_mark_ns = 0;
+        };
+
+        Tracer& tracer() {
+            static Tracer instance;
+            return instance;
+        }
+
+        // Buffers are shared with the registry so their events survive the thread exiting
+        thread_local std::shared_ptr<ThreadBuffer> local_buffer;
+
+        uint64_t now_ns() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tracer().epoch).count());
+        }
+
+        bool is_frame_traced(const uint64_t frame_index) {
+            const Settings& settings = tracer().settings;
+            if (frame_index == STARTUP_FRAME) {
+                return true;
+            }
+            uint64_t frame = frame_index - 1;
+            return (frame >= settings.first_frame) && (frame - settings.first_frame < settings.frame_count);
+        }
+
+        bool should_record(uint64_t& frame_index) {
+            Tracer& state = tracer();
+            if (!state.recording.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            frame_index = state.frame_index.load(std::memory_order_relaxed);
+            return is_frame_traced(frame_index);
+        }
+
+        ThreadBuffer& get_local_buffer() {
+            if (local_buffer == nullptr) {
+                Tracer& state = tracer();
+                auto buffer = std::make_shared<ThreadBuffer>();
+                buffer->events.resize(state.settings.events_per_thread);
+                buffer->written = 0;
+
+                std::lock_guard<std::mutex> lock(state.registry_mutex);
+                buffer->thread_id = static_cast<uint32_t>(state.buffers.size());
+                buffer->thread_name = "thread " + std::to_string(buffer->thread_id);
+                state.buffers.push_back(buffer);
+                local_buffer = buffer;
+            }
+            return *local_buffer;
+        }
+
+        void record(const Event& event) {
+            ThreadBuffer& buffer = get_local_buffer();
+            if (buffer.events.empty()) {
+                return;
+            }
+            buffer.events[buffer.written % buffer.events.size()] = event;
+            buffer.written += 1;
+        }
+
+        // Chrome wants microseconds, the fraction keeps the nanosecond resolution
+        void write_event(FILE* file, const Event& event, const uint32_t thread_id) {
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                event.name, thread_id, static_cast<double>(event.start_ns) / 1000.0, static_cast<double>(event.duration_ns) / 1000.0);
+            if (event.frame == STARTUP_FRAME) {
+                fprintf(file, ",\"args\":{\"phase\":\"startup\"}}");
+            }
+            else {
+                fprintf(file, ",\"args\":{\"frame\":%llu}}", static_cast<unsigned long long>(event.frame - 1));
+            }
+        }
+    }
+
+    bool compiled_in() {
+        #ifdef GALAXY_JAR_TRACE
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    void start(const Settings& settings) {
+        if (!compiled_in()) {
+            return;
+        }
+        Tracer& state = tracer();
+        state.settings = settings;
+        state.epoch = std::chrono::steady_clock::now();
+        state.last_frame_mark_ns = 0;
+        state.frame_index.store(STARTUP_FRAME, std::memory_order_relaxed);
+        state.recording.store(true, std::memory_order_release);
+        set_thread_name("main");
+    }
+
+    void mark_frame() {
+        Tracer& state = tracer();
+        if (!state.recording.load(std::memory_order_relaxed)) {
+            return;
+        }
+        uint64_t now = now_ns();
+        uint64_t frame_index = state.frame_index.load(std::memory_order_relaxed);
+        // Close out the frame that just ended as a zone of its own
+        if ((frame_index != STARTUP_FRAME) && is_frame_traced(frame_index)) {
+            record(Event{ "frame", state.last_frame_mark_ns, now - state.last_frame_mark_ns, frame_index });
+        }
+        state.last_frame_mark_ns = now;
+        frame_index += 1;
+        state.frame_index.store(frame_index, std::memory_order_relaxed);
+
+        // Past the end of the window nothing more will be recorded, so stop paying for it
+        uint64_t frame = frame_index - 1;
+        if (frame >= state.settings.first_frame + state.settings.frame_count) {
+            state.recording.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void set_thread_name(const char* name) {
+        if (!tracer().recording.load(std::memory_order_relaxed)) {
+            return;
+        }
+        ThreadBuffer& buffer = get_local_buffer();
+        std::lock_guard<std::mutex> lock(tracer().registry_mutex);
+        buffer.thread_name = name;
+    }
+
+    void write_chrome_json(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            printf("Unable to open %s for writing the trace\n", path.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        Tracer& state = tracer();
+        std::lock_guard<std::mutex> lock(state.registry_mutex);
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"galaxy-jar\"}}");
+        size_t event_count = 0;
+        for (const auto& buffer : state.buffers) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", buffer->thread_id, buffer->thread_name.c_str());
+            // Walk the ring oldest first
+            uint64_t capacity = buffer->events.size();
+            uint64_t first = (buffer->written > capacity) ? buffer->written - capacity : 0;
+            for (uint64_t index = first; index < buffer->written; ++index) {
+                write_event(file, buffer->events[index % capacity], buffer->thread_id);
+                event_count += 1;
+            }
+            if (buffer->written > capacity) {
+                printf("Trace ring buffer for %s overflowed, the oldest %llu events were dropped\n", buffer->thread_name.c_str(), static_cast<unsigned long long>(first));
+            }
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        printf("Wrote %zu trace events to %s\n", event_count, path.c_str());
+    }
+
+    Zone::Zone(const char* zone_name) : name(zone_name), start_ns(0), frame_index(STARTUP_FRAME), active(false) {
+        if (should_record(frame_index)) {
+            active = true;
+            start_ns = now_ns();
+        }
+    }
+
+    Zone::~Zone() {
+        end();
+    }
+
+    void Zone::end() {
+        if (!active) {
+            return;
+        }
+        active = false;
+        uint64_t end_ns = now_ns();
+        record(Event{ name, start_ns, end_ns - start_ns, frame_index });
+    }
+}
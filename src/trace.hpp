@@ -0,0 +1,68 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+// Scoped CPU zones, exported as Chrome/Perfetto trace-event JSON.
+// Zones are compiled in when GALAXY_JAR_TRACE is defined (debug builds, or release with TRACE=1) and compile to nothing otherwise.
+// Zone names must be string literals or otherwise outlive the tracer, only the pointer is kept.
+#ifdef GALAXY_JAR_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope
+#define TRACE_ZONE(name) trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+// Times from here until TRACE_ZONE_END(variable) or the end of the scope, whichever comes first
+#define TRACE_ZONE_BEGIN(variable, name) trace::Zone variable(name)
+#define TRACE_ZONE_END(variable) variable.end()
+// Marks the start of a new frame, called once per frame from the main loop
+#define TRACE_FRAME_MARK() trace::mark_frame()
+// Names the calling thread in the exported trace
+#define TRACE_THREAD_NAME(name) trace::set_thread_name(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_ZONE_BEGIN(variable, name) ((void)0)
+#define TRACE_ZONE_END(variable) ((void)0)
+#define TRACE_FRAME_MARK() ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+namespace trace {
+    struct Settings {
+        // Frames are numbered from 0. Startup, everything before the first frame mark, is always captured
+        uint64_t first_frame;
+        uint64_t frame_count;
+        // Capacity of each thread's ring buffer. Once full the oldest events get overwritten
+        size_t events_per_thread;
+    };
+
+    // Whether zones were compiled into this build
+    bool compiled_in();
+
+    // Begins capturing. Call as early as possible so startup is covered. Does nothing if tracing isn't compiled in
+    void start(const Settings& settings);
+
+    // Writes every captured event from every thread. Threads that may still be recording should be stopped first
+    void write_chrome_json(const std::string& path);
+
+    void mark_frame();
+    void set_thread_name(const char* name);
+
+    struct Zone {
+        private:
+        const char* name;
+        uint64_t start_ns;
+        uint64_t frame_index;
+        bool active;
+        public:
+        explicit Zone(const char* zone_name);
+        ~Zone();
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        // Closes the zone early. Later calls, and the destructor, do nothing
+        void end();
+    };
+}
+
+#endif // TRACE_H_
@@ -3,6 +3,8 @@
 #include "vk_buffer_private.hpp"
 #include "glmvk.hpp"
 
+#include <optional>
+
 namespace vk_buffer {
     vk_types::AllocatedBuffer create_buffer(const VmaAllocator allocator, const size_t alloc_size, const VkBufferUsageFlags usage, const VmaMemoryUsage memory_usage, vk_types::CleanupProcedures& cleanup_procedures) {
         // allocate buffer
@@ -31,67 +33,197 @@ namespace vk_buffer {
         return new_buffer;
     }
 
-    vk_types::AllocatedBuffer upload_index_buffer(const vk_types::Context& context, const std::vector<uint32_t>& indices, vk_types::CleanupProcedures& cleanup_procedures) {
-        const size_t index_buffer_size = indices.size() * sizeof(uint32_t);
+    vk_types::AddressedBuffer create_addressed_buffer(const vk_types::Context& context, const size_t size, const VmaMemoryUsage memory_usage, vk_types::CleanupProcedures& custom_lifetime, const VkBufferUsageFlags extra_usage) {
+        vk_types::AddressedBuffer addressed_buffer = {};
+        addressed_buffer.buffer = create_buffer(
+            context.allocator,
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | extra_usage,
+            memory_usage,
+            custom_lifetime);
+
+        VkBufferDeviceAddressInfo device_address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = addressed_buffer.buffer.buffer };
+        addressed_buffer.address = vkGetBufferDeviceAddress(context.device, &device_address_info);
+        return addressed_buffer;
+    }
+
+    vk_types::AddressedBuffer upload_addressed_buffer(const vk_types::Context& context, const void* data, const size_t size, vk_types::CleanupProcedures& custom_lifetime, const VkBufferUsageFlags extra_usage) {
+        vk_types::AddressedBuffer addressed_buffer = create_addressed_buffer(context, size, VMA_MEMORY_USAGE_GPU_ONLY, custom_lifetime, extra_usage);
 
-        //create index buffer
-        vk_types::AllocatedBuffer index_buffer = create_buffer(
+        // Create a temporary staging buffer which can be used to transfer from CPU memory to GPU memory
+        vk_types::CleanupProcedures staging_buffer_lifetime = {};
+        vk_types::AllocatedBuffer staging = create_buffer(
             context.allocator,
-            index_buffer_size,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VMA_MEMORY_USAGE_GPU_ONLY,
-            cleanup_procedures);
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+            VMA_MEMORY_USAGE_CPU_ONLY,
+            staging_buffer_lifetime);
+
+        void* staging_data = nullptr;
+        if (vmaMapMemory(context.allocator, staging.allocation, &staging_data) != VK_SUCCESS) {
+            printf("Unable to map staging buffer during buffer upload\n");
+            exit(EXIT_FAILURE);
+        }
+
+        memcpy(reinterpret_cast<char*>(staging_data), data, size);
+
+        vk_layer::immediate_submit(context, [&](VkCommandBuffer cmd) {
+            VkBufferCopy copy{ 0 };
+            copy.dstOffset = 0;
+            copy.srcOffset = 0;
+            copy.size = size;
+
+            vkCmdCopyBuffer(cmd, staging.buffer, addressed_buffer.buffer.buffer, 1, &copy);
+        });
+        vmaUnmapMemory(context.allocator, staging.allocation);
+        staging_buffer_lifetime.cleanup();
+
+        return addressed_buffer;
+    }
 
-        // Create a temporary staging buffer which can be used to transfer crom CPU memory to GPU memory
+    void upload_to_arena(const vk_types::Context& context, const geometry::IndexedVertexData& attributes, const range_allocator::Range vertex_range, const range_allocator::Range index_range) {
+        const vk_types::GeometryArena& arena = context.geometry;
+        const size_t position_size = attributes.positions.size() * sizeof(glm::vec3);
+        const size_t normal_size = attributes.normals.size() * sizeof(glm::vec3);
+        const size_t texture_coordinate_size = attributes.texture_coordinates.size() * sizeof(glm::vec2);
+        const size_t index_size = static_cast<size_t>(index_range.size) * sizeof(uint32_t);
+        const size_t staging_size = position_size + normal_size + texture_coordinate_size + index_size;
+        if (staging_size == 0) {
+            return;
+        }
+
+        // Create a temporary staging buffer which can be used to transfer from CPU memory to GPU memory
         vk_types::CleanupProcedures staging_buffer_lifetime = {};
         vk_types::AllocatedBuffer staging = create_buffer(
             context.allocator,
-            index_buffer_size,
+            staging_size,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
             VMA_MEMORY_USAGE_CPU_ONLY,
             staging_buffer_lifetime);
 
         void* data = nullptr;
         if (vmaMapMemory(context.allocator, staging.allocation, &data) != VK_SUCCESS) {
-            printf("Unable to map staging buffer during vertex attribute upload\n");
+            printf("Unable to map staging buffer during geometry upload\n");
             exit(EXIT_FAILURE);
         }
 
-        // copy index buffer
-        memcpy(reinterpret_cast<char*>(data), indices.data(), index_buffer_size);
+        // Each stream goes to the model's vertex range within it, indices stay relative to the model's first vertex
+        std::vector<VkBufferCopy> vertex_copies;
+        std::vector<VkBufferCopy> index_copies;
+        char* staging_bytes = reinterpret_cast<char*>(data);
+        VkDeviceSize staging_offset = 0;
+        auto stage = [&](std::vector<VkBufferCopy>& copies, const void* source, const size_t size, const VkDeviceSize destination) {
+            if (size == 0) {
+                return;
+            }
+            memcpy(staging_bytes + staging_offset, source, size);
+            copies.push_back({ staging_offset, destination, size });
+            staging_offset += size;
+        };
+        stage(vertex_copies, attributes.positions.data(), position_size, arena.stream_offsets[0] + vertex_range.offset * sizeof(glm::vec3));
+        stage(vertex_copies, attributes.normals.data(), normal_size, arena.stream_offsets[1] + vertex_range.offset * sizeof(glm::vec3));
+        stage(vertex_copies, attributes.texture_coordinates.data(), texture_coordinate_size, arena.stream_offsets[2] + vertex_range.offset * sizeof(glm::vec2));
+        VkDeviceSize index_destination = index_range.offset * sizeof(uint32_t);
+        for (const geometry::Piece& piece : attributes.pieces) {
+            const size_t piece_size = piece.indices.size() * sizeof(uint32_t);
+            stage(index_copies, piece.indices.data(), piece_size, index_destination);
+            index_destination += piece_size;
+        }
 
         vk_layer::immediate_submit(context, [&](VkCommandBuffer cmd) {
-            VkBufferCopy index_copy{ 0 };
-            index_copy.dstOffset = 0;
-            index_copy.srcOffset = 0;
-            index_copy.size = index_buffer_size;
-
-            vkCmdCopyBuffer(cmd, staging.buffer, index_buffer.buffer, 1, &index_copy);
+            if (!vertex_copies.empty()) {
+                vkCmdCopyBuffer(cmd, staging.buffer, arena.vertex_buffer.buffer, static_cast<uint32_t>(vertex_copies.size()), vertex_copies.data());
+            }
+            if (!index_copies.empty()) {
+                vkCmdCopyBuffer(cmd, staging.buffer, arena.index_buffer.buffer, static_cast<uint32_t>(index_copies.size()), index_copies.data());
+            }
         });
         vmaUnmapMemory(context.allocator, staging.allocation);
         staging_buffer_lifetime.cleanup();
+    }
+
+    void init_geometry_arena(vk_types::Context& context, const uint32_t vertex_capacity, const uint32_t index_capacity, vk_types::CleanupProcedures& custom_lifetime) {
+        if (vertex_capacity == 0 || index_capacity == 0) {
+            printf("The geometry arena needs room for at least one vertex and index\n");
+            exit(EXIT_FAILURE);
+        }
+        vk_types::GeometryArena arena = {};
+        const VkDeviceSize stream_size = static_cast<VkDeviceSize>(vertex_capacity) * sizeof(glm::vec3);
+        arena.stream_offsets = { 0, stream_size, 2 * stream_size };
+        const VkDeviceSize vertex_buffer_size = 2 * stream_size + static_cast<VkDeviceSize>(vertex_capacity) * sizeof(glm::vec2);
+
+        arena.vertex_buffer = create_buffer(
+            context.allocator,
+            vertex_buffer_size,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY,
+            custom_lifetime);
+        VkBufferDeviceAddressInfo vertex_address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = arena.vertex_buffer.buffer };
+        arena.vertex_buffer_address = vkGetBufferDeviceAddress(context.device, &vertex_address_info);
 
-        return index_buffer;
+        arena.index_buffer = create_buffer(
+            context.allocator,
+            static_cast<VkDeviceSize>(index_capacity) * sizeof(uint32_t),
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY,
+            custom_lifetime);
+        VkBufferDeviceAddressInfo index_address_info{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = arena.index_buffer.buffer };
+        arena.index_buffer_address = vkGetBufferDeviceAddress(context.device, &index_address_info);
+
+        arena.vertex_ranges = range_allocator::init(vertex_capacity);
+        arena.index_ranges = range_allocator::init(index_capacity);
+        context.geometry = arena;
     }
 
-    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, geometry::HostModel model, vk_types::CleanupProcedures& custom_lifetime) {
-        std::vector<vk_types::GpuMeshBuffers> model_meshes;
-        model_meshes.reserve(model.vertex_attributes.pieces.size());
+    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, const geometry::HostModel& model, vk_types::CleanupProcedures& custom_lifetime) {
+        vk_types::GeometryArena& arena = context.geometry;
+        if (arena.vertex_buffer.buffer == VK_NULL_HANDLE) {
+            printf("The geometry arena has to be created before any model is uploaded\n");
+            exit(EXIT_FAILURE);
+        }
 
-        vk_types::GpuVertexAttribute position_attribute = upload_vertex_attribute<glm::vec3>(context, model.vertex_attributes.positions, custom_lifetime);
-        vk_types::GpuVertexAttribute normal_attribute = upload_vertex_attribute<glm::vec3>(context, model.vertex_attributes.normals, custom_lifetime);
-        vk_types::GpuVertexAttribute texture_coordinate_attribute = upload_vertex_attribute<glm::vec2>(context, model.vertex_attributes.texture_coordinates, custom_lifetime);
+        const geometry::IndexedVertexData& attributes = model.vertex_attributes;
+        const uint32_t vertex_count = static_cast<uint32_t>(attributes.positions.size());
+        uint32_t index_count = 0;
+        for (const geometry::Piece& piece : attributes.pieces) {
+            index_count += static_cast<uint32_t>(piece.indices.size());
+        }
 
-        for (auto& piece : model.vertex_attributes.pieces) {
-            vk_types::AllocatedBuffer index_buffer = upload_index_buffer(context, piece.indices, custom_lifetime);
+        std::optional<range_allocator::Range> vertex_range = range_allocator::allocate(arena.vertex_ranges, vertex_count);
+        std::optional<range_allocator::Range> index_range = range_allocator::allocate(arena.index_ranges, index_count);
+        if (!vertex_range.has_value() || !index_range.has_value()) {
+            printf("No room left in the geometry arena for a model with %u vertices and %u indices, the largest free ranges hold %u vertices and %u indices\n",
+                vertex_count, index_count, range_allocator::largest_free(arena.vertex_ranges), range_allocator::largest_free(arena.index_ranges));
+            exit(EXIT_FAILURE);
+        }
+        upload_to_arena(context, attributes, vertex_range.value(), index_range.value());
+
+        // Unloading the model gives its ranges back. The arena is created first, so it outlives every model in its lifetime
+        vk_types::GeometryArena* arena_pointer = &arena;
+        const range_allocator::Range vertex_release = vertex_range.value();
+        const range_allocator::Range index_release = index_range.value();
+        custom_lifetime.add([arena_pointer, vertex_release, index_release]() {
+            range_allocator::release(arena_pointer->vertex_ranges, vertex_release);
+            range_allocator::release(arena_pointer->index_ranges, index_release);
+        });
 
-            model_meshes.push_back({index_buffer, position_attribute, normal_attribute, texture_coordinate_attribute, static_cast<uint32_t>(piece.indices.size())});
+        std::vector<vk_types::GpuMeshBuffers> model_meshes;
+        model_meshes.reserve(attributes.pieces.size());
+        const VkDeviceAddress position_address = arena.vertex_buffer_address + arena.stream_offsets[0] + vertex_release.offset * sizeof(glm::vec3);
+        const VkDeviceAddress normal_address = arena.vertex_buffer_address + arena.stream_offsets[1] + vertex_release.offset * sizeof(glm::vec3);
+        const VkDeviceAddress texture_coordinate_address = arena.vertex_buffer_address + arena.stream_offsets[2] + vertex_release.offset * sizeof(glm::vec2);
+        uint32_t first_index = index_release.offset;
+        for (const geometry::Piece& piece : attributes.pieces) {
+            const uint32_t piece_index_count = static_cast<uint32_t>(piece.indices.size());
+            const VkDeviceAddress index_address = arena.index_buffer_address + static_cast<VkDeviceAddress>(first_index) * sizeof(uint32_t);
+            model_meshes.push_back({ first_index, piece_index_count, static_cast<int32_t>(vertex_release.offset), index_address, position_address, normal_address, texture_coordinate_address });
+            first_index += piece_index_count;
         }
         
         return model_meshes;
     }
 
-    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, geometry::HostModel model) {
+    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, const geometry::HostModel& model) {
         return create_mesh_buffers(context, model, context.cleanup_procedures);
     }
-}
\ No newline at end of file
+}
@@ -8,11 +8,21 @@ namespace vk_buffer {
     // Generic buffer allocation function that can be used for various buffer types. Not recommended for use outside of this module.
     vk_types::AllocatedBuffer create_buffer(const VmaAllocator allocator, const size_t alloc_size, const VkBufferUsageFlags usage, const VmaMemoryUsage memory_usage, vk_types::CleanupProcedures& cleanup_procedures);
     
-    // Uploads model data to the GPU with a lifetime matching that of the context
-    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, geometry::HostModel model);
+    // Creates the context's geometry arena with room for this many vertices and indices across every model. Has to come before any model is uploaded
+    void init_geometry_arena(vk_types::Context& context, const uint32_t vertex_capacity, const uint32_t index_capacity, vk_types::CleanupProcedures& custom_lifetime);
 
-    // Uploads model data to the GPU with a custom lifetime
-    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, geometry::HostModel model, vk_types::CleanupProcedures& custom_lifetime);
+    // Uploads model data into ranges of the context's geometry arena that stay taken for the lifetime of the context
+    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, const geometry::HostModel& model);
+
+    // Uploads model data into ranges of the context's geometry arena that go back to it when custom_lifetime is cleaned up, which unloads the model.
+    // Prints and exits if the arena has no free range large enough
+    std::vector<vk_types::GpuMeshBuffers> create_mesh_buffers(vk_types::Context& context, const geometry::HostModel& model, vk_types::CleanupProcedures& custom_lifetime);
+
+    // Storage buffer that shaders reach through its address, plus any extra usage. Left uninitialized, host visible memory usages come back mapped
+    vk_types::AddressedBuffer create_addressed_buffer(const vk_types::Context& context, const size_t size, const VmaMemoryUsage memory_usage, vk_types::CleanupProcedures& custom_lifetime, const VkBufferUsageFlags extra_usage = 0);
+
+    // Uploads size bytes of plain data to a device local buffer that shaders can read through its address, plus any extra usage
+    vk_types::AddressedBuffer upload_addressed_buffer(const vk_types::Context& context, const void* data, const size_t size, vk_types::CleanupProcedures& custom_lifetime, const VkBufferUsageFlags extra_usage = 0);
 
     // Creates a uniform buffer with data of type T that is mapped until the provided lifetime is cleaned up
     template <class T>
@@ -1,13 +1,17 @@
 #include "vk_buffer.hpp"
 #include "vk_image.hpp"
+#include "vk_image_private.hpp"
 #include "vk_layer.hpp"
 #include "sync.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
 
 namespace vk_image {
 
@@ -40,18 +44,12 @@ namespace vk_image {
         return load_image(filename, FORCE_CHANNELS);
     }
     
-    enum class ColorComponents {
-        RG,
-        GB
-    };
-
     HostImage load_rg_image_base(const std::string& filename, ColorComponents components_to_extract) {
         int width = 0;
         int height = 0; 
         int channels = 0;
 
         const int rgb_channel_count = 3;
-        const int rg_channel_count = 2;
         stbi_set_flip_vertically_on_load(true);
         unsigned char* image_data = stbi_load(filename.c_str(), &width, &height, &channels, rgb_channel_count);
 
@@ -60,10 +58,16 @@ namespace vk_image {
             exit(EXIT_FAILURE);
         }
 
-        size_t rgb_data_size = static_cast<size_t>(width * height * rgb_channel_count);
-        size_t rg_data_size = static_cast<size_t>(width * height * rg_channel_count);
-        std::vector<unsigned char> image_data_vec;
-        image_data_vec.reserve(rg_data_size);
+        std::vector<unsigned char> image_data_vec = extract_two_channels(image_data, static_cast<size_t>(width) * static_cast<size_t>(height), components_to_extract);
+
+        stbi_image_free(image_data);
+
+        return HostImage { static_cast<uint32_t>(width), static_cast<uint32_t>(height), image_data_vec, Representation::Flat };
+    }
+
+    std::vector<unsigned char> extract_two_channels(const unsigned char* rgb_data, const size_t pixel_count, const ColorComponents components_to_extract) {
+        const size_t rgb_channel_count = 3;
+        const size_t rg_channel_count = 2;
         size_t offset = 0;
         if (components_to_extract == ColorComponents::RG) {
             offset = 0;
@@ -71,14 +75,38 @@ namespace vk_image {
         else {
             offset = 1;
         }
-        for(size_t position = 0; position < rgb_data_size; position += 3) {
-            image_data_vec.emplace_back(static_cast<unsigned char>(image_data[position+offset]));
-            image_data_vec.emplace_back(static_cast<unsigned char>(image_data[position+offset+1]));
+
+        std::vector<unsigned char> rg_data;
+        rg_data.reserve(pixel_count * rg_channel_count);
+        const size_t rgb_data_size = pixel_count * rgb_channel_count;
+        for(size_t position = 0; position < rgb_data_size; position += rgb_channel_count) {
+            rg_data.emplace_back(rgb_data[position + offset]);
+            rg_data.emplace_back(rgb_data[position + offset + 1]);
         }
+        return rg_data;
+    }
 
-        stbi_image_free(image_data);
+    std::vector<unsigned char> slice_cubemap_faces(const unsigned char* rgba_data, const size_t width, const size_t height) {
+        constexpr size_t face_count = 6;
+        const size_t channel_count = 4;
+        size_t face_width = width / 4;
+        size_t face_height = height / 3;
 
-        return HostImage { static_cast<uint32_t>(width), static_cast<uint32_t>(height), image_data_vec, Representation::Flat };
+        std::vector<unsigned char> face_ordered_layout_image_data;
+        face_ordered_layout_image_data.reserve(face_width * face_height * channel_count * face_count);
+
+        // Make a pointer window that slides over each face in upload order
+        std::array<size_t, face_count> left_offsets = {{2 * face_width * channel_count, 0 * face_width * channel_count, 1 * face_width * channel_count, 1 * face_width * channel_count, 1 * face_width * channel_count, 3 * face_width * channel_count}};
+        std::array<size_t, face_count> top_offsets = {{1 * face_height, 1 * face_height, 0 * face_height, 2 * face_height, 1 * face_height, 1 * face_height}};
+
+        for (size_t face = 0; face < face_count; ++face) {
+            for (size_t current_row = top_offsets[face]; current_row < top_offsets[face] + face_height; ++current_row) {
+                const unsigned char* begin_row_data = rgba_data + left_offsets[face] + current_row * width * channel_count;
+                const unsigned char* end_row_data = begin_row_data + face_width * channel_count;
+                face_ordered_layout_image_data.insert(face_ordered_layout_image_data.end(), begin_row_data, end_row_data);
+            }
+        }
+        return face_ordered_layout_image_data;
     }
 
     HostImage load_gltf_specular_image_as_rg(const std::string& filename) {
@@ -91,7 +119,6 @@ namespace vk_image {
 
     // Opinionated cubemap load. Expects the cubemap to be laid out in the shape of a cross rotated 90 degrees to the left
     HostImage load_rgba_cubemap(const std::string& filename) {
-        constexpr int face_count = 6;
         int width = 0;
         int height = 0; 
         int channels = 0;
@@ -107,26 +134,10 @@ namespace vk_image {
 
         size_t face_width = width / 4;
         size_t face_height = height / 3;
-
-        std::vector<unsigned char> raw_image_data_vec(image_data, image_data + (width * height * FORCE_CHANNELS));
-        std::vector<unsigned char> face_ordered_layout_image_data;
-        face_ordered_layout_image_data.reserve(face_width * face_height * FORCE_CHANNELS * face_count);
-
-        // Make a pointer window that slides over each face in upload order
-        std::array<size_t, face_count> left_offsets = {{2 * face_width * FORCE_CHANNELS, 0 * face_width * FORCE_CHANNELS, 1 * face_width * FORCE_CHANNELS, 1 * face_width * FORCE_CHANNELS, 1 * face_width * FORCE_CHANNELS, 3 * face_width * FORCE_CHANNELS}};
-        std::array<size_t, face_count> top_offsets = {{1 * face_height, 1 * face_height, 0 * face_height, 2 * face_height, 1 * face_height, 1 * face_height}};
-
-        for (size_t face = 0; face < face_count; ++face) {
-            for (size_t current_row = top_offsets[face]; current_row < top_offsets[face] + face_height; ++current_row) {
-                auto begin_row_data = raw_image_data_vec.begin() + left_offsets[face] + current_row * (size_t) width * FORCE_CHANNELS;
-                auto end_row_data = begin_row_data + face_width * FORCE_CHANNELS;
-                face_ordered_layout_image_data.insert(face_ordered_layout_image_data.end(), begin_row_data, end_row_data);
-            }
-        }
+        std::vector<unsigned char> face_ordered_layout_image_data = slice_cubemap_faces(image_data, static_cast<size_t>(width), static_cast<size_t>(height));
 
         stbi_image_free(image_data);
 
-        
         return HostImage { static_cast<uint32_t>(face_width), static_cast<uint32_t>(face_height), face_ordered_layout_image_data, Representation::Cubemap };
     }
 
@@ -317,6 +328,148 @@ namespace vk_image {
         blit_image_to_image(cmd, source, destination,source_extent, destination_extent, BASE_MIP_LEVEL, BASE_MIP_LEVEL);
     }
 
+    uint8_t linear_to_srgb8(float linear) {
+        float clamped = std::clamp(linear, 0.0f, 1.0f);
+        float encoded = (clamped <= 0.0031308f) ? clamped * 12.92f : 1.055f * std::pow(clamped, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::lround(encoded * 255.0f));
+    }
+
+    namespace {
+        // 5 exponent bits biased by 15 over mantissa_bits of mantissa, as in half floats and the packed unsigned float formats
+        float small_float_to_float(const uint32_t exponent, const uint32_t mantissa, const uint32_t mantissa_bits) {
+            const float fraction = static_cast<float>(mantissa) / static_cast<float>(1u << mantissa_bits);
+            if (exponent == 0) {
+                return std::ldexp(fraction, -14);
+            }
+            if (exponent == 31) {
+                return (mantissa == 0) ? INFINITY : NAN;
+            }
+            return std::ldexp(1.0f + fraction, static_cast<int>(exponent) - 15);
+        }
+
+        std::array<float, 4> decode_texel(const VkFormat format, const uint8_t* texel) {
+            uint32_t packed = 0;
+            memcpy(&packed, texel, sizeof(packed));
+            switch (format) {
+                case VK_FORMAT_R16G16B16A16_UNORM: {
+                    std::array<uint16_t, 4> channels = {};
+                    memcpy(channels.data(), texel, sizeof(channels));
+                    return { channels[0] / 65535.0f, channels[1] / 65535.0f, channels[2] / 65535.0f, channels[3] / 65535.0f };
+                }
+                case VK_FORMAT_R16G16B16A16_SFLOAT: {
+                    std::array<uint16_t, 4> channels = {};
+                    memcpy(channels.data(), texel, sizeof(channels));
+                    std::array<float, 4> linear = {};
+                    for (size_t channel = 0; channel < 4; ++channel) {
+                        float magnitude = small_float_to_float((channels[channel] >> 10) & 0x1fu, channels[channel] & 0x3ffu, 10);
+                        linear[channel] = (channels[channel] & 0x8000u) ? -magnitude : magnitude;
+                    }
+                    return linear;
+                }
+                case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+                    return { (packed & 0x3ffu) / 1023.0f, ((packed >> 10) & 0x3ffu) / 1023.0f, ((packed >> 20) & 0x3ffu) / 1023.0f, (packed >> 30) / 3.0f };
+                case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+                    return {
+                        small_float_to_float((packed >> 6) & 0x1fu, packed & 0x3fu, 6),
+                        small_float_to_float((packed >> 17) & 0x1fu, (packed >> 11) & 0x3fu, 6),
+                        small_float_to_float((packed >> 27) & 0x1fu, (packed >> 22) & 0x1fu, 5),
+                        1.0f
+                    };
+                case VK_FORMAT_B8G8R8A8_UNORM:
+                    return { texel[2] / 255.0f, texel[1] / 255.0f, texel[0] / 255.0f, texel[3] / 255.0f };
+                default:
+                    return { texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, texel[3] / 255.0f };
+            }
+        }
+    }
+
+    HostImage read_back_image_srgb8(const vk_types::Context& context, const vk_types::AllocatedImage& image, VkImageLayout current_layout) {
+        size_t bytes_per_pixel = 0;
+        switch (image.image_format) {
+            case VK_FORMAT_R16G16B16A16_UNORM:
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                bytes_per_pixel = 8;
+                break;
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+                bytes_per_pixel = 4;
+                break;
+            default:
+                printf("Unable to read back image with format %d\n", image.image_format);
+                exit(EXIT_FAILURE);
+        }
+
+        const size_t pixel_count = static_cast<size_t>(image.image_extent.width) * image.image_extent.height;
+        const size_t readback_size = pixel_count * bytes_per_pixel;
+
+        vk_types::CleanupProcedures readback_buffer_lifetime = {};
+        vk_types::AllocatedBuffer readback = vk_buffer::create_buffer(
+            context.allocator,
+            readback_size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_TO_CPU,
+            readback_buffer_lifetime);
+
+        vk_layer::immediate_submit(context, [&](VkCommandBuffer cmd) {
+            if (current_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+                sync::transition_image(cmd, image.image, current_layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+            }
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = 0;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {
+                image.image_extent.width,
+                image.image_extent.height,
+                1
+            };
+            vkCmdCopyImageToBuffer(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+            if (current_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+                sync::transition_image(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, current_layout);
+            }
+        });
+
+        void* data = nullptr;
+        if (vmaMapMemory(context.allocator, readback.allocation, &data) != VK_SUCCESS) {
+            printf("Unable to map readback buffer\n");
+            exit(EXIT_FAILURE);
+        }
+        vmaInvalidateAllocation(context.allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+
+        // Decoded to linear floats first, whatever the layout, then encoded. Alpha isn't color encoded
+        std::vector<unsigned char> rgba8(pixel_count * 4);
+        for (size_t pixel = 0; pixel < pixel_count; ++pixel) {
+            std::array<float, 4> linear = decode_texel(image.image_format, reinterpret_cast<const uint8_t*>(data) + pixel * bytes_per_pixel);
+            for (size_t channel = 0; channel < 3; ++channel) {
+                rgba8[pixel * 4 + channel] = linear_to_srgb8(linear[channel]);
+            }
+            rgba8[pixel * 4 + 3] = static_cast<uint8_t>(std::lround(std::clamp(linear[3], 0.0f, 1.0f) * 255.0f));
+        }
+
+        vmaUnmapMemory(context.allocator, readback.allocation);
+        readback_buffer_lifetime.cleanup();
+
+        return HostImage { image.image_extent.width, image.image_extent.height, rgba8, Representation::Flat };
+    }
+
+    void write_png(const std::string& filepath, const HostImage& image) {
+        const int RGBA_CHANNELS = 4;
+        const int stride = static_cast<int>(image.width) * RGBA_CHANNELS;
+        if (stbi_write_png(filepath.c_str(), static_cast<int>(image.width), static_cast<int>(image.height), RGBA_CHANNELS, image.data.data(), stride) == 0) {
+            printf("Unable to write image %s\n", filepath.c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
+
     VkSampler init_linear_sampler(vk_types::Context& context) {
         return init_linear_sampler(context, context.cleanup_procedures);
     }
@@ -350,7 +503,22 @@ namespace vk_image {
         return sampler;
     }
 
+    bool has_stencil(const VkFormat format) {
+        return (format >= VK_FORMAT_S8_UINT) && (format <= VK_FORMAT_D32_SFLOAT_S8_UINT);
+    }
+
+    VkImageAspectFlags image_aspects(const VkFormat format) {
+        if (has_stencil(format)) {
+            return (format == VK_FORMAT_S8_UINT) ? VK_IMAGE_ASPECT_STENCIL_BIT : (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+        }
+        return (format >= VK_FORMAT_D16_UNORM) && (format <= VK_FORMAT_D32_SFLOAT) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+
     VkImageView init_image_view(const VkDevice device, const VkImage image, const Representation representation, const VkFormat format, const uint32_t miplevels, vk_types::CleanupProcedures& cleanup_procedures) {
+        return init_image_view(device, image, representation, format, image_aspects(format), miplevels, cleanup_procedures);
+    }
+
+    VkImageView init_image_view(const VkDevice device, const VkImage image, const Representation representation, const VkFormat format, const VkImageAspectFlags aspects, const uint32_t miplevels, vk_types::CleanupProcedures& cleanup_procedures) {
         VkImageView image_view = {};
 
         VkImageViewCreateInfo image_view_create_info{};
@@ -366,7 +534,7 @@ namespace vk_image {
         image_view_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
         image_view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
         image_view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        image_view_create_info.subresourceRange.aspectMask = (format >= VK_FORMAT_D16_UNORM) && (format <= VK_FORMAT_D32_SFLOAT_S8_UINT) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        image_view_create_info.subresourceRange.aspectMask = aspects;
         image_view_create_info.subresourceRange.baseMipLevel = 0;
         image_view_create_info.subresourceRange.levelCount = miplevels;
         image_view_create_info.subresourceRange.baseArrayLayer = 0;
@@ -384,6 +552,36 @@ namespace vk_image {
         return image_view;
     }
 
+    VkImageView init_mip_view(const VkDevice device, const VkImage image, const VkFormat format, const uint32_t miplevel, vk_types::CleanupProcedures& cleanup_procedures) {
+        VkImageView image_view = {};
+
+        VkImageViewCreateInfo image_view_create_info{};
+        image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        image_view_create_info.image = image;
+        image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        image_view_create_info.format = format;
+        image_view_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        image_view_create_info.subresourceRange.baseMipLevel = miplevel;
+        image_view_create_info.subresourceRange.levelCount = 1;
+        image_view_create_info.subresourceRange.baseArrayLayer = 0;
+        image_view_create_info.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device, &image_view_create_info, nullptr, &image_view) != VK_SUCCESS) {
+            printf("Unable to create view of mip level %u\n", miplevel);
+            exit(EXIT_FAILURE);
+        }
+
+        cleanup_procedures.add([device, image_view]() {
+            vkDestroyImageView(device, image_view, nullptr);
+        });
+
+        return image_view;
+    }
+
     vk_types::AllocatedImage init_allocated_image(const VkDevice device, const VmaAllocator allocator, const Representation representation, const VkFormat format, const VkImageUsageFlags usage_flags, const uint32_t miplevels, const VkExtent2D extent, vk_types::CleanupProcedures& cleanup_procedures) {
         // Setup image specification
         VkImageCreateInfo image_info = {};
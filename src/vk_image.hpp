@@ -38,6 +38,12 @@ namespace vk_image {
     vk_types::AllocatedImage upload_image_mipmapped(vk_types::Context& context, const HostImage& image, VkFormat format, VkImageLayout desired_layout);
     vk_types::AllocatedImage upload_image_mipmapped(const vk_types::Context& context, const HostImage& image, VkFormat format, VkImageLayout desired_layout, vk_types::CleanupProcedures& lifetime);
 
+    // Copies the base level of a 2D color image back to host memory as 8 bit sRGB encoded RGBA, matching what a blit to an sRGB swapchain would show.
+    // The image is expected in current_layout and is returned to it afterwards
+    HostImage read_back_image_srgb8(const vk_types::Context& context, const vk_types::AllocatedImage& image, VkImageLayout current_layout);
+    // Writes an 8 bit RGBA host image to disk as a PNG
+    void write_png(const std::string& filepath, const HostImage& image);
+
     VkSampler init_linear_sampler(vk_types::Context& context);
     VkSampler init_linear_sampler(const vk_types::Context& context, vk_types::CleanupProcedures& lifetime);
     
@@ -46,12 +52,20 @@ namespace vk_image {
     // Blits a source image to a destination image. Only blits the base mipmap level.
     void blit_image_to_image_no_mipmap(const VkCommandBuffer cmd, const VkImage source, const VkImage destination, VkExtent2D source_extent, VkExtent2D destination_extent);
 
+    // Depth/stencil formats, and the stencil only S8_UINT
+    bool has_stencil(const VkFormat format);
+    // Every aspect an image of this format has
+    VkImageAspectFlags image_aspects(const VkFormat format);
     VkImageSubresourceRange make_subresource_range(const VkImageAspectFlags aspect_mask);
     VkImageSubresourceRange make_baselevel_subresource_range(const VkImageAspectFlags aspect_mask);
     VkImageSubresourceRange make_miplevels_subresource_range(const VkImageAspectFlags aspect_mask);
     
     // Rough around the edges general functions, prefer the higher level ones when possible.
     vk_types::AllocatedImage init_allocated_image(const VkDevice device, const VmaAllocator allocator, const Representation representation, const VkFormat format, const VkImageUsageFlags usage_flags, const uint32_t miplevels, const VkExtent2D extent, vk_types::CleanupProcedures& cleanup_procedures);
+    // Views cover every aspect of the format, so a depth/stencil image's view can be bound as both attachments. Sampling needs a view of a single aspect
     VkImageView init_image_view(const VkDevice device, const VkImage image, const Representation representation, const VkFormat format, const uint32_t miplevels, vk_types::CleanupProcedures& cleanup_procedures);
+    VkImageView init_image_view(const VkDevice device, const VkImage image, const Representation representation, const VkFormat format, const VkImageAspectFlags aspects, const uint32_t miplevels, vk_types::CleanupProcedures& cleanup_procedures);
+    // A single mip level of a flat color image, for compute to write one level of a chain at a time
+    VkImageView init_mip_view(const VkDevice device, const VkImage image, const VkFormat format, const uint32_t miplevel, vk_types::CleanupProcedures& cleanup_procedures);
 }
 #endif // VK_IMAGE_H_
\ No newline at end of file
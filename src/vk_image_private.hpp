@@ -0,0 +1,22 @@
+#ifndef VK_IMAGE_PRIVATE_H
+#define VK_IMAGE_PRIVATE_H
+
+#include "vk_image.hpp"
+
+#include <vector>
+
+// Pure CPU helpers behind the image loaders. Exposed so they can be exercised without going through stb or a device
+namespace vk_image {
+    enum class ColorComponents {
+        RG,
+        GB
+    };
+
+    // Pulls two adjacent channels out of tightly packed 8 bit RGB pixels
+    std::vector<unsigned char> extract_two_channels(const unsigned char* rgb_data, const size_t pixel_count, const ColorComponents components_to_extract);
+
+    // Reorders a tightly packed 8 bit RGBA cubemap laid out as a cross rotated 90 degrees to the left into six consecutive faces, in upload order
+    std::vector<unsigned char> slice_cubemap_faces(const unsigned char* rgba_data, const size_t width, const size_t height);
+}
+
+#endif
@@ -3,11 +3,13 @@
 #include "vk_descriptors.hpp"
 #include "vk_buffer.hpp"
 #include "glmvk.hpp"
+#include "trace.hpp"
 
 #include <algorithm>
 #include <array>
 #include <fstream>
 #include <ios>
+#include <optional>
 #include <unordered_set>
 #include <vulkan/vk_enum_string_helper.h>
 
@@ -28,6 +30,8 @@ namespace vk_init {
         VkPhysicalDevice gpu;
         QueueFamilyCollection graphics;
         QueueFamilyCollection presentation;
+        // Families with compute but no graphics, usually backed by separate hardware queues. May be empty
+        QueueFamilyCollection compute_only;
     } GpuInfo;
 
     struct SwapchainSupportDetails {
@@ -44,15 +48,17 @@ namespace vk_init {
     QueueFamilyCollection filter(const QueueFamilyCollection& families, const std::function<bool(size_t)> criteria);
     QueueFamilyCollection filter_for_feature_compatability(const QueueFamilyCollection& families, const VkQueueFlagBits queue_feature_flags);
     QueueFamilyCollection filter_for_presentation_compatibility(const VkPhysicalDevice gpu, const VkSurfaceKHR surface, const QueueFamilyCollection& families);
+    QueueFamilyCollection filter_for_compute_only(const QueueFamilyCollection& families);
     VkInstance init_instance(const int extension_count, const char* const* extension_names, vk_types::CleanupProcedures& cleanup_procedures);
     GpuAndQueueInfo init_physical_device(const VkInstance instance, const std::vector<const char*>& required_extensions, const VkSurfaceKHR surface);
     VkDevice init_logical_device(const GpuAndQueueInfo& gpu_info, const std::vector<const char*>& required_extensions, vk_types::CleanupProcedures& cleanup_procedures);
     VkSurfaceKHR init_surface(const VkInstance instance, GLFWwindow* window, vk_types::CleanupProcedures& cleanup_procedures);
     VkSurfaceFormatKHR choose_swapchain_surface_format(const std::vector<VkSurfaceFormatKHR>& format_list);
+    std::optional<VkSurfaceFormatKHR> choose_storage_surface_format(const VkPhysicalDevice gpu, const SwapchainSupportDetails& support);
     VkPresentModeKHR choose_swapchain_present_mode(const std::vector<VkPresentModeKHR>& mode_list);
     VkExtent2D choose_swapchain_extent(const VkSurfaceCapabilitiesKHR& capabilities, const uint32_t width, const uint32_t height);
-    vk_types::Swapchain init_swapchain(const VkDevice device, const GpuAndQueueInfo& gpu_info, const VkSurfaceKHR surface, const uint32_t width, const uint32_t height, vk_types::CleanupProcedures& cleanup_procedures);
-    std::vector<vk_types::Command> init_command(const VkDevice device, const GpuAndQueueInfo& gpu, const uint8_t buffer_count, vk_types::CleanupProcedures& cleanup_procedures);
+    vk_types::Swapchain init_swapchain(const VkDevice device, const GpuAndQueueInfo& gpu_info, const VkSurfaceKHR surface, const uint32_t width, const uint32_t height, const bool storage, vk_types::CleanupProcedures& cleanup_procedures);
+    std::vector<vk_types::Command> init_command(const VkDevice device, const uint32_t queue_family_index, const uint8_t buffer_count, vk_types::CleanupProcedures& cleanup_procedures);
     std::vector<vk_types::Synchronization> init_synchronization(const VkDevice device, const uint8_t buffer_count, vk_types::CleanupProcedures& cleanup_procedures);
     VmaAllocator init_allocator(const VkInstance instance, const VkDevice device, const GpuAndQueueInfo& gpu, vk_types::CleanupProcedures& cleanup_procedures);
 }
@@ -192,6 +198,13 @@ namespace vk_init {
         });
     }
 
+    QueueFamilyCollection filter_for_compute_only(const QueueFamilyCollection& families) {
+        return filter(families, [&](size_t index) {
+            VkQueueFlags flags = families.properties[index].queueFlags;
+            return ((flags & VK_QUEUE_COMPUTE_BIT) != 0) && ((flags & VK_QUEUE_GRAPHICS_BIT) == 0);
+        });
+    }
+
     QueueFamilyCollection filter_for_presentation_compatibility(const VkPhysicalDevice gpu, const VkSurfaceKHR surface, const QueueFamilyCollection& families) {
         return filter(families, [&](size_t index) {
             VkBool32 present_support = false;
@@ -286,6 +299,10 @@ namespace vk_init {
             else if (props.deviceType == VkPhysicalDeviceType::VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) {
                 rankings[device_index] |= (1ULL << 62);
             }
+            // Software rasterizers (lavapipe and friends) rank below real GPUs, but still need to qualify when they're all there is
+            else if (props.deviceType == VkPhysicalDeviceType::VK_PHYSICAL_DEVICE_TYPE_CPU) {
+                rankings[device_index] |= (1ULL << 60);
+            }
 
             VkPhysicalDeviceMemoryProperties memory_props = VkPhysicalDeviceMemoryProperties{};
             vkGetPhysicalDeviceMemoryProperties(device, &memory_props);
@@ -310,7 +327,8 @@ namespace vk_init {
             // We also need to know if a graphics capable queue family exists
             QueueFamilyCollection queue_families = find_queue_families(device);
             QueueFamilyCollection supporting_graphics = filter_for_feature_compatability(queue_families, VK_QUEUE_GRAPHICS_BIT);
-            QueueFamilyCollection supporting_presentation = filter_for_presentation_compatibility(device, surface, queue_families);
+            // Without a surface nothing gets presented, so any graphics family will do
+            QueueFamilyCollection supporting_presentation = (surface != VK_NULL_HANDLE) ? filter_for_presentation_compatibility(device, surface, queue_families) : supporting_graphics;
 
             // If the device can't do what the program needs, disqualify it completely
             if ((!supports_extensions) || 
@@ -341,12 +359,13 @@ namespace vk_init {
         // Be lazy and redo a little work
         QueueFamilyCollection queue_families = find_queue_families(best_device);
         QueueFamilyCollection supporting_graphics = filter_for_feature_compatability(queue_families, VK_QUEUE_GRAPHICS_BIT);
-        QueueFamilyCollection supporting_presentation = filter_for_presentation_compatibility(best_device, surface, queue_families);
+        QueueFamilyCollection supporting_presentation = (surface != VK_NULL_HANDLE) ? filter_for_presentation_compatibility(best_device, surface, queue_families) : supporting_graphics;
 
         return GpuAndQueueInfo {
             best_device,
             supporting_graphics,
-            supporting_presentation
+            supporting_presentation,
+            filter_for_compute_only(queue_families)
         };
     }
 
@@ -370,12 +389,15 @@ namespace vk_init {
             graphics_queue_family_indices[0], 
             presentation_queue_family_indices[0],
         };
+        if (!gpu_info.compute_only.indices.empty()) {
+            queue_indices.insert(gpu_info.compute_only.indices[0]);
+        }
         std::vector<VkDeviceQueueCreateInfo> queue_create_infos = {};
         float queue_priority = 1.0f; 
         for (auto queue_index : queue_indices) {
             VkDeviceQueueCreateInfo device_queue_create_info{};
             device_queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            device_queue_create_info.queueFamilyIndex = graphics_queue_family_indices[0];
+            device_queue_create_info.queueFamilyIndex = queue_index;
             device_queue_create_info.queueCount = 1;
             device_queue_create_info.pQueuePriorities = &queue_priority;
             queue_create_infos.push_back(device_queue_create_info);
@@ -384,6 +406,12 @@ namespace vk_init {
         // Do the janky Vulkan 1.2 + 1.3 features enabling song and dance
         VkPhysicalDeviceFeatures device_features{};
         device_features.samplerAnisotropy = VK_TRUE;
+        // Optional, only used for profiling when available
+        VkPhysicalDeviceFeatures supported_features{};
+        vkGetPhysicalDeviceFeatures(gpu_info.gpu, &supported_features);
+        device_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+        // Optional, the visibility buffer needs it to write gl_PrimitiveID from a fragment shader
+        device_features.geometryShader = supported_features.geometryShader;
         VkPhysicalDeviceVulkan13Features features13 = {};
         features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
         features13.dynamicRendering = VK_TRUE;
@@ -466,6 +494,26 @@ namespace vk_init {
         return format_list[0];
     }
 
+    // Storage images never get sRGB encoding on store, so compute writing the swapchain needs a UNORM format presented as sRGB and encodes itself
+    std::optional<VkSurfaceFormatKHR> choose_storage_surface_format(const VkPhysicalDevice gpu, const SwapchainSupportDetails& support) {
+        if ((support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) == 0) {
+            return std::nullopt;
+        }
+        for (const VkFormat candidate : { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM }) {
+            VkFormatProperties properties = {};
+            vkGetPhysicalDeviceFormatProperties(gpu, candidate, &properties);
+            if ((properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) == 0) {
+                continue;
+            }
+            for (const auto& format : support.formats) {
+                if (format.format == candidate && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+                    return format;
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
     VkPresentModeKHR choose_swapchain_present_mode(const std::vector<VkPresentModeKHR>& mode_list) {
         // Prefer mailbox
         for (const auto& mode : mode_list) {
@@ -493,10 +541,15 @@ namespace vk_init {
         }
     }
 
-    vk_types::Swapchain init_swapchain(const VkDevice device, const GpuAndQueueInfo& gpu_info, const VkSurfaceKHR surface, const uint32_t width, const uint32_t height, vk_types::CleanupProcedures& cleanup_procedures) {
+    vk_types::Swapchain init_swapchain(const VkDevice device, const GpuAndQueueInfo& gpu_info, const VkSurfaceKHR surface, const uint32_t width, const uint32_t height, const bool storage, vk_types::CleanupProcedures& cleanup_procedures) {
         SwapchainSupportDetails swapchain_support = query_swapchain_support(gpu_info.gpu, surface);
 
         VkSurfaceFormatKHR surface_format = choose_swapchain_surface_format(swapchain_support.formats);
+        // Falls back to the usual sRGB format without storage when the surface or device can't manage it
+        std::optional<VkSurfaceFormatKHR> storage_format = storage ? choose_storage_surface_format(gpu_info.gpu, swapchain_support) : std::nullopt;
+        if (storage_format.has_value()) {
+            surface_format = storage_format.value();
+        }
         VkPresentModeKHR present_mode = choose_swapchain_present_mode(swapchain_support.present_modes);
         VkExtent2D extent = choose_swapchain_extent(swapchain_support.capabilities, width, height);
 
@@ -517,6 +570,9 @@ namespace vk_init {
         swapchain_create_info.imageExtent = extent;
         swapchain_create_info.imageArrayLayers = 1;
         swapchain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (storage_format.has_value()) {
+            swapchain_create_info.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        }
 
         // Specify behavior when the graphics queue family is not also the presentation queue family
         uint32_t separate_queue_indices[] = {gpu_info.graphics.indices[0], gpu_info.presentation.indices[0]};
@@ -553,7 +609,8 @@ namespace vk_init {
         
         // Construct image views for the images
         const uint32_t NO_MIPMAPS = 1;
-        std::vector<VkImageView> swapchain_views(swapchain_images.size());
+        std::vector<VkImageView> swapchain_views;
+        swapchain_views.reserve(swapchain_images.size());
         for (auto swapchain_image : swapchain_images) {
             VkImageView view = vk_image::init_image_view(device, swapchain_image, vk_image::Representation::Flat, surface_format.format, NO_MIPMAPS, cleanup_procedures);
             swapchain_views.push_back(view);
@@ -566,6 +623,7 @@ namespace vk_init {
         swapchain.extent = extent;
         swapchain.images = swapchain_images;
         swapchain.views  = swapchain_views;
+        swapchain.storage = storage_format.has_value();
 
         cleanup_procedures.add([device, swapchain]() {
             vkDestroySwapchainKHR(device, swapchain.handle, nullptr);
@@ -574,13 +632,13 @@ namespace vk_init {
         return swapchain;
     }
 
-    std::vector<vk_types::Command> init_command(const VkDevice device, const GpuAndQueueInfo& gpu, const uint8_t buffer_count, vk_types::CleanupProcedures& cleanup_procedures) {
+    std::vector<vk_types::Command> init_command(const VkDevice device, const uint32_t queue_family_index, const uint8_t buffer_count, vk_types::CleanupProcedures& cleanup_procedures) {
         std::vector<vk_types::Command> per_frame_command_data(buffer_count, vk_types::Command{});
         VkCommandPoolCreateInfo command_pool_info = {};
         command_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         command_pool_info.pNext = nullptr;
         command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        command_pool_info.queueFamilyIndex = gpu.graphics.indices[0];
+        command_pool_info.queueFamilyIndex = queue_family_index;
 
         for (size_t i = 0; i < buffer_count; ++i) {
             VkResult command_pool_result = vkCreateCommandPool(device, &command_pool_info, nullptr, &(per_frame_command_data[i].pool));
@@ -649,13 +707,29 @@ namespace vk_init {
 
             VkResult render_semaphore_result =
                 vkCreateSemaphore(device, &semaphore_info, nullptr, &(per_frame_synchronization_structures[i].render_semaphore));
-            if (swapchain_semaphore_result != VK_SUCCESS) {
+            if (render_semaphore_result != VK_SUCCESS) {
                 printf("Unable to create render semaphore for frame %zu\n", i);
                 exit(EXIT_FAILURE);
             }
+
+            VkResult compute_semaphore_result =
+                vkCreateSemaphore(device, &semaphore_info, nullptr, &(per_frame_synchronization_structures[i].compute_semaphore));
+            if (compute_semaphore_result != VK_SUCCESS) {
+                printf("Unable to create compute semaphore for frame %zu\n", i);
+                exit(EXIT_FAILURE);
+            }
+
+            VkResult graphics_semaphore_result =
+                vkCreateSemaphore(device, &semaphore_info, nullptr, &(per_frame_synchronization_structures[i].graphics_semaphore));
+            if (graphics_semaphore_result != VK_SUCCESS) {
+                printf("Unable to create graphics semaphore for frame %zu\n", i);
+                exit(EXIT_FAILURE);
+            }
         }
         cleanup_procedures.add([device, per_frame_synchronization_structures](){
             for (auto synchronization : per_frame_synchronization_structures) {
+                vkDestroySemaphore(device, synchronization.graphics_semaphore, nullptr);
+                vkDestroySemaphore(device, synchronization.compute_semaphore, nullptr);
                 vkDestroySemaphore(device, synchronization.render_semaphore, nullptr);
                 vkDestroySemaphore(device, synchronization.swapchain_semaphore, nullptr);
             }
@@ -679,32 +753,33 @@ namespace vk_init {
         return allocator;
     }
 
-    vk_types::Context init(const std::vector<const char*>& required_device_extensions, const std::vector<const char*>& glfw_extensions, GLFWwindow* window) {
-        // Setup tracker for resources that need to be cleaned up
-        vk_types::CleanupProcedures cleanup_procedures{};
-        VkInstance vulkan_instance = init_instance(glfw_extensions.size(), glfw_extensions.data(), cleanup_procedures);
-        VkSurfaceKHR vulkan_surface = init_surface(vulkan_instance, window, cleanup_procedures);
-        GpuAndQueueInfo vulkan_gpu = init_physical_device(vulkan_instance, required_device_extensions, vulkan_surface);
-        VkDevice vulkan_device = init_logical_device(vulkan_gpu, required_device_extensions, cleanup_procedures);
-        
-        int w;
-        int h;
-        glfwGetFramebufferSize(window, &w, &h);
-        uint32_t width = static_cast<uint32_t>(w);
-        uint32_t height = static_cast<uint32_t>(h);
-
-        vk_types::Swapchain swapchain = init_swapchain(vulkan_device, vulkan_gpu, vulkan_surface, width, height, cleanup_procedures);
-        
+    // Builds out everything past device and swapchain creation, which is common between windowed and headless contexts
+    vk_types::Context init_context_common(vk_types::CleanupProcedures& cleanup_procedures, const VkInstance vulkan_instance, const VkSurfaceKHR vulkan_surface, const GpuAndQueueInfo& vulkan_gpu, const VkDevice vulkan_device, const vk_types::Swapchain& swapchain, const uint8_t frames_in_flight) {
         // Get the queue handles
         vk_types::Queues queues = {};
         vkGetDeviceQueue(vulkan_device, vulkan_gpu.graphics.indices[0], 0, &(queues.graphics));
         vkGetDeviceQueue(vulkan_device, vulkan_gpu.presentation.indices[0], 0, &(queues.presentation));
+        queues.graphics_family_index = vulkan_gpu.graphics.indices[0];
+        // Left null without a compute only family
+        if (!vulkan_gpu.compute_only.indices.empty()) {
+            queues.compute_family_index = vulkan_gpu.compute_only.indices[0];
+            vkGetDeviceQueue(vulkan_device, queues.compute_family_index, 0, &(queues.compute));
+        }
 
-        // Double buffering for our command buffers and synchronization structures
-        const uint8_t DOUBLE_BUFFER = 2;
-        const std::vector<vk_types::Command> command = init_command(vulkan_device, vulkan_gpu, DOUBLE_BUFFER, cleanup_procedures);
-        const vk_types::Command command_immediate = init_command(vulkan_device, vulkan_gpu, 1, cleanup_procedures)[0];
-        const std::vector<vk_types::Synchronization> synchronization = init_synchronization(vulkan_device, DOUBLE_BUFFER, cleanup_procedures);
+        // One set of command buffers and synchronization structures per frame in flight
+        if (frames_in_flight == 0) {
+            printf("Need at least one frame in flight\n");
+            exit(EXIT_FAILURE);
+        }
+        const std::vector<vk_types::Command> command = init_command(vulkan_device, queues.graphics_family_index, frames_in_flight, cleanup_procedures);
+        const std::vector<vk_types::Command> compute_command = (queues.compute != VK_NULL_HANDLE) ?
+            init_command(vulkan_device, queues.compute_family_index, frames_in_flight, cleanup_procedures) :
+            std::vector<vk_types::Command>{};
+        const std::vector<vk_types::Command> compose_command = (queues.compute != VK_NULL_HANDLE) ?
+            init_command(vulkan_device, queues.graphics_family_index, frames_in_flight, cleanup_procedures) :
+            std::vector<vk_types::Command>{};
+        const vk_types::Command command_immediate = init_command(vulkan_device, queues.graphics_family_index, 1, cleanup_procedures)[0];
+        const std::vector<vk_types::Synchronization> synchronization = init_synchronization(vulkan_device, frames_in_flight, cleanup_procedures);
         const VkFence fence_immediate = init_fence(vulkan_device, cleanup_procedures);
 
         const VmaAllocator allocator = init_allocator(vulkan_instance, vulkan_device, vulkan_gpu, cleanup_procedures);
@@ -722,12 +797,54 @@ namespace vk_init {
             swapchain,
             queues,
             command,
+            compute_command,
+            compose_command,
             command_immediate,
             synchronization,
             fence_immediate,
             allocator,
             mega_descriptor_set,
-            DOUBLE_BUFFER
+            frames_in_flight
         };
     }
+
+    vk_types::Context init(const std::vector<const char*>& required_device_extensions, const std::vector<const char*>& glfw_extensions, GLFWwindow* window, const bool storage_swapchain, const uint8_t frames_in_flight) {
+        TRACE_ZONE("vk_init::init");
+        // Setup tracker for resources that need to be cleaned up
+        vk_types::CleanupProcedures cleanup_procedures{};
+        VkInstance vulkan_instance = init_instance(glfw_extensions.size(), glfw_extensions.data(), cleanup_procedures);
+        VkSurfaceKHR vulkan_surface = init_surface(vulkan_instance, window, cleanup_procedures);
+        GpuAndQueueInfo vulkan_gpu = init_physical_device(vulkan_instance, required_device_extensions, vulkan_surface);
+        VkDevice vulkan_device = init_logical_device(vulkan_gpu, required_device_extensions, cleanup_procedures);
+        
+        int w;
+        int h;
+        glfwGetFramebufferSize(window, &w, &h);
+        uint32_t width = static_cast<uint32_t>(w);
+        uint32_t height = static_cast<uint32_t>(h);
+
+        vk_types::Swapchain swapchain = init_swapchain(vulkan_device, vulkan_gpu, vulkan_surface, width, height, storage_swapchain, cleanup_procedures);
+        
+        return init_context_common(cleanup_procedures, vulkan_instance, vulkan_surface, vulkan_gpu, vulkan_device, swapchain, frames_in_flight);
+    }
+
+    vk_types::Context init_headless(const std::vector<const char*>& required_device_extensions, const std::vector<const char*>& instance_extensions, const VkExtent2D extent, const uint8_t frames_in_flight) {
+        TRACE_ZONE("vk_init::init_headless");
+        // Setup tracker for resources that need to be cleaned up
+        vk_types::CleanupProcedures cleanup_procedures{};
+        VkInstance vulkan_instance = init_instance(instance_extensions.size(), instance_extensions.data(), cleanup_procedures);
+        // No window means no surface. Device selection and queue setup treat a null surface as 'present on the graphics queue'
+        VkSurfaceKHR vulkan_surface = VK_NULL_HANDLE;
+        GpuAndQueueInfo vulkan_gpu = init_physical_device(vulkan_instance, required_device_extensions, vulkan_surface);
+        VkDevice vulkan_device = init_logical_device(vulkan_gpu, required_device_extensions, cleanup_procedures);
+
+        // Stand-in swapchain with no images. Only the extent is meaningful, render targets are sized from it
+        vk_types::Swapchain swapchain{};
+        swapchain.handle = VK_NULL_HANDLE;
+        swapchain.format = VK_FORMAT_UNDEFINED;
+        swapchain.extent = extent;
+        swapchain.storage = false;
+
+        return init_context_common(cleanup_procedures, vulkan_instance, vulkan_surface, vulkan_gpu, vulkan_device, swapchain, frames_in_flight);
+    }
 }
\ No newline at end of file
@@ -11,7 +11,11 @@
 
 namespace vk_init {
 
-    vk_types::Context init(const std::vector<const char*>& required_device_extensions, const std::vector<const char*>& glfw_extensions, GLFWwindow* window);
+    // frames_in_flight sets how many command buffers, fences, and per-frame resources are cycled through, and becomes the context's buffer_count.
+    // storage_swapchain asks for swapchain images compute can write, in a UNORM format, which the swapchain's storage flag reports on
+    vk_types::Context init(const std::vector<const char*>& required_device_extensions, const std::vector<const char*>& glfw_extensions, GLFWwindow* window, const bool storage_swapchain, const uint8_t frames_in_flight);
+    // Initializes without a surface or swapchain for offscreen rendering. The context's swapchain has a null handle and no images, but carries the requested extent
+    vk_types::Context init_headless(const std::vector<const char*>& required_device_extensions, const std::vector<const char*>& instance_extensions, const VkExtent2D extent, const uint8_t frames_in_flight);
 }
 
 #endif
\ No newline at end of file
@@ -4,11 +4,17 @@
 #include "vk_init.hpp"
 #include "vk_layer.hpp"
 #include "vk_pipeline.hpp"
+#include "shaders.hpp"
 #include "vk_types.hpp"
 #include "sync.hpp"
+#include "trace.hpp"
+#include "job_pool.hpp"
+#include "workgroup_tuning.hpp"
+#include "frustum.hpp"
 
 #include <GLFW/glfw3.h>
 #include <array>
+#include <cstddef>
 #include <vulkan/vk_enum_string_helper.h>
 #include <vector>
 #include <functional>
@@ -17,6 +23,8 @@
 #include <set>
 #include <iterator>
 #include <algorithm>
+#include <bit>
+#include <chrono>
 #include "vk_mem_alloc.h"
 
 
@@ -24,13 +32,70 @@
 namespace vk_layer {
     namespace {
         VkCommandBufferSubmitInfo make_command_buffer_submit_info(const VkCommandBuffer cmd);
-        VkSubmitInfo2 make_submit_info(const VkCommandBufferSubmitInfo& cmd, const VkSemaphoreSubmitInfo& signal_semaphore_info, const VkSemaphoreSubmitInfo& wait_semaphore_info);
+        VkSubmitInfo2 make_submit_info(const VkCommandBufferSubmitInfo& cmd, std::span<const VkSemaphoreSubmitInfo> signal_semaphore_infos, std::span<const VkSemaphoreSubmitInfo> wait_semaphore_infos);
         void clear_attachments(const VkCommandBuffer cmd, std::span<VkRenderingAttachmentInfo> attachments, std::span<VkExtent2D> extents);
     }
 }
 
 namespace vk_layer {
     namespace {
+        // What each color target is used for, so each asks its format for no more than it needs. The space target is also
+        // written as a storage image when the visibility buffer shades into it
+        const VkImageUsageFlags SPACE_TARGET_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        const VkImageUsageFlags GRID_TARGET_USAGE = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        const VkImageUsageFlags COMPOSE_TARGET_USAGE = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        const VkImageUsageFlags JAR_MASK_TARGET_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        const VkFormat JAR_MASK_DEPTH_FORMAT = VK_FORMAT_D16_UNORM;
+        // The visibility target packs the draw ID above the triangle ID, with draw IDs offset by one so 0 means nothing covers the pixel.
+        // Must match TRIANGLE_BITS in visibility.glsl.frag and visibility_shade.glsl.comp
+        const VkFormat VISIBILITY_TARGET_FORMAT = VK_FORMAT_R32_UINT;
+        const uint32_t VISIBILITY_TRIANGLE_BITS = 22;
+        const uint64_t VISIBILITY_MAX_TRIANGLES = 1ULL << VISIBILITY_TRIANGLE_BITS;
+        const uint64_t VISIBILITY_MAX_DRAWS = (1ULL << (32 - VISIBILITY_TRIANGLE_BITS)) - 1;
+        // std430 lays DrawRecord out with the matrix on a 16 byte boundary and the whole struct padded to 16
+        static_assert(offsetof(VisibilityDrawRecord, model) == 32 && sizeof(VisibilityDrawRecord) == 112, "VisibilityDrawRecord has to match DrawRecord in visibility_shade.glsl.comp");
+        // Lights are culled per square tile of pixels, one culling workgroup each. Each tile's list is a count followed by up to
+        // MAX_LIGHTS_PER_TILE light indices. Must match point_lights.glsl
+        const uint32_t LIGHT_TILE_SIZE = 16;
+        const VkExtent2D LIGHT_TILE_EXTENT = { LIGHT_TILE_SIZE, LIGHT_TILE_SIZE };
+        const uint64_t MAX_LIGHTS_PER_TILE = 255;
+        const uint64_t LIGHT_TILE_BYTES = (MAX_LIGHTS_PER_TILE + 1) * sizeof(uint32_t);
+        // Buffer references sit on 8 byte boundaries after the leading indices
+        static_assert(offsetof(SpacePassPushConstants, lights_address) == 16 && sizeof(SpacePassPushConstants) == 32, "SpacePassPushConstants has to match PushConstants in colored_triangle.glsl.frag");
+        static_assert(offsetof(VisibilityShadePushConstants, lights_address) == 16 && offsetof(VisibilityShadePushConstants, render_height) == 40, "VisibilityShadePushConstants has to match PushConstants in visibility_shade.glsl.comp");
+        static_assert(sizeof(lights::PointLight) == 32, "lights::PointLight has to match PointLight in point_lights.glsl");
+        // Classified compose sorts square tiles into three classes by jar mask coverage, one classifier workgroup per tile.
+        // The tile buffer starts with one set of indirect dispatch arguments per class. Must match compose_tiles.glsl
+        const uint32_t COMPOSE_TILE_SIZE = 16;
+        const VkExtent2D COMPOSE_TILE_EXTENT = { COMPOSE_TILE_SIZE, COMPOSE_TILE_SIZE };
+        const uint32_t COMPOSE_TILE_CLASS_COUNT = 3;
+        const std::array<const char*, COMPOSE_TILE_CLASS_COUNT> COMPOSE_TILE_CLASS_PIPELINE_NAMES = { "compose space tiles pipeline", "compose grid tiles pipeline", "compose edge tiles pipeline" };
+        static_assert(std::tuple_size_v<decltype(Pipelines::compose_tiles)> == COMPOSE_TILE_CLASS_COUNT, "Pipelines needs a compose pipeline per tile class");
+        static_assert(offsetof(ComposePassPushConstants, tiles_address) == 40, "ComposePassPushConstants has to match PushConstants in compose.glsl.comp");
+        // Compose pipelines that aren't classified are specialized to compose every pixel
+        const uint32_t COMPOSE_TILE_CLASS_ALL = COMPOSE_TILE_CLASS_COUNT;
+        // Where compose and its classifier read the jar mask from. Must match jar_mask.glsl
+        const uint32_t JAR_MASK_COLOR = 0;
+        const uint32_t JAR_MASK_STENCIL = 1;
+        const uint32_t JAR_MASK_STENCIL_FEATHERED = 2;
+        // Specialization constant for compose_output.glsl, set when compose encodes sRGB for a UNORM swapchain
+        const uint32_t COMPOSE_ENCODE_LINEAR = VK_FALSE;
+        const uint32_t COMPOSE_ENCODE_SRGB = VK_TRUE;
+        // The jar pass marks its inner surfaces with this value, and the space scene only draws where it finds it
+        const uint32_t JAR_STENCIL_VALUE = 1;
+        const VkStencilOpState JAR_STENCIL_WRITE = { VK_STENCIL_OP_KEEP, VK_STENCIL_OP_REPLACE, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_ALWAYS, 0xff, 0xff, JAR_STENCIL_VALUE };
+        const VkStencilOpState JAR_STENCIL_TEST = { VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_EQUAL, 0xff, 0x00, JAR_STENCIL_VALUE };
+        // Occlusion culling's phases, which are both its culling pipelines' specialization constant and where each phase's draw commands start in units of the piece count.
+        // Culling runs one invocation per piece and the pyramid's levels shrink quickly, so neither workgroup size is up for tuning
+        const uint32_t OCCLUSION_PHASE_EARLY = 0;
+        const uint32_t OCCLUSION_PHASE_LATE = 1;
+        const std::array<const char*, 2> OCCLUSION_CULL_PIPELINE_NAMES = { "occlusion cull early pipeline", "occlusion cull late pipeline" };
+        const VkExtent2D OCCLUSION_CULL_WORKGROUP_EXTENT = { 64, 1 };
+        const VkExtent2D DEPTH_PYRAMID_WORKGROUP_EXTENT = { 8, 8 };
+        const VkFormat DEPTH_PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+        static_assert(offsetof(OcclusionCullPushConstants, bounds_address) == 64 && offsetof(OcclusionCullPushConstants, depth_height) == 104, "OcclusionCullPushConstants has to match PushConstants in occlusion_cull.glsl.comp");
+        static_assert(sizeof(OcclusionCounters) == 16, "OcclusionCounters has to match Counters in occlusion_cull.glsl.comp");
+        static_assert(sizeof(VkDrawIndexedIndirectCommand) == 20, "VkDrawIndexedIndirectCommand has to match DrawCommand in occlusion_cull.glsl.comp");
 
         VkSemaphoreSubmitInfo make_semaphore_submit_info(const VkPipelineStageFlags2 stage_mask, const VkSemaphore semaphore) {
             VkSemaphoreSubmitInfo semaphore_submit_info{};
@@ -55,21 +120,17 @@ namespace vk_layer {
             return command_buffer_submit_info;
         }
 
-        // Makes submit info struct. Passing in zeroed out semaphore submit info will cause those to be ignored
-        VkSubmitInfo2 make_submit_info(const VkCommandBufferSubmitInfo& cmd, const VkSemaphoreSubmitInfo& signal_semaphore_info, const VkSemaphoreSubmitInfo& wait_semaphore_info) {
+        // Makes submit info struct. The semaphore infos have to outlive it, and either may be empty
+        VkSubmitInfo2 make_submit_info(const VkCommandBufferSubmitInfo& cmd, std::span<const VkSemaphoreSubmitInfo> signal_semaphore_infos, std::span<const VkSemaphoreSubmitInfo> wait_semaphore_infos) {
             VkSubmitInfo2 submit_info = {};
             submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
             submit_info.pNext = nullptr;
 
-            if (wait_semaphore_info.sType != 0) {
-                submit_info.waitSemaphoreInfoCount = 1;
-                submit_info.pWaitSemaphoreInfos = &wait_semaphore_info;
-            }
+            submit_info.waitSemaphoreInfoCount = static_cast<uint32_t>(wait_semaphore_infos.size());
+            submit_info.pWaitSemaphoreInfos = wait_semaphore_infos.data();
 
-            if (signal_semaphore_info.sType != 0) {
-                submit_info.signalSemaphoreInfoCount = 1;
-                submit_info.pSignalSemaphoreInfos = &signal_semaphore_info;
-            }
+            submit_info.signalSemaphoreInfoCount = static_cast<uint32_t>(signal_semaphore_infos.size());
+            submit_info.pSignalSemaphoreInfos = signal_semaphore_infos.data();
 
             submit_info.commandBufferInfoCount = 1;
             submit_info.pCommandBufferInfos = &cmd;
@@ -133,24 +194,67 @@ namespace vk_layer {
             vkCmdDispatch(cmd, dispatch_x, dispatch_y, 1);
         }
 
-        void draw_background_skybox(const VkCommandBuffer cmd,
-                                    const std::function<std::vector<VkDescriptorSet>(size_t)>& get_descriptor_sets, 
-                                    const std::function<void(size_t)>& set_push_constants,
-                                    const vk_types::AllocatedImage& background_target,
+        // Same, with the workgroup counts read from a VkDispatchIndirectCommand the GPU wrote
+        void draw_compute_indirect( const VkCommandBuffer cmd,
+                                    const std::function<std::vector<VkDescriptorSet>()>& get_descriptor_sets,
+                                    const std::function<void()>& set_push_constants,
                                     const vk_types::Pipeline& pipeline,
-                                    const Drawable& cube_model,
-                                    const DrawState& state) {
+                                    const VkBuffer arguments,
+                                    const VkDeviceSize arguments_offset)
+        {
+            vkCmdBindPipeline(cmd, pipeline.bind_point, pipeline.handle);
+            std::vector<VkDescriptorSet> descriptor_sets = get_descriptor_sets();
+            set_push_constants();
+            vkCmdBindDescriptorSets(cmd, pipeline.bind_point, pipeline.layout, 0, descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+            vkCmdDispatchIndirect(cmd, arguments, arguments_offset);
+        }
+
+        // A depth/stencil buffer is attached, laid out and transitioned with both aspects together
+        VkImageLayout depth_attachment_layout(const vk_types::AllocatedImage& depth_buffer) {
+            return vk_image::has_stencil(depth_buffer.image_format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+        }
+
+        void transition_depth(const VkCommandBuffer cmd, const vk_types::AllocatedImage& depth_buffer, const VkImageLayout starting_layout, const VkImageLayout ending_layout) {
+            sync::transition_image(cmd, depth_buffer.image, vk_image::make_subresource_range(vk_image::image_aspects(depth_buffer.image_format)), starting_layout, ending_layout);
+        }
+
+        // Leaves a depth attachment with nothing bound when there's no depth buffer
+        VkRenderingAttachmentInfo make_depth_attachment(const vk_types::AllocatedImage& depth_buffer) {
+            VkRenderingAttachmentInfo depth_attachment = {}; 
+            depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            depth_attachment.pNext = nullptr;
+            depth_attachment.imageLayout = depth_attachment_layout(depth_buffer);
+            depth_attachment.imageView = depth_buffer.image_view;
+            depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            // Not multisampling so set this off and leave the resolve view and layouts zeroed out
+            depth_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+            // Not using VK_ATTACHMENT_LOAD_OP_CLEAR, so no need to set clear value either
+            return depth_attachment;
+        }
+
+        void draw_skybox(   const VkCommandBuffer cmd,
+                            const std::function<std::vector<VkDescriptorSet>()>& get_descriptor_sets, 
+                            const std::function<void()>& set_push_constants,
+                            const vk_types::AllocatedImage& draw_target,
+                            const vk_types::AllocatedImage& depth_buffer,
+                            const vk_types::Pipeline& pipeline,
+                            const VkExtent2D render_extent,
+                            const DrawState& state) {
             // Set up draw target attachment
             VkRenderingAttachmentInfo color_attachment = {}; 
             color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
             color_attachment.pNext = nullptr;
             color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            color_attachment.imageView = background_target.image_view;
+            color_attachment.imageView = draw_target.image_view;
             color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
             color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
             // Not multisampling so set this off and leave the resolve view and layouts zeroed out
             color_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
             // Not using VK_ATTACHMENT_LOAD_OP_CLEAR, so no need to set clear value either
+
+            // The depth the space pass left behind decides which pixels still show the sky. It's only tested against, never written
+            VkRenderingAttachmentInfo depth_attachment = make_depth_attachment(depth_buffer);
             
             VkRenderingInfo render_info = {};
             render_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
@@ -160,8 +264,9 @@ namespace vk_layer {
             render_info.layerCount = 1;
             render_info.pColorAttachments = &color_attachment;
             render_info.colorAttachmentCount = 1;
-            render_info.pDepthAttachment = nullptr;
-            render_info.renderArea.extent = background_target.image_extent;
+            render_info.pDepthAttachment = &depth_attachment;
+            render_info.pStencilAttachment = vk_image::has_stencil(depth_buffer.image_format) ? &depth_attachment : nullptr;
+            render_info.renderArea.extent = render_extent;
             render_info.renderArea.offset = VkOffset2D{ 0, 0 };
             vkCmdBeginRendering(cmd, &render_info);
 
@@ -171,8 +276,8 @@ namespace vk_layer {
             VkViewport viewport = {};
             viewport.x = 0;
             viewport.y = 0;
-            viewport.width = background_target.image_extent.width;
-            viewport.height = background_target.image_extent.height;
+            viewport.width = render_extent.width;
+            viewport.height = render_extent.height;
             viewport.minDepth = 0.0f;
             viewport.maxDepth = 1.0f;
 
@@ -181,43 +286,49 @@ namespace vk_layer {
             VkRect2D scissor = {};
             scissor.offset.x = 0;
             scissor.offset.y = 0;
-            scissor.extent = background_target.image_extent;
+            scissor.extent = render_extent;
 
             vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-            // Draw all buffers
-            for (int piece = 0; piece < cube_model.gpu_model.vertex_buffers.size(); ++piece) {
-                // Bind up the descriptors to match each piece
-                std::vector<VkDescriptorSet> skybox_descriptor_sets = get_descriptor_sets(piece);
-                vkCmdBindDescriptorSets(cmd, pipeline.bind_point, pipeline.layout, 0, skybox_descriptor_sets.size(), skybox_descriptor_sets.data(), 0, nullptr);
-
-                // Push the push constants
-                set_push_constants(piece);
+            std::vector<VkDescriptorSet> skybox_descriptor_sets = get_descriptor_sets();
+            vkCmdBindDescriptorSets(cmd, pipeline.bind_point, pipeline.layout, 0, skybox_descriptor_sets.size(), skybox_descriptor_sets.data(), 0, nullptr);
+            set_push_constants();
 
-                // Bind the vertex buffers and fire off an indexed draw
-                const vk_types::GpuMeshBuffers& buffer_group = cube_model.gpu_model.vertex_buffers[piece];
-                vkCmdBindIndexBuffer(cmd, buffer_group.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-                std::array<VkBuffer, 3> buffer_handles {{
-                    buffer_group.position_buffer.vertex_buffer.buffer,
-                    buffer_group.normal_buffer.vertex_buffer.buffer,
-                    buffer_group.texture_coordinate_buffer.vertex_buffer.buffer
-                }};
-                std::array<VkDeviceSize, 3> offsets {{0,0,0}};
-                vkCmdBindVertexBuffers(cmd, 0, buffer_handles.size(), buffer_handles.data(), offsets.data());
-                vkCmdDrawIndexed(cmd, buffer_group.index_count, 1, 0, 0, 0);
-            }
+            // The vertex shader makes up the fullscreen triangle from the vertex index
+            vkCmdDraw(cmd, 3, 1, 0, 0);
 
             vkCmdEndRendering(cmd);
         }
 
+        // Draws that culling decides on. Pieces flagged 0 in visible_pieces are outside the frustum and skipped altogether, an empty span keeps them all.
+        // Each offset is where one occlusion phase's command for the drawable's first piece sits, and each remaining piece gets an indirect draw per offset.
+        // Without a command buffer the remaining pieces are drawn directly
+        struct CulledDraws {
+            VkBuffer commands;
+            std::vector<VkDeviceSize> first_offsets;
+            std::span<const uint8_t> visible_pieces;
+        };
+
+        // Every piece is drawn count times, the vertex shader picking each copy's model matrix out of the transforms by instance index
+        struct DrawInstances {
+            uint32_t count = 1;
+            VkDeviceAddress transforms_address = 0;
+        };
+
         void draw_geometry( const VkCommandBuffer cmd, 
                             const std::function<std::vector<VkDescriptorSet>(size_t)>& get_descriptor_sets, 
                             const std::function<void(size_t)>& set_push_constants,
-                            bool clear_color, const vk_types::AllocatedImage& draw_target, 
+                            bool clear_color, 
+                            bool clear_depth, 
+                            const vk_types::AllocatedImage& draw_target, 
                             const vk_types::AllocatedImage& depth_buffer, 
                             const vk_types::Pipeline& pipeline, 
-                            const Drawable& drawable, 
-                            const DrawState& state ) {
+                            const geometry::GpuModel& model, 
+                            const vk_types::GeometryArena& arena,
+                            const VkExtent2D render_extent,
+                            const DrawState& state,
+                            const CulledDraws& culled_draws = {},
+                            const DrawInstances& instances = {} ) {
             //begin a render pass  connected to our draw image
 
             // Set up draw target attachment
@@ -232,17 +343,8 @@ namespace vk_layer {
             color_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
             // Not using VK_ATTACHMENT_LOAD_OP_CLEAR, so no need to set clear value either
 
-            // Set up depth buffer attachment
-            VkRenderingAttachmentInfo depth_attachment = {}; 
-            depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-            depth_attachment.pNext = nullptr;
-            depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-            depth_attachment.imageView = depth_buffer.image_view;
-            depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-            depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-            // Not multisampling so set this off and leave the resolve view and layouts zeroed out
-            depth_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
-            // Not using VK_ATTACHMENT_LOAD_OP_CLEAR, so no need to set clear value either
+            // Set up depth buffer attachment. A stencil the buffer carries is attached through the same view
+            VkRenderingAttachmentInfo depth_attachment = make_depth_attachment(depth_buffer);
             
             VkRenderingInfo render_info = {};
             render_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
@@ -253,7 +355,8 @@ namespace vk_layer {
             render_info.pColorAttachments = &color_attachment;
             render_info.colorAttachmentCount = 1;
             render_info.pDepthAttachment = &depth_attachment;
-            render_info.renderArea.extent = draw_target.image_extent;
+            render_info.pStencilAttachment = vk_image::has_stencil(depth_buffer.image_format) ? &depth_attachment : nullptr;
+            render_info.renderArea.extent = render_extent;
             render_info.renderArea.offset = VkOffset2D{ 0, 0 };
 
             vkCmdBeginRendering(cmd, &render_info);
@@ -264,8 +367,8 @@ namespace vk_layer {
             VkViewport viewport = {};
             viewport.x = 0;
             viewport.y = 0;
-            viewport.width = draw_target.image_extent.width;
-            viewport.height = draw_target.image_extent.height;
+            viewport.width = render_extent.width;
+            viewport.height = render_extent.height;
             viewport.minDepth = 0.0f;
             viewport.maxDepth = 1.0f;
 
@@ -274,25 +377,46 @@ namespace vk_layer {
             VkRect2D scissor = {};
             scissor.offset.x = 0;
             scissor.offset.y = 0;
-            scissor.extent = draw_target.image_extent;
+            scissor.extent = render_extent;
 
             vkCmdSetScissor(cmd, 0, 1, &scissor);
 
             // Clear out necessary color/depth buffers
+            std::vector<VkRenderingAttachmentInfo> clear_targets;
+            std::vector<VkExtent2D> clear_extents;
             if (clear_color) {
-                std::array<VkRenderingAttachmentInfo, 2> attachments = {color_attachment, depth_attachment};
-                std::array<VkExtent2D, 2> extents = {draw_target.image_extent, depth_buffer.image_extent};
-                clear_attachments(cmd, attachments, extents);
+                clear_targets.push_back(color_attachment);
+                clear_extents.push_back(render_extent);
+            }
+            if (clear_depth) {
+                clear_targets.push_back(depth_attachment);
+                clear_extents.push_back(render_extent);
+            }
+            if (!clear_targets.empty()) {
+                clear_attachments(cmd, clear_targets, clear_extents);
+            }
+
+            // Every piece's geometry lives in the arena, so its buffers go in once and pieces are told apart by their first index and vertex offset.
+            // A vertex shader that fetches its own attributes gets the start of each stream instead of bound vertex buffers
+            vkCmdBindIndexBuffer(cmd, arena.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+            if (pipeline.pulls_vertices) {
+                VertexStreamPushConstants streams = {};
+                streams.positions_address = arena.vertex_buffer_address + arena.stream_offsets[0];
+                streams.normals_address = arena.vertex_buffer_address + arena.stream_offsets[1];
+                streams.texture_coordinates_address = arena.vertex_buffer_address + arena.stream_offsets[2];
+                streams.instance_transforms_address = instances.transforms_address;
+                vkCmdPushConstants(cmd, pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, PULLED_VERTEX_STREAMS_OFFSET, sizeof(VertexStreamPushConstants), &streams);
             }
             else {
-                std::array<VkRenderingAttachmentInfo, 1> attachments = {depth_attachment};
-                std::array<VkExtent2D, 1> extents = {depth_buffer.image_extent};
-                clear_attachments(cmd, attachments, extents);
+                std::array<VkBuffer, 3> buffer_handles {{ arena.vertex_buffer.buffer, arena.vertex_buffer.buffer, arena.vertex_buffer.buffer }};
+                vkCmdBindVertexBuffers(cmd, 0, buffer_handles.size(), buffer_handles.data(), arena.stream_offsets.data());
             }
-            
-            
-            // Draw all buffers
-            for (int piece = 0; piece < drawable.gpu_model.vertex_buffers.size(); ++piece) {
+
+            // Draw all pieces
+            for (int piece = 0; piece < model.vertex_buffers.size(); ++piece) {
+                if (!culled_draws.visible_pieces.empty() && (culled_draws.visible_pieces[piece] == 0)) {
+                    continue;
+                }
                 // Bind up the descriptors to match each piece
                 std::vector<VkDescriptorSet> descriptor_sets = get_descriptor_sets(piece);
                 vkCmdBindDescriptorSets(cmd, pipeline.bind_point, pipeline.layout, 0, descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
@@ -300,22 +424,221 @@ namespace vk_layer {
                 // Push the push constants
                 set_push_constants(piece);
 
-                // Bind the vertex buffers and fire off an indexed draw
-                const vk_types::GpuMeshBuffers& buffer_group = drawable.gpu_model.vertex_buffers[piece];
-                vkCmdBindIndexBuffer(cmd, buffer_group.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-                std::array<VkBuffer, 3> buffer_handles {{
-                    buffer_group.position_buffer.vertex_buffer.buffer,
-                    buffer_group.normal_buffer.vertex_buffer.buffer,
-                    buffer_group.texture_coordinate_buffer.vertex_buffer.buffer
-                }};
-                std::array<VkDeviceSize, 3> offsets {{0,0,0}};
-                vkCmdBindVertexBuffers(cmd, 0, buffer_handles.size(), buffer_handles.data(), offsets.data());
-                vkCmdDrawIndexed(cmd, buffer_group.index_count, 1, 0, 0, 0);
+                // Fire off an indexed draw of the piece's slice of the arena
+                const vk_types::GpuMeshBuffers& buffer_group = model.vertex_buffers[piece];
+                if (culled_draws.commands == VK_NULL_HANDLE) {
+                    vkCmdDrawIndexed(cmd, buffer_group.index_count, instances.count, buffer_group.first_index, buffer_group.vertex_offset, 0);
+                }
+                // A piece culled in some phase has that phase's instance count set to 0
+                for (const VkDeviceSize first_offset : culled_draws.first_offsets) {
+                    vkCmdDrawIndexedIndirect(cmd, culled_draws.commands, first_offset + piece * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+                }
             }
 
             vkCmdEndRendering(cmd);
         }
 
+        // Enough workgroups to cover the extent, the last row and column may hang over the edge
+        uint32_t dispatch_count(const uint32_t extent, const uint32_t workgroup_size) {
+            return (extent + workgroup_size - 1) / workgroup_size;
+        }
+
+        VkImageUsageFlags space_target_usage(const RenderSettings& render_settings) {
+            return render_settings.visibility_buffer ? (SPACE_TARGET_USAGE | VK_IMAGE_USAGE_STORAGE_BIT) : SPACE_TARGET_USAGE;
+        }
+
+        uint32_t jar_mask_source(const RenderSettings& render_settings) {
+            if (!render_settings.stencil_jar_mask) {
+                return JAR_MASK_COLOR;
+            }
+            return render_settings.feathered_jar_mask ? JAR_MASK_STENCIL_FEATHERED : JAR_MASK_STENCIL;
+        }
+
+        uint32_t compose_encoding(const RenderSettings& render_settings) {
+            return render_settings.direct_compose ? COMPOSE_ENCODE_SRGB : COMPOSE_ENCODE_LINEAR;
+        }
+
+        // The fragment stage's constants of a space scene pipeline, followed by the vertex stage's attribute addresses when it pulls vertices
+        template <class T>
+        std::vector<VkPushConstantRange> space_push_constant_ranges(const bool pulls_vertices) {
+            std::vector<VkPushConstantRange> ranges = { push_constant_range<T>(VK_SHADER_STAGE_FRAGMENT_BIT) };
+            if (pulls_vertices) {
+                VkPushConstantRange streams_range = push_constant_range<VertexStreamPushConstants>(VK_SHADER_STAGE_VERTEX_BIT);
+                streams_range.offset = PULLED_VERTEX_STREAMS_OFFSET;
+                ranges.push_back(streams_range);
+            }
+            return ranges;
+        }
+
+        // The feathered mask that goes with the stencil covers the same corner of a target half the size
+        VkExtent2D jar_mask_extent(const RenderSettings& render_settings, const VkExtent2D extent) {
+            if (!render_settings.stencil_jar_mask) {
+                return extent;
+            }
+            return { dispatch_count(extent.width, 2), dispatch_count(extent.height, 2) };
+        }
+
+        GridPassPushConstants make_grid_push_constants(const RenderTargets& render_targets, const VkExtent2D render_extent) {
+            GridPassPushConstants constants = {};
+            constants.grid_storage_index = render_targets.grid_storage_index;
+            constants.render_width = render_extent.width;
+            constants.render_height = render_extent.height;
+            return constants;
+        }
+
+        // Where this frame's point lights and their tile lists live. All zero without tiled lights, which the shaders take as no point lights
+        struct FrameLights {
+            VkDeviceAddress lights_address;
+            VkDeviceAddress light_tiles_address;
+            uint32_t light_count;
+            uint32_t light_tile_count_x;
+        };
+
+        FrameLights make_frame_lights(const DrawState& state) {
+            FrameLights frame_lights = {};
+            if (state.render_settings.tiled_lights) {
+                frame_lights.lights_address = state.lights->light_buffers[state.frame_in_flight].address;
+                frame_lights.light_tiles_address = state.lights->light_tiles.address;
+                frame_lights.light_count = static_cast<uint32_t>(state.lights->field.lights.size());
+                frame_lights.light_tile_count_x = state.lights->tile_count.width;
+            }
+            return frame_lights;
+        }
+
+        VisibilityShadePushConstants make_visibility_shade_push_constants(const RenderTargets& render_targets, const VisibilityDrawRecords& visibility_draw_records, const FrameLights& frame_lights, const VkExtent2D render_extent) {
+            VisibilityShadePushConstants constants = {};
+            constants.draw_records_address = visibility_draw_records.buffer.address;
+            constants.visibility_storage_index = render_targets.visibility_storage_index;
+            constants.space_storage_index = render_targets.space_storage_index;
+            constants.lights_address = frame_lights.lights_address;
+            constants.light_tiles_address = frame_lights.light_tiles_address;
+            constants.light_tile_count_x = frame_lights.light_tile_count_x;
+            constants.render_width = render_extent.width;
+            constants.render_height = render_extent.height;
+            return constants;
+        }
+
+        ComposePassPushConstants make_compose_push_constants(const RenderTargets& render_targets, const VkExtent2D render_extent) {
+            ComposePassPushConstants constants = {};
+            constants.compose_storage_index = render_targets.compose_storage_index;
+            constants.grid_sampled_index = render_targets.grid_sampled_index;
+            constants.grid_sampler_index = render_targets.grid_sampler_index;
+            constants.jar_stencil_index = render_targets.jar_stencil_index;
+            constants.jar_mask_index = render_targets.jar_mask_index;
+            constants.space_depth_index = render_targets.space_depth_index;
+            constants.space_index = render_targets.space_index;
+            constants.render_width = render_extent.width;
+            constants.render_height = render_extent.height;
+            constants.tiles_address = render_targets.compose_tiles.address;
+            return constants;
+        }
+
+        // Mip levels first_level onwards of the depth pyramid
+        VkImageSubresourceRange pyramid_level_range(const uint32_t first_level, const uint32_t level_count) {
+            VkImageSubresourceRange range = vk_image::make_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+            range.baseMipLevel = first_level;
+            range.levelCount = level_count;
+            return range;
+        }
+
+        // Adds up what the late phase counted on the frame that last used this slot. Only safe once that frame's fence has been waited on
+        void count_occlusion_frame(const vk_types::Context& context, OcclusionCulling& occlusion, const uint64_t frame_in_flight) {
+            const vk_types::AllocatedBuffer& counter_buffer = occlusion.counters[frame_in_flight].buffer;
+            vmaInvalidateAllocation(context.allocator, counter_buffer.allocation, 0, VK_WHOLE_SIZE);
+            const OcclusionCounters* counters = static_cast<const OcclusionCounters*>(counter_buffer.info.pMappedData);
+            occlusion.counted_frames += 1;
+            occlusion.early_drawn += counters->early_drawn;
+            occlusion.late_drawn += counters->late_drawn;
+            occlusion.frustum_culled += counters->frustum_culled;
+            occlusion.occlusion_culled += counters->occlusion_culled;
+        }
+
+        vk_types::Pipeline build_grid_pipeline(const vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, const std::string& shader_directory, const VkExtent2D workgroup_size, vk_pipeline_cache::PipelineCache& pipeline_cache, vk_types::CleanupProcedures& lifetime) {
+            VkShaderModule gradient_shader = vk_pipeline::init_shader_module(context.device, shaders::gradient_comp, shader_directory, lifetime);
+            VkPushConstantRange grid_pc_range = push_constant_range<GridPassPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
+            VkPipelineLayout gradient_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.grid, grid_pc_range, lifetime);
+            return vk_pipeline::init_compute_pipeline(context.device, gradient_pipeline_layout, gradient_shader, workgroup_size, pipeline_cache);
+        }
+
+        // The fused variant shares the layout and push constants, it just has no use for the grid indices
+        vk_types::Pipeline build_compose_pipeline(const vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, const std::string& shader_directory, const bool fused, const uint32_t mask_source, const uint32_t encoding, const VkExtent2D workgroup_size, vk_pipeline_cache::PipelineCache& pipeline_cache, vk_types::CleanupProcedures& lifetime) {
+            VkShaderModule compose_shader = vk_pipeline::init_shader_module(context.device, fused ? shaders::compose_fused_comp : shaders::compose_comp, shader_directory, lifetime);
+            VkPushConstantRange compose_pc_range = push_constant_range<ComposePassPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
+            VkPipelineLayout compose_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.compose, compose_pc_range, lifetime);
+            const std::array<uint32_t, 3> constants = { COMPOSE_TILE_CLASS_ALL, mask_source, encoding };
+            return vk_pipeline::init_compute_pipeline(context.device, compose_pipeline_layout, compose_shader, workgroup_size, pipeline_cache, constants);
+        }
+
+        // The classifier and the per class compose pipelines share compose's layout. A workgroup covers exactly one tile, so their size isn't up for tuning.
+        // The classifier writes nothing, and has no use for the encoding
+        vk_types::Pipeline build_compose_tile_pipeline(const vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, const std::string& shader_directory, const shaders::EmbeddedShader& shader, const uint32_t specialization, const uint32_t mask_source, const uint32_t encoding, vk_pipeline_cache::PipelineCache& pipeline_cache, vk_types::CleanupProcedures& lifetime) {
+            VkShaderModule compose_shader = vk_pipeline::init_shader_module(context.device, shader, shader_directory, lifetime);
+            VkPushConstantRange compose_pc_range = push_constant_range<ComposePassPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
+            VkPipelineLayout compose_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.compose, compose_pc_range, lifetime);
+            const std::array<uint32_t, 3> constants = { specialization, mask_source, encoding };
+            return vk_pipeline::init_compute_pipeline(context.device, compose_pipeline_layout, compose_shader, COMPOSE_TILE_EXTENT, pipeline_cache, constants);
+        }
+
+        // The vertex shader decides where positions and model matrices come from, everything past it is shared by every variant of the space pass
+        vk_types::Pipeline build_space_pipeline(const vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, const RenderTargets& render_targets, const RenderSettings& render_settings, const std::string& shader_directory, const shaders::EmbeddedShader& vert_code, const bool pulls_vertices, vk_pipeline_cache::PipelineCache& pipeline_cache, vk_types::CleanupProcedures& lifetime) {
+            VkShaderModule vert_shader = vk_pipeline::init_shader_module(context.device, vert_code, shader_directory, lifetime);
+            VkShaderModule frag_shader = vk_pipeline::init_shader_module(context.device, shaders::colored_triangle_frag, shader_directory, lifetime);
+            std::vector<VkPushConstantRange> graphics_pc_ranges = space_push_constant_ranges<SpacePassPushConstants>(pulls_vertices);
+            VkPipelineLayout graphics_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.graphics, graphics_pc_ranges, lifetime);
+            vk_pipeline::GraphicsPipelineBuilder standard_render_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, graphics_pipeline_layout, vert_shader, frag_shader, render_targets.space.image_format, render_targets.space_depth.image_format, lifetime);
+            if (pulls_vertices) {
+                standard_render_pipeline_builder.pull_vertices();
+            }
+            if (render_settings.depth_prepass) {
+                // Depth is already final, so only the nearest fragment of each pixel passes and nothing needs writing
+                VkPipelineDepthStencilStateCreateInfo depth_info = {};
+                depth_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depth_info.pNext = nullptr;
+                depth_info.depthTestEnable = VK_TRUE;
+                depth_info.depthWriteEnable = VK_FALSE;
+                depth_info.depthCompareOp = VK_COMPARE_OP_EQUAL;
+                depth_info.depthBoundsTestEnable = VK_FALSE;
+                depth_info.stencilTestEnable = VK_FALSE;
+                depth_info.front = {};
+                depth_info.back = {};
+                depth_info.minDepthBounds = 0.0f;
+                depth_info.maxDepthBounds = 1.0f;
+                standard_render_pipeline_builder.override(depth_info);
+            }
+            // Nothing outside the jar's opening shows through in compose, so it isn't drawn
+            if (render_settings.stencil_jar_mask) {
+                standard_render_pipeline_builder.test_stencil(JAR_STENCIL_TEST);
+            }
+            return standard_render_pipeline_builder.build(pipeline_cache);
+        }
+
+        // Matches the space pipeline with the same vertex source, so the two come out with the same depth
+        vk_types::Pipeline build_depth_prepass_pipeline(const vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, const RenderTargets& render_targets, const RenderSettings& render_settings, const std::string& shader_directory, const shaders::EmbeddedShader& vert_code, const bool pulls_vertices, vk_pipeline_cache::PipelineCache& pipeline_cache, vk_types::CleanupProcedures& lifetime) {
+            VkShaderModule vert_shader = vk_pipeline::init_shader_module(context.device, vert_code, shader_directory, lifetime);
+            VkShaderModule frag_shader = vk_pipeline::init_shader_module(context.device, shaders::depth_prepass_frag, shader_directory, lifetime);
+            std::vector<VkPushConstantRange> graphics_pc_ranges = space_push_constant_ranges<SpacePassPushConstants>(pulls_vertices);
+            VkPipelineLayout graphics_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.graphics, graphics_pc_ranges, lifetime);
+            vk_pipeline::GraphicsPipelineBuilder depth_prepass_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, graphics_pipeline_layout, vert_shader, frag_shader, render_targets.space.image_format, render_targets.space_depth.image_format, lifetime);
+            if (pulls_vertices) {
+                depth_prepass_pipeline_builder.pull_vertices();
+            }
+            // The color target stays bound so the pass can share draw_geometry, but nothing is written to it
+            VkPipelineColorBlendAttachmentState color_blend_attachment{};
+            color_blend_attachment.colorWriteMask = 0;
+            color_blend_attachment.blendEnable = VK_FALSE;
+            VkPipelineColorBlendStateCreateInfo color_blend_info = {};
+            color_blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            color_blend_info.pNext = nullptr;
+            color_blend_info.logicOpEnable = VK_FALSE;
+            color_blend_info.logicOp = VK_LOGIC_OP_COPY;
+            color_blend_info.attachmentCount = 1;
+            color_blend_info.pAttachments = &color_blend_attachment;
+            depth_prepass_pipeline_builder.override(color_blend_info);
+            if (render_settings.stencil_jar_mask) {
+                depth_prepass_pipeline_builder.test_stencil(JAR_STENCIL_TEST);
+            }
+            return depth_prepass_pipeline_builder.build(pipeline_cache);
+        }
     }
 
     void immediate_submit(const vk_types::Context& res, std::function<void(VkCommandBuffer cmd)>&& function) {
@@ -370,60 +693,162 @@ namespace vk_layer {
         return context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, skybox_texture.image_view, texture_sampler); 
     }
     
-    Pipelines build_pipelines(vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, RenderTargets& render_targets, vk_types::CleanupProcedures& lifetime) {
+    Pipelines build_pipelines(vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, RenderTargets& render_targets, vk_pipeline_cache::PipelineCache& pipeline_cache, const RenderSettings& render_settings, const PipelineSettings& settings, vk_types::CleanupProcedures& lifetime) {
+        TRACE_ZONE("build_pipelines");
+        // Each job loads its own shaders and sets up its own state, so jobs are independent and compile side by side
+        struct PipelineJob {
+            const char* name;
+            vk_types::Pipeline* output;
+            std::function<vk_types::Pipeline(vk_types::CleanupProcedures& job_lifetime)> build;
+        };
+        Pipelines pipes = {};
+        std::vector<PipelineJob> jobs;
+
         /// Assemble the 'default' gradient drawing compute pipeline
-        vk_types::Pipeline grid_pipeline = {};
-        {
-            VkShaderModule gradient_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/gradient.glsl.comp.spv", lifetime);
-            VkPushConstantRange grid_pc_range = push_constant_range<GridPassPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
-            VkPipelineLayout gradient_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.grid, grid_pc_range, lifetime);
-            grid_pipeline = vk_pipeline::init_compute_pipeline(context.device, gradient_pipeline_layout, gradient_shader, lifetime);
+        if (!render_settings.fused_compose) {
+            jobs.push_back({ "grid pipeline", &pipes.grid, [&](vk_types::CleanupProcedures& job_lifetime) {
+                return build_grid_pipeline(context, descriptor_layouts, settings.shader_directory, settings.workgroup_sizes.grid, pipeline_cache, job_lifetime);
+            }});
         }
 
         /// Assemble the pipeline to compose all of the images into the final image
-        vk_types::Pipeline compose_pipeline = {};
-        {
-            VkShaderModule compose_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/compose.glsl.comp.spv", lifetime);
-            VkPushConstantRange compose_pc_range = push_constant_range<ComposePassPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
-            VkPipelineLayout compose_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.compose, compose_pc_range, lifetime);
-            compose_pipeline = vk_pipeline::init_compute_pipeline(context.device, compose_pipeline_layout, compose_shader, lifetime);
+        if (!render_settings.classified_compose) {
+            jobs.push_back({ "compose pipeline", &pipes.compose, [&](vk_types::CleanupProcedures& job_lifetime) {
+                return build_compose_pipeline(context, descriptor_layouts, settings.shader_directory, render_settings.fused_compose, jar_mask_source(render_settings), compose_encoding(render_settings), settings.workgroup_sizes.compose, pipeline_cache, job_lifetime);
+            }});
+        }
+        /// Or the classifier plus a compose specialized to each class of tile. The classifier reads the mask the same way its compose shader does
+        else {
+            jobs.push_back({ "compose classify pipeline", &pipes.compose_classify, [&](vk_types::CleanupProcedures& job_lifetime) {
+                const uint32_t fetch_mask = render_settings.fused_compose ? VK_TRUE : VK_FALSE;
+                return build_compose_tile_pipeline(context, descriptor_layouts, settings.shader_directory, shaders::compose_classify_comp, fetch_mask, jar_mask_source(render_settings), COMPOSE_ENCODE_LINEAR, pipeline_cache, job_lifetime);
+            }});
+            for (uint32_t tile_class = 0; tile_class < COMPOSE_TILE_CLASS_COUNT; ++tile_class) {
+                jobs.push_back({ COMPOSE_TILE_CLASS_PIPELINE_NAMES[tile_class], &pipes.compose_tiles[tile_class], [&, tile_class](vk_types::CleanupProcedures& job_lifetime) {
+                    const shaders::EmbeddedShader& shader = render_settings.fused_compose ? shaders::compose_fused_comp : shaders::compose_comp;
+                    return build_compose_tile_pipeline(context, descriptor_layouts, settings.shader_directory, shader, tile_class, jar_mask_source(render_settings), compose_encoding(render_settings), pipeline_cache, job_lifetime);
+                }});
+            }
         }
 
         /// Assemble the graphics pipeline
-        vk_types::Pipeline space_pipeline = {};
-        {
-            VkShaderModule vert_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/colored_triangle.glsl.vert.spv", lifetime);
-            VkShaderModule frag_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/colored_triangle.glsl.frag.spv", lifetime);
-            VkPushConstantRange graphics_pc_range = push_constant_range<SpacePassPushConstants>(VK_SHADER_STAGE_FRAGMENT_BIT);
-            VkPipelineLayout graphics_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.graphics, graphics_pc_range, lifetime);
-            vk_pipeline::GraphicsPipelineBuilder standard_render_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, graphics_pipeline_layout, vert_shader, frag_shader, render_targets.space.image_format, render_targets.space_depth.image_format, lifetime);
-            space_pipeline = standard_render_pipeline_builder.build();
+        if (!render_settings.visibility_buffer) {
+            jobs.push_back({ "space pipeline", &pipes.space, [&](vk_types::CleanupProcedures& job_lifetime) {
+                const shaders::EmbeddedShader& vert_code = render_settings.vertex_pulling ? shaders::colored_triangle_pulled_vert : shaders::colored_triangle_vert;
+                return build_space_pipeline(context, descriptor_layouts, render_targets, render_settings, settings.shader_directory, vert_code, render_settings.vertex_pulling, pipeline_cache, job_lifetime);
+            }});
+        }
+
+        /// Assemble the depth pre-pass pipeline, matching the space pipeline's geometry and layout
+        if (render_settings.depth_prepass) {
+            jobs.push_back({ "depth prepass pipeline", &pipes.depth_prepass, [&](vk_types::CleanupProcedures& job_lifetime) {
+                const shaders::EmbeddedShader& vert_code = render_settings.vertex_pulling ? shaders::depth_prepass_pulled_vert : shaders::depth_prepass_vert;
+                return build_depth_prepass_pipeline(context, descriptor_layouts, render_targets, render_settings, settings.shader_directory, vert_code, render_settings.vertex_pulling, pipeline_cache, job_lifetime);
+            }});
+        }
+
+        /// Assemble the instanced variants, which only differ from the pipelines above in where the vertex shader gets its model matrix
+        if (render_settings.instancing) {
+            jobs.push_back({ "space instanced pipeline", &pipes.space_instanced, [&](vk_types::CleanupProcedures& job_lifetime) {
+                return build_space_pipeline(context, descriptor_layouts, render_targets, render_settings, settings.shader_directory, shaders::colored_triangle_instanced_vert, true, pipeline_cache, job_lifetime);
+            }});
+            if (render_settings.depth_prepass) {
+                jobs.push_back({ "depth prepass instanced pipeline", &pipes.depth_prepass_instanced, [&](vk_types::CleanupProcedures& job_lifetime) {
+                    return build_depth_prepass_pipeline(context, descriptor_layouts, render_targets, render_settings, settings.shader_directory, shaders::depth_prepass_instanced_vert, true, pipeline_cache, job_lifetime);
+                }});
+            }
+        }
+
+        /// Assemble the visibility buffer pipelines. The geometry pass reuses the pre-pass vertex shader since it needs the same position and uv
+        if (render_settings.visibility_buffer) {
+            jobs.push_back({ "visibility pipeline", &pipes.visibility, [&](vk_types::CleanupProcedures& job_lifetime) {
+                const shaders::EmbeddedShader& vert_code = render_settings.vertex_pulling ? shaders::depth_prepass_pulled_vert : shaders::depth_prepass_vert;
+                VkShaderModule vert_shader = vk_pipeline::init_shader_module(context.device, vert_code, settings.shader_directory, job_lifetime);
+                VkShaderModule frag_shader = vk_pipeline::init_shader_module(context.device, shaders::visibility_frag, settings.shader_directory, job_lifetime);
+                std::vector<VkPushConstantRange> visibility_pc_ranges = space_push_constant_ranges<VisibilityPassPushConstants>(render_settings.vertex_pulling);
+                VkPipelineLayout visibility_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.graphics, visibility_pc_ranges, job_lifetime);
+                vk_pipeline::GraphicsPipelineBuilder visibility_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, visibility_pipeline_layout, vert_shader, frag_shader, render_targets.visibility.image_format, render_targets.space_depth.image_format, job_lifetime);
+                if (render_settings.vertex_pulling) {
+                    visibility_pipeline_builder.pull_vertices();
+                }
+                // Pixels left without an ID outside the jar are skipped by the shading pass as well
+                if (render_settings.stencil_jar_mask) {
+                    visibility_pipeline_builder.test_stencil(JAR_STENCIL_TEST);
+                }
+                return visibility_pipeline_builder.build(pipeline_cache);
+            }});
+
+            // Shades the same pixels compose reads, so it shares compose's workgroup size rather than being tuned on its own
+            jobs.push_back({ "visibility shade pipeline", &pipes.visibility_shade, [&](vk_types::CleanupProcedures& job_lifetime) {
+                VkShaderModule shade_shader = vk_pipeline::init_shader_module(context.device, shaders::visibility_shade_comp, settings.shader_directory, job_lifetime);
+                VkPushConstantRange shade_pc_range = push_constant_range<VisibilityShadePushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
+                VkPipelineLayout shade_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.visibility_shade, shade_pc_range, job_lifetime);
+                return vk_pipeline::init_compute_pipeline(context.device, shade_pipeline_layout, shade_shader, settings.workgroup_sizes.compose, pipeline_cache);
+            }});
+        }
+
+        /// Assemble the light culling pipeline. A workgroup covers exactly one tile, so its size isn't up for tuning
+        if (render_settings.tiled_lights) {
+            jobs.push_back({ "light culling pipeline", &pipes.light_culling, [&](vk_types::CleanupProcedures& job_lifetime) {
+                VkShaderModule culling_shader = vk_pipeline::init_shader_module(context.device, shaders::light_culling_comp, settings.shader_directory, job_lifetime);
+                VkPushConstantRange culling_pc_range = push_constant_range<LightCullingPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
+                VkPipelineLayout culling_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.light_culling, culling_pc_range, job_lifetime);
+                return vk_pipeline::init_compute_pipeline(context.device, culling_pipeline_layout, culling_shader, LIGHT_TILE_EXTENT, pipeline_cache);
+            }});
+        }
+
+        /// Assemble the occlusion culling pipelines. Level 0 of the pyramid reads the jar mask the same way compose does
+        if (render_settings.occlusion_culling) {
+            jobs.push_back({ "depth pyramid pipeline", &pipes.depth_pyramid, [&](vk_types::CleanupProcedures& job_lifetime) {
+                VkShaderModule pyramid_shader = vk_pipeline::init_shader_module(context.device, shaders::depth_pyramid_comp, settings.shader_directory, job_lifetime);
+                VkPushConstantRange pyramid_pc_range = push_constant_range<DepthPyramidPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
+                VkPipelineLayout pyramid_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.occlusion_culling, pyramid_pc_range, job_lifetime);
+                const uint32_t fetch_mask = render_settings.fused_compose ? VK_TRUE : VK_FALSE;
+                const std::array<uint32_t, 2> constants = { fetch_mask, jar_mask_source(render_settings) };
+                return vk_pipeline::init_compute_pipeline(context.device, pyramid_pipeline_layout, pyramid_shader, DEPTH_PYRAMID_WORKGROUP_EXTENT, pipeline_cache, constants);
+            }});
+            for (uint32_t phase : { OCCLUSION_PHASE_EARLY, OCCLUSION_PHASE_LATE }) {
+                jobs.push_back({ OCCLUSION_CULL_PIPELINE_NAMES[phase], &pipes.occlusion_cull[phase], [&, phase](vk_types::CleanupProcedures& job_lifetime) {
+                    VkShaderModule cull_shader = vk_pipeline::init_shader_module(context.device, shaders::occlusion_cull_comp, settings.shader_directory, job_lifetime);
+                    VkPushConstantRange cull_pc_range = push_constant_range<OcclusionCullPushConstants>(VK_SHADER_STAGE_COMPUTE_BIT);
+                    VkPipelineLayout cull_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.occlusion_culling, cull_pc_range, job_lifetime);
+                    const std::array<uint32_t, 1> constants = { phase };
+                    return vk_pipeline::init_compute_pipeline(context.device, cull_pipeline_layout, cull_shader, OCCLUSION_CULL_WORKGROUP_EXTENT, pipeline_cache, constants);
+                }});
+            }
         }
 
         /// Assemble the skybox pipeline
-        vk_types::Pipeline skybox_pipeline = {};
-        {
-            VkShaderModule skybox_vert_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/skybox.glsl.vert.spv", lifetime);
-            VkShaderModule skybox_frag_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/skybox.glsl.frag.spv", lifetime);
+        jobs.push_back({ "skybox pipeline", &pipes.skybox, [&](vk_types::CleanupProcedures& job_lifetime) {
+            VkShaderModule skybox_vert_shader = vk_pipeline::init_shader_module(context.device, shaders::skybox_vert, settings.shader_directory, job_lifetime);
+            VkShaderModule skybox_frag_shader = vk_pipeline::init_shader_module(context.device, shaders::skybox_frag, settings.shader_directory, job_lifetime);
             VkPushConstantRange skybox_pc_range = push_constant_range<SkyboxPassPushConstants>(VK_SHADER_STAGE_FRAGMENT_BIT);
-            VkPipelineLayout skybox_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.skybox, skybox_pc_range, lifetime);
-            vk_pipeline::GraphicsPipelineBuilder skybox_render_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, skybox_pipeline_layout, skybox_vert_shader, skybox_frag_shader, render_targets.space.image_format, VK_FORMAT_UNDEFINED, lifetime);
-            // Set up rasterization the same, but so that the inside of the geometry is drawn
+            VkPipelineLayout skybox_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.skybox, skybox_pc_range, job_lifetime);
+            vk_pipeline::GraphicsPipelineBuilder skybox_render_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, skybox_pipeline_layout, skybox_vert_shader, skybox_frag_shader, render_targets.space.image_format, render_targets.space_depth.image_format, job_lifetime);
+            // The fullscreen triangle comes from the vertex index alone, so there's nothing to bind
+            VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+            vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertex_input_info.pNext = nullptr;
+            vertex_input_info.vertexBindingDescriptionCount = 0;
+            vertex_input_info.vertexAttributeDescriptionCount = 0;
+            skybox_render_pipeline_builder.override(vertex_input_info);
+            // Winding doesn't matter for a single screen covering triangle
             VkPipelineRasterizationStateCreateInfo rasterization_info = {};
             rasterization_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
             rasterization_info.pNext = nullptr;
             rasterization_info.polygonMode = VK_POLYGON_MODE_FILL;
             rasterization_info.lineWidth = 1.0f;
-            rasterization_info.cullMode = VK_CULL_MODE_FRONT_BIT;
+            rasterization_info.cullMode = VK_CULL_MODE_NONE;
             rasterization_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
             skybox_render_pipeline_builder.override(rasterization_info);
-            // Disable depth testing
+            // The triangle sits on the far plane, which only passes where the depth buffer still holds its clear value.
+            // Covered pixels fail the test before the fragment shader runs, so the cubemap is only sampled for the visible sky
             VkPipelineDepthStencilStateCreateInfo depth_info = {};
             depth_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
             depth_info.pNext = nullptr;
-            depth_info.depthTestEnable = VK_FALSE;
+            depth_info.depthTestEnable = VK_TRUE;
             depth_info.depthWriteEnable = VK_FALSE;
-            depth_info.depthCompareOp = VK_COMPARE_OP_LESS;
+            depth_info.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
             depth_info.depthBoundsTestEnable = VK_FALSE;
             depth_info.stencilTestEnable = VK_FALSE;
             depth_info.front = {};
@@ -431,77 +856,262 @@ namespace vk_layer {
             depth_info.minDepthBounds = 0.0f;
             depth_info.maxDepthBounds = 1.0f;
             skybox_render_pipeline_builder.override(depth_info);
-            skybox_pipeline = skybox_render_pipeline_builder.build();
+            if (render_settings.stencil_jar_mask) {
+                skybox_render_pipeline_builder.test_stencil(JAR_STENCIL_TEST);
+            }
+            return skybox_render_pipeline_builder.build(pipeline_cache);
+        }});
+
+        /// Assemble the jar stencil pipeline. Every inner surface fragment marks the stencil, with nothing written to color or depth
+        if (render_settings.stencil_jar_mask) {
+            jobs.push_back({ "jar stencil pipeline", &pipes.jar_stencil, [&](vk_types::CleanupProcedures& job_lifetime) {
+                VkShaderModule vert_shader = vk_pipeline::init_shader_module(context.device, shaders::jar_cutaway_mask_vert, settings.shader_directory, job_lifetime);
+                VkShaderModule frag_shader = vk_pipeline::init_shader_module(context.device, shaders::jar_stencil_frag, settings.shader_directory, job_lifetime);
+                VkPipelineLayout jar_stencil_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.jar_cutaway_mask, job_lifetime);
+                vk_pipeline::GraphicsPipelineBuilder jar_stencil_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, jar_stencil_pipeline_layout, vert_shader, frag_shader, VK_FORMAT_UNDEFINED, render_targets.space_depth.image_format, job_lifetime);
+                // The fragment shader tells inner from outer surfaces, so both faces have to reach it
+                VkPipelineRasterizationStateCreateInfo rasterization_info = {};
+                rasterization_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterization_info.pNext = nullptr;
+                rasterization_info.polygonMode = VK_POLYGON_MODE_FILL;
+                rasterization_info.lineWidth = 1.0f;
+                rasterization_info.cullMode = VK_CULL_MODE_NONE;
+                rasterization_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+                jar_stencil_pipeline_builder.override(rasterization_info);
+                // Depth is left for the space scene, the jar only shows through the stencil
+                VkPipelineDepthStencilStateCreateInfo depth_info = {};
+                depth_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depth_info.pNext = nullptr;
+                depth_info.depthTestEnable = VK_FALSE;
+                depth_info.depthWriteEnable = VK_FALSE;
+                depth_info.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+                depth_info.depthBoundsTestEnable = VK_FALSE;
+                depth_info.minDepthBounds = 0.0f;
+                depth_info.maxDepthBounds = 1.0f;
+                jar_stencil_pipeline_builder.override(depth_info);
+                jar_stencil_pipeline_builder.test_stencil(JAR_STENCIL_WRITE);
+                return jar_stencil_pipeline_builder.build(pipeline_cache);
+            }});
         }
 
-        /// Assemble the jar cutaway mask pipeline
-        vk_types::Pipeline jar_cutaway_mask_pipeline = {};
-        {
-            VkShaderModule jar_cutaway_mask_vert_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/jar_cutaway_mask.glsl.vert.spv", lifetime);
-            VkShaderModule jar_cutaway_mask_frag_shader = vk_pipeline::init_shader_module(context.device, "../../../src/shaders/jar_cutaway_mask.glsl.frag.spv", lifetime);
-            VkPipelineLayout jar_cutaway_mask_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.jar_cutaway_mask, lifetime);
-            vk_pipeline::GraphicsPipelineBuilder jar_cutaway_mask_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, jar_cutaway_mask_pipeline_layout, jar_cutaway_mask_vert_shader, jar_cutaway_mask_frag_shader, render_targets.jar_mask.image_format, render_targets.jar_mask_depth.image_format, lifetime);
-            // Set up rasterization so that both the inward and outward faces generate fragments
-            VkPipelineRasterizationStateCreateInfo rasterization_info = {};
-            rasterization_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-            rasterization_info.pNext = nullptr;
-            rasterization_info.polygonMode = VK_POLYGON_MODE_FILL;
-            rasterization_info.lineWidth = 1.0f;
-            rasterization_info.cullMode = VK_CULL_MODE_NONE;
-            rasterization_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-            jar_cutaway_mask_pipeline_builder.override(rasterization_info);
-            // Disable depth testing, but enable depth write. Surface depth will be referenced later on in compositing.
-            VkPipelineDepthStencilStateCreateInfo depth_info = {};
-            depth_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-            depth_info.pNext = nullptr;
-            depth_info.depthTestEnable = VK_FALSE;
-            depth_info.depthWriteEnable = VK_TRUE;
-            depth_info.depthCompareOp = VK_COMPARE_OP_LESS;
-            depth_info.depthBoundsTestEnable = VK_FALSE;
-            depth_info.stencilTestEnable = VK_FALSE;
-            depth_info.front = {};
-            depth_info.back = {};
-            depth_info.minDepthBounds = 0.0f;
-            depth_info.maxDepthBounds = 1.0f;
-            jar_cutaway_mask_pipeline_builder.override(depth_info);
-            // Unconditional blending is desired. Can't just discard the outward fragments because those are needed to generate the depth
-            VkPipelineColorBlendAttachmentState color_blend_attachment{};
-            color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-            color_blend_attachment.blendEnable = VK_TRUE;
-            color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-            color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
-            color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
-            color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-            color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-            color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
-            VkPipelineColorBlendStateCreateInfo color_blend_info = {};
-            color_blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-            color_blend_info.pNext = nullptr;
-            color_blend_info.logicOpEnable = VK_FALSE;
-            color_blend_info.logicOp = VK_LOGIC_OP_COPY;
-            color_blend_info.attachmentCount = 1;
-            color_blend_info.pAttachments = &color_blend_attachment;
-            jar_cutaway_mask_pipeline_builder.override(color_blend_info);
-            jar_cutaway_mask_pipeline = jar_cutaway_mask_pipeline_builder.build();
+        /// Assemble the jar cutaway mask pipeline. With the stencil it only draws the feathered mask, which has no depth target
+        if (!render_settings.stencil_jar_mask || render_settings.feathered_jar_mask) {
+            jobs.push_back({ "jar cutaway mask pipeline", &pipes.jar_cutaway_mask, [&](vk_types::CleanupProcedures& job_lifetime) {
+                VkShaderModule jar_cutaway_mask_vert_shader = vk_pipeline::init_shader_module(context.device, shaders::jar_cutaway_mask_vert, settings.shader_directory, job_lifetime);
+                VkShaderModule jar_cutaway_mask_frag_shader = vk_pipeline::init_shader_module(context.device, shaders::jar_cutaway_mask_frag, settings.shader_directory, job_lifetime);
+                VkPipelineLayout jar_cutaway_mask_pipeline_layout = vk_pipeline::init_pipeline_layout(context.device, descriptor_layouts.jar_cutaway_mask, job_lifetime);
+                vk_pipeline::GraphicsPipelineBuilder jar_cutaway_mask_pipeline_builder = vk_pipeline::GraphicsPipelineBuilder(context.device, jar_cutaway_mask_pipeline_layout, jar_cutaway_mask_vert_shader, jar_cutaway_mask_frag_shader, render_targets.jar_mask.image_format, render_targets.jar_mask_depth.image_format, job_lifetime);
+                // Set up rasterization so that both the inward and outward faces generate fragments
+                VkPipelineRasterizationStateCreateInfo rasterization_info = {};
+                rasterization_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterization_info.pNext = nullptr;
+                rasterization_info.polygonMode = VK_POLYGON_MODE_FILL;
+                rasterization_info.lineWidth = 1.0f;
+                rasterization_info.cullMode = VK_CULL_MODE_NONE;
+                rasterization_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+                jar_cutaway_mask_pipeline_builder.override(rasterization_info);
+                // Disable depth testing, but enable depth write. Surface depth will be referenced later on in compositing.
+                VkPipelineDepthStencilStateCreateInfo depth_info = {};
+                depth_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depth_info.pNext = nullptr;
+                depth_info.depthTestEnable = VK_FALSE;
+                depth_info.depthWriteEnable = VK_TRUE;
+                depth_info.depthCompareOp = VK_COMPARE_OP_LESS;
+                depth_info.depthBoundsTestEnable = VK_FALSE;
+                depth_info.stencilTestEnable = VK_FALSE;
+                depth_info.front = {};
+                depth_info.back = {};
+                depth_info.minDepthBounds = 0.0f;
+                depth_info.maxDepthBounds = 1.0f;
+                jar_cutaway_mask_pipeline_builder.override(depth_info);
+                // Unconditional blending is desired. Can't just discard the outward fragments because those are needed to generate the depth
+                VkPipelineColorBlendAttachmentState color_blend_attachment{};
+                color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+                color_blend_attachment.blendEnable = VK_TRUE;
+                color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+                color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+                VkPipelineColorBlendStateCreateInfo color_blend_info = {};
+                color_blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                color_blend_info.pNext = nullptr;
+                color_blend_info.logicOpEnable = VK_FALSE;
+                color_blend_info.logicOp = VK_LOGIC_OP_COPY;
+                color_blend_info.attachmentCount = 1;
+                color_blend_info.pAttachments = &color_blend_attachment;
+                jar_cutaway_mask_pipeline_builder.override(color_blend_info);
+                return jar_cutaway_mask_pipeline_builder.build(pipeline_cache);
+            }});
         }
 
-        Pipelines pipes =  Pipelines {
-            .jar_cutaway_mask = jar_cutaway_mask_pipeline,
-            .grid = grid_pipeline,
-            .space = space_pipeline,
-            .skybox = skybox_pipeline,
-            .compose = compose_pipeline
-        };
+        // Shader modules and layouts live in a lifetime per job because CleanupProcedures isn't thread safe. They're handed over in job order once everything has joined
+        std::vector<vk_types::CleanupProcedures> job_lifetimes(jobs.size());
+        job_pool::run(jobs.size(), settings.thread_count, "pipeline worker", [&](const size_t job_index) {
+            TRACE_ZONE(jobs[job_index].name);
+            *jobs[job_index].output = jobs[job_index].build(job_lifetimes[job_index]);
+        });
+        for (auto& job_lifetime : job_lifetimes) {
+            lifetime.add([job_lifetime]() mutable {
+                job_lifetime.cleanup();
+            });
+        }
 
         return pipes;
     }
 
+    workgroup_tuning::WorkgroupSizes autotune_workgroup_sizes(vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, const RenderTargets& render_targets, vk_pipeline_cache::PipelineCache& pipeline_cache, const RenderSettings& render_settings, const PipelineSettings& settings, vk_types::CleanupProcedures& lifetime) {
+        TRACE_ZONE("autotune workgroup sizes");
+        workgroup_tuning::WorkgroupSizes sizes = settings.workgroup_sizes;
+
+        VkPhysicalDeviceProperties props = {};
+        vkGetPhysicalDeviceProperties(context.gpu, &props);
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, queue_families.data());
+        uint32_t valid_bits = queue_families[context.queues.graphics_family_index].timestampValidBits;
+        if (valid_bits == 0) {
+            printf("Graphics queue does not support timestamps, keeping the current workgroup sizes\n");
+            return sizes;
+        }
+        uint64_t timestamp_mask = (valid_bits >= 64) ? ~0ULL : ((1ULL << valid_bits) - 1);
+        double timestamp_period_ns = static_cast<double>(props.limits.timestampPeriod);
+
+        std::vector<VkExtent2D> candidates;
+        for (const VkExtent2D& candidate : workgroup_tuning::CANDIDATES) {
+            if (workgroup_tuning::fits_device_limits(context.gpu, candidate)) {
+                candidates.push_back(candidate);
+            }
+        }
+        if (candidates.empty()) {
+            printf("No workgroup size candidate fits this device, keeping the current workgroup sizes\n");
+            return sizes;
+        }
+
+        // Built through the cache like any other pipeline, which also warms the driver cache for the winners.
+        // A fused compose has no grid pass to tune, the grid size is left as it was
+        const bool time_grid = !render_settings.fused_compose;
+        std::vector<vk_types::Pipeline> grid_pipelines;
+        std::vector<vk_types::Pipeline> compose_pipelines;
+        for (const VkExtent2D& candidate : candidates) {
+            if (time_grid) {
+                grid_pipelines.push_back(build_grid_pipeline(context, descriptor_layouts, settings.shader_directory, candidate, pipeline_cache, lifetime));
+            }
+            compose_pipelines.push_back(build_compose_pipeline(context, descriptor_layouts, settings.shader_directory, render_settings.fused_compose, jar_mask_source(render_settings), compose_encoding(render_settings), candidate, pipeline_cache, lifetime));
+        }
+
+        // Begin and end timestamps per candidate, grid candidates first when there are any. Every query in the pool has to be written,
+        // or reading them back waits forever
+        const uint32_t compose_first_query = time_grid ? static_cast<uint32_t>(candidates.size() * 2) : 0;
+        const uint32_t query_count = compose_first_query + static_cast<uint32_t>(candidates.size() * 2);
+        VkQueryPoolCreateInfo query_pool_info = {};
+        query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_pool_info.pNext = nullptr;
+        query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_pool_info.queryCount = query_count;
+        VkQueryPool query_pool = VK_NULL_HANDLE;
+        if (vkCreateQueryPool(context.device, &query_pool_info, nullptr, &query_pool) != VK_SUCCESS) {
+            printf("Unable to create timestamp query pool for workgroup autotuning\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Enough back to back dispatches that a single one's launch overhead doesn't decide the result
+        constexpr uint32_t DISPATCHES_PER_CANDIDATE = 16;
+        auto time_candidates = [&](const VkCommandBuffer cmd, const std::vector<vk_types::Pipeline>& pipelines, const vk_types::AllocatedImage& target, const uint32_t first_query, const void* push_constants, const uint32_t push_constants_size) {
+            for (size_t index = 0; index < pipelines.size(); ++index) {
+                const vk_types::Pipeline& pipeline = pipelines[index];
+                vkCmdBindPipeline(cmd, pipeline.bind_point, pipeline.handle);
+                vkCmdBindDescriptorSets(cmd, pipeline.bind_point, pipeline.layout, 0, 1, &context.mega_descriptor_set.bundle.set, 0, nullptr);
+                vkCmdPushConstants(cmd, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, push_constants_size, push_constants);
+                uint32_t query = first_query + static_cast<uint32_t>(index * 2);
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, query);
+                for (uint32_t dispatch = 0; dispatch < DISPATCHES_PER_CANDIDATE; ++dispatch) {
+                    vkCmdDispatch(cmd,
+                                  dispatch_count(target.image_extent.width, pipeline.workgroup_size.width),
+                                  dispatch_count(target.image_extent.height, pipeline.workgroup_size.height),
+                                  1);
+                    // Keep dispatches from overlapping, the same as a frame would see them
+                    sync::transition_image(cmd, target.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+                }
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, query + 1);
+            }
+        };
+
+        // Candidates are timed over the full size targets, the most any frame can render
+        GridPassPushConstants grid_constants = make_grid_push_constants(render_targets, render_targets.compose_storage.image_extent);
+        ComposePassPushConstants compose_constants = make_compose_push_constants(render_targets, render_targets.compose_storage.image_extent);
+        // The first round warms up clocks and caches, only the second is kept
+        for (int round = 0; round < 2; ++round) {
+            immediate_submit(context, [&](VkCommandBuffer cmd) {
+                vkCmdResetQueryPool(cmd, query_pool, 0, query_count);
+
+                if (time_grid) {
+                    sync::transition_image(cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+                    time_candidates(cmd, grid_pipelines, render_targets.grid, 0, &grid_constants, sizeof(GridPassPushConstants));
+                    sync::transition_image(cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+                }
+
+                // Compose reads whatever the inputs hold, only the layouts have to match a real frame
+                sync::transition_image(cmd, render_targets.space.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+                transition_depth(cmd, render_targets.space_depth, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+                if (render_targets.jar_mask.image != VK_NULL_HANDLE) {
+                    sync::transition_image(cmd, render_targets.jar_mask.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+                }
+                sync::transition_image(cmd, render_targets.compose_storage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+                time_candidates(cmd, compose_pipelines, render_targets.compose_storage, compose_first_query, &compose_constants, sizeof(ComposePassPushConstants));
+            });
+        }
+
+        std::vector<uint64_t> results(query_count);
+        VkResult query_result = vkGetQueryPoolResults(context.device, query_pool, 0, query_count, results.size() * sizeof(uint64_t), results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        vkDestroyQueryPool(context.device, query_pool, nullptr);
+        if (query_result != VK_SUCCESS) {
+            printf("Unable to read back workgroup autotuning queries, result %d\n", query_result);
+            exit(EXIT_FAILURE);
+        }
+
+        auto candidate_ms = [&](const uint32_t query) {
+            uint64_t ticks = (results[query + 1] - results[query]) & timestamp_mask;
+            return static_cast<double>(ticks) * timestamp_period_ns / 1000000.0 / DISPATCHES_PER_CANDIDATE;
+        };
+        printf("Workgroup autotuning on %s, ms per dispatch\n", props.deviceName);
+        printf("  %-8s %10s %10s\n", "size", "grid", render_settings.fused_compose ? "fused" : "compose");
+        double best_grid_ms = 0.0;
+        double best_compose_ms = 0.0;
+        for (size_t index = 0; index < candidates.size(); ++index) {
+            double compose_ms = candidate_ms(compose_first_query + static_cast<uint32_t>(index * 2));
+            char size_label[16];
+            snprintf(size_label, sizeof(size_label), "%ux%u", candidates[index].width, candidates[index].height);
+            if (time_grid) {
+                double grid_ms = candidate_ms(static_cast<uint32_t>(index * 2));
+                printf("  %-8s %10.4f %10.4f\n", size_label, grid_ms, compose_ms);
+                if (index == 0 || grid_ms < best_grid_ms) {
+                    best_grid_ms = grid_ms;
+                    sizes.grid = candidates[index];
+                }
+            }
+            else {
+                printf("  %-8s %10s %10.4f\n", size_label, "-", compose_ms);
+            }
+            if (index == 0 || compose_ms < best_compose_ms) {
+                best_compose_ms = compose_ms;
+                sizes.compose = candidates[index];
+            }
+        }
+
+        return sizes;
+    }
+
     BufferedUniform<GlobalUniforms> build_global_uniforms(vk_types::Context& context, const size_t buffer_count, vk_types::CleanupProcedures& lifetime) {
 
         glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 2.0f)), 0.0f, glm::vec3(0.0f, 1.0f, 0.0f));
         view = glm::translate(view, glm::vec3(0.0f, 0.0f, 2.0f));
         
-        glm::mat4 projection = glm::transpose(glm::perspective(45.0f, 4.0f/3.0f, 1.0f, 1000.0f));
+        // Match the render targets' shape, the skybox unprojects through this same matrix
+        float aspect = static_cast<float>(context.swapchain.extent.width) / static_cast<float>(context.swapchain.extent.height);
+        glm::mat4 projection = glm::transpose(glm::perspective(45.0f, aspect, 1.0f, 1000.0f));
         projection = glm::transpose(projection);
         glm::mat4 vulkan_flip = glm::mat4(  1.0f, 0.0f, 0.0f, 0.0f,
                                             0.0f, -1.0f, 0.0f, 0.0f,
@@ -518,41 +1128,26 @@ namespace vk_layer {
         return BufferedUniform<GlobalUniforms>(context, uniform_contents, buffer_count, lifetime);
     }
 
-    BufferedUniform<SkyboxUniforms> build_skybox_uniforms(vk_types::Context& context, const size_t buffer_count, vk_types::CleanupProcedures& lifetime) {
-        glm::mat4 cam_rotation = glm::mat4(1.0f);
-
-        SkyboxUniforms uniform_contents = SkyboxUniforms {
-            cam_rotation
-        };
-
-        return BufferedUniform<SkyboxUniforms>(context, uniform_contents, buffer_count, lifetime);
-    }
-
-    RenderTargets build_render_targets(vk_types::Context& context, vk_types::CleanupProcedures& lifetime) {
+    RenderTargets build_render_targets(vk_types::Context& context, const RenderSettings& render_settings, vk_types::CleanupProcedures& lifetime) {
         
         // Build a bunch of draw targets
-        VkFormat full_color_intermediate_format = VK_FORMAT_R16G16B16A16_UNORM;
-        VkFormat jar_cutaway_target_format = VK_FORMAT_R16_UNORM;
-        VkFormat full_color_target_format = VK_FORMAT_R16G16B16A16_UNORM;
-        VkImageUsageFlags draw_intermediate_flags = 
-            VK_IMAGE_USAGE_TRANSFER_DST_BIT 
-            | VK_IMAGE_USAGE_TRANSFER_SRC_BIT 
-            | VK_IMAGE_USAGE_STORAGE_BIT 
-            | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
-            | VK_IMAGE_USAGE_SAMPLED_BIT;
+        const render_formats::TargetFormats& formats = render_settings.formats;
         VkExtent2D draw_target_extent = {
             context.swapchain.extent.width,
             context.swapchain.extent.height
         };
 
         const uint32_t NO_MIPMAP = 1;
-        vk_types::AllocatedImage compose_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, full_color_target_format, draw_intermediate_flags, NO_MIPMAP, draw_target_extent, lifetime);
-        vk_types::AllocatedImage space_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, full_color_intermediate_format, draw_intermediate_flags, NO_MIPMAP, draw_target_extent, lifetime);
-        vk_types::AllocatedImage grid_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, full_color_intermediate_format, draw_intermediate_flags, NO_MIPMAP, draw_target_extent, lifetime);
-        vk_types::AllocatedImage jar_cutaway_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, jar_cutaway_target_format, draw_intermediate_flags, NO_MIPMAP, draw_target_extent, lifetime);
+        vk_types::AllocatedImage compose_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, formats.compose, COMPOSE_TARGET_USAGE, NO_MIPMAP, draw_target_extent, lifetime);
+        vk_types::AllocatedImage space_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, formats.space, space_target_usage(render_settings), NO_MIPMAP, draw_target_extent, lifetime);
+        // The stencil jar mask only has a jar mask target when it's feathered
+        vk_types::AllocatedImage jar_cutaway_draw_target = {};
+        if (!render_settings.stencil_jar_mask || render_settings.feathered_jar_mask) {
+            jar_cutaway_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, formats.jar_mask, JAR_MASK_TARGET_USAGE, NO_MIPMAP, jar_mask_extent(render_settings, draw_target_extent), lifetime);
+        }
         
-        // Allocate depth targets as well for the draw targets that write to them
-        VkFormat depth_buffer_format = VK_FORMAT_D16_UNORM;
+        // Allocate depth targets as well for the draw targets that write to them. The space depth format is picked along with
+        // the other target formats, since the stencil jar mask needs one with stencil
         VkImageUsageFlags depth_buffer_flags = 
             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
             | VK_IMAGE_USAGE_SAMPLED_BIT
@@ -562,25 +1157,74 @@ namespace vk_layer {
             context.swapchain.extent.height
         };
 
-        vk_types::AllocatedImage space_depth_buffer = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, depth_buffer_format, depth_buffer_flags, NO_MIPMAP, depth_buffer_extent, lifetime);
-        vk_types::AllocatedImage jar_cutaway_depth_buffer = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, depth_buffer_format, depth_buffer_flags, NO_MIPMAP, depth_buffer_extent, lifetime);
+        // Its view covers stencil too when there is one, so sampling goes through views of each aspect on their own
+        vk_types::AllocatedImage space_depth_buffer = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, formats.space_depth, depth_buffer_flags, NO_MIPMAP, depth_buffer_extent, lifetime);
+        VkImageView space_depth_sampled_view = space_depth_buffer.image_view;
+        VkImageView jar_stencil_view = VK_NULL_HANDLE;
+        vk_types::AllocatedImage jar_cutaway_depth_buffer = {};
+        if (render_settings.stencil_jar_mask) {
+            space_depth_sampled_view = vk_image::init_image_view(context.device, space_depth_buffer.image, vk_image::Representation::Flat, formats.space_depth, VK_IMAGE_ASPECT_DEPTH_BIT, NO_MIPMAP, lifetime);
+            jar_stencil_view = vk_image::init_image_view(context.device, space_depth_buffer.image, vk_image::Representation::Flat, formats.space_depth, VK_IMAGE_ASPECT_STENCIL_BIT, NO_MIPMAP, lifetime);
+        }
+        else {
+            jar_cutaway_depth_buffer = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, JAR_MASK_DEPTH_FORMAT, depth_buffer_flags, NO_MIPMAP, depth_buffer_extent, lifetime);
+        }
 
         // All sampled render targets will use the same sampler
         VkSampler linear_sampler = vk_image::init_linear_sampler(context);
 
         // Register all of the render targets with descriptor handles
-        // The grid image is both stored and sampled, so handles are registered for both types and the sampler is registered separately
-        uint32_t grid_draw_target_sampled_index = context.mega_descriptor_set.register_sampled_image_descriptor(context.device, grid_draw_target.image_view);
-        uint32_t grid_draw_target_storage_index = context.mega_descriptor_set.register_storage_image_descriptor(context.device, grid_draw_target.image_view);
-        uint32_t linear_sampler_index = context.mega_descriptor_set.register_sampler_descriptor(context.device, linear_sampler);
+        // The grid image is both stored and sampled, so handles are registered for both types and the sampler is registered separately.
+        // A fused compose evaluates the grid itself, so none of it is needed
+        vk_types::AllocatedImage grid_draw_target = {};
+        uint32_t grid_draw_target_sampled_index = 0;
+        uint32_t grid_draw_target_storage_index = 0;
+        uint32_t linear_sampler_index = 0;
+        if (!render_settings.fused_compose) {
+            grid_draw_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, formats.grid, GRID_TARGET_USAGE, NO_MIPMAP, draw_target_extent, lifetime);
+            grid_draw_target_sampled_index = context.mega_descriptor_set.register_sampled_image_descriptor(context.device, grid_draw_target.image_view);
+            grid_draw_target_storage_index = context.mega_descriptor_set.register_storage_image_descriptor(context.device, grid_draw_target.image_view);
+            linear_sampler_index = context.mega_descriptor_set.register_sampler_descriptor(context.device, linear_sampler);
+        }
+        // The visibility buffer's shading pass reads IDs from its target and writes straight into the space target, both as storage images
+        vk_types::AllocatedImage visibility_target = {};
+        uint32_t visibility_target_storage_index = 0;
+        uint32_t space_draw_target_storage_index = 0;
+        if (render_settings.visibility_buffer) {
+            VkImageUsageFlags visibility_flags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+            visibility_target = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, VISIBILITY_TARGET_FORMAT, visibility_flags, NO_MIPMAP, draw_target_extent, lifetime);
+            visibility_target_storage_index = context.mega_descriptor_set.register_storage_image_descriptor(context.device, visibility_target.image_view);
+            space_draw_target_storage_index = context.mega_descriptor_set.register_storage_image_descriptor(context.device, space_draw_target.image_view);
+        }
         // The compose target is the final step so it's unnecessary to have a sampled version
         uint32_t compose_draw_target_storage_index = context.mega_descriptor_set.register_storage_image_descriptor(context.device, compose_draw_target.image_view);
+        // Direct compose writes whichever swapchain image was acquired, so each gets a handle of its own
+        std::vector<uint32_t> swapchain_storage_indices;
+        if (render_settings.direct_compose) {
+            for (VkImageView swapchain_view : context.swapchain.views) {
+                swapchain_storage_indices.push_back(context.mega_descriptor_set.register_storage_image_descriptor(context.device, swapchain_view));
+            }
+        }
+        // Any tile may end up in any class, so every class's list has room for all of them
+        vk_types::AddressedBuffer compose_tiles = {};
+        if (render_settings.classified_compose) {
+            const uint64_t tile_count = static_cast<uint64_t>(dispatch_count(draw_target_extent.width, COMPOSE_TILE_SIZE)) * dispatch_count(draw_target_extent.height, COMPOSE_TILE_SIZE);
+            const size_t tile_bytes = COMPOSE_TILE_CLASS_COUNT * (sizeof(VkDispatchIndirectCommand) + tile_count * sizeof(uint32_t));
+            compose_tiles = vk_buffer::create_addressed_buffer(context, tile_bytes, VMA_MEMORY_USAGE_GPU_ONLY, lifetime, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        }
 
         // The rest are drawn to via graphics pipelines, so a simple combined image sampler for each will do.
         uint32_t space_draw_target_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, space_draw_target.image_view, linear_sampler);
-        uint32_t space_depth_buffer_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, space_depth_buffer.image_view, linear_sampler);
-        uint32_t jar_cutaway_draw_target_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, jar_cutaway_draw_target.image_view, linear_sampler);
-        uint32_t jar_cutaway_depth_buffer_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, jar_cutaway_depth_buffer.image_view, linear_sampler);
+        uint32_t space_depth_buffer_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, space_depth_sampled_view, linear_sampler);
+        uint32_t jar_cutaway_draw_target_index = 0;
+        if (jar_cutaway_draw_target.image_view != VK_NULL_HANDLE) {
+            jar_cutaway_draw_target_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, jar_cutaway_draw_target.image_view, linear_sampler);
+        }
+        // Stencil is only ever fetched, so the linear sampler it's paired with goes unused
+        uint32_t jar_stencil_index = 0;
+        if (jar_stencil_view != VK_NULL_HANDLE) {
+            jar_stencil_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, jar_stencil_view, linear_sampler);
+        }
 
         RenderTargets target_indices = {};
         target_indices.grid_sampled_index = grid_draw_target_sampled_index;
@@ -589,18 +1233,197 @@ namespace vk_layer {
         target_indices.grid = grid_draw_target;
         target_indices.compose_storage_index = compose_draw_target_storage_index;
         target_indices.compose_storage = compose_draw_target;
+        target_indices.swapchain_storage_indices = swapchain_storage_indices;
         target_indices.space_index = space_draw_target_index;
+        target_indices.space_storage_index = space_draw_target_storage_index;
         target_indices.space = space_draw_target;
+        target_indices.visibility_storage_index = visibility_target_storage_index;
+        target_indices.visibility = visibility_target;
         target_indices.space_depth_index = space_depth_buffer_index;
         target_indices.space_depth = space_depth_buffer;
         target_indices.jar_mask_index = jar_cutaway_draw_target_index;
         target_indices.jar_mask = jar_cutaway_draw_target;
-        target_indices.jar_mask_depth_index = jar_cutaway_depth_buffer_index;
         target_indices.jar_mask_depth = jar_cutaway_depth_buffer;
+        target_indices.jar_stencil_index = jar_stencil_index;
+        target_indices.compose_tiles = compose_tiles;
         
         return target_indices;
     }
 
+    LightResources build_light_resources(vk_types::Context& context, const uint32_t light_count, const RenderTargets& render_targets, vk_types::CleanupProcedures& lifetime) {
+        LightResources resources = {};
+        resources.field = lights::generate(light_count);
+        resources.tile_count = {
+            dispatch_count(render_targets.space_depth.image_extent.width, LIGHT_TILE_SIZE),
+            dispatch_count(render_targets.space_depth.image_extent.height, LIGHT_TILE_SIZE)
+        };
+
+        // Written through the mapping every frame, so the lights sit in host visible memory rather than going through staging
+        const size_t light_bytes = resources.field.lights.size() * sizeof(lights::PointLight);
+        for (uint32_t frame = 0; frame < context.buffer_count; ++frame) {
+            resources.light_buffers.push_back(vk_buffer::create_addressed_buffer(context, light_bytes, VMA_MEMORY_USAGE_CPU_TO_GPU, lifetime));
+        }
+        const uint64_t tile_bytes = static_cast<uint64_t>(resources.tile_count.width) * resources.tile_count.height * LIGHT_TILE_BYTES;
+        resources.light_tiles = vk_buffer::create_addressed_buffer(context, tile_bytes, VMA_MEMORY_USAGE_GPU_ONLY, lifetime);
+        printf("%zu point lights culled into %ux%u tiles, %.1fMiB of tile lists\n", resources.field.lights.size(), resources.tile_count.width, resources.tile_count.height,
+            static_cast<double>(tile_bytes) / (1024.0 * 1024.0));
+        return resources;
+    }
+
+    OcclusionCulling build_occlusion_culling(vk_types::Context& context, const std::vector<Drawable>& drawables, const RenderTargets& render_targets, vk_types::CleanupProcedures& lifetime) {
+        OcclusionCulling occlusion = {};
+        std::vector<glm::vec4> bounds;
+        std::vector<VkDrawIndexedIndirectCommand> draws;
+        for (const Drawable& drawable : drawables) {
+            occlusion.first_pieces.push_back(static_cast<uint32_t>(bounds.size()));
+            const glm::mat4 model = drawable.transform.get();
+            // The sphere stays around the piece under any scale as long as its radius takes the largest one
+            const float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+            const geometry::PieceBounds& piece_bounds = drawable.gpu_model.piece_bounds;
+            for (size_t piece = 0; piece < drawable.gpu_model.vertex_buffers.size(); ++piece) {
+                const glm::vec3 center = glm::vec3(piece_bounds.center_x[piece], piece_bounds.center_y[piece], piece_bounds.center_z[piece]);
+                bounds.push_back(glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), piece_bounds.radius[piece] * scale));
+                const vk_types::GpuMeshBuffers& buffer_group = drawable.gpu_model.vertex_buffers[piece];
+                draws.push_back({ buffer_group.index_count, 1, buffer_group.first_index, buffer_group.vertex_offset, 0 });
+            }
+        }
+        // Buffers can't be empty
+        if (bounds.empty()) {
+            printf("Occlusion culling needs at least one piece to draw\n");
+            exit(EXIT_FAILURE);
+        }
+        occlusion.piece_count = static_cast<uint32_t>(bounds.size());
+        // The late phase's copies start out drawing nothing, culling fills in every instance count before they're read anyway
+        for (uint32_t piece = 0; piece < occlusion.piece_count; ++piece) {
+            VkDrawIndexedIndirectCommand late_draw = draws[piece];
+            late_draw.instanceCount = 0;
+            draws.push_back(late_draw);
+        }
+        occlusion.bounds = vk_buffer::upload_addressed_buffer(context, bounds.data(), bounds.size() * sizeof(glm::vec4), lifetime);
+        occlusion.draws = vk_buffer::upload_addressed_buffer(context, draws.data(), draws.size() * sizeof(VkDrawIndexedIndirectCommand), lifetime, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        for (uint32_t frame = 0; frame < context.buffer_count; ++frame) {
+            occlusion.counters.push_back(vk_buffer::create_addressed_buffer(context, sizeof(OcclusionCounters), VMA_MEMORY_USAGE_GPU_TO_CPU, lifetime));
+        }
+
+        // Mip levels round down where the reduction rounds up, which a power of two extent never has to
+        const VkExtent2D depth_extent = render_targets.space_depth.image_extent;
+        const VkExtent2D pyramid_extent = { std::bit_ceil(dispatch_count(depth_extent.width, 2)), std::bit_ceil(dispatch_count(depth_extent.height, 2)) };
+        const uint32_t level_count = static_cast<uint32_t>(std::bit_width(std::max(pyramid_extent.width, pyramid_extent.height)));
+        occlusion.pyramid = vk_image::init_allocated_image(context.device, context.allocator, vk_image::Representation::Flat, DEPTH_PYRAMID_FORMAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, level_count, pyramid_extent, lifetime);
+        // Only ever fetched, so the sampler goes unused
+        VkSampler pyramid_sampler = vk_image::init_linear_sampler(context, lifetime);
+        occlusion.pyramid_sampled_index = context.mega_descriptor_set.register_combined_image_sampler_descriptor(context.device, occlusion.pyramid.image_view, pyramid_sampler);
+        for (uint32_t level = 0; level < level_count; ++level) {
+            VkImageView level_view = vk_image::init_mip_view(context.device, occlusion.pyramid.image, DEPTH_PYRAMID_FORMAT, level, lifetime);
+            occlusion.pyramid_storage_indices.push_back(context.mega_descriptor_set.register_storage_image_descriptor(context.device, level_view));
+        }
+        occlusion.pyramid_levels = 0;
+        printf("Occlusion culling %u pieces against a %ux%u depth pyramid of %u levels\n", occlusion.piece_count, pyramid_extent.width, pyramid_extent.height, level_count);
+        return occlusion;
+    }
+
+    uint64_t fused_compose_bytes_saved(const VkExtent2D extent, const VkFormat grid_format) {
+        uint64_t grid_target_bytes = static_cast<uint64_t>(extent.width) * extent.height * render_formats::texel_bytes(grid_format);
+        return 2 * grid_target_bytes;
+    }
+
+    RenderSettings check_target_formats(const vk_types::Context& context, const RenderSettings& render_settings) {
+        RenderSettings checked = render_settings;
+        const render_formats::TargetFormats defaults = {};
+        auto check = [&](const char* target, VkFormat& format, const VkFormat default_format, const VkImageUsageFlags usage, const bool blended) {
+            if (!render_formats::supports_usage(context.gpu, format, usage, blended)) {
+                printf("Device can't use %s for the %s target, using %s instead\n", render_formats::format_name(format), target, render_formats::format_name(default_format));
+                format = default_format;
+            }
+        };
+        check("space", checked.formats.space, defaults.space, space_target_usage(render_settings), false);
+        if (!render_settings.fused_compose) {
+            check("grid", checked.formats.grid, defaults.grid, GRID_TARGET_USAGE, false);
+        }
+        check("compose", checked.formats.compose, defaults.compose, COMPOSE_TARGET_USAGE, false);
+        // Jars are drawn into the mask with additive blending
+        check("jar mask", checked.formats.jar_mask, defaults.jar_mask, JAR_MASK_TARGET_USAGE, true);
+        if (checked.stencil_jar_mask) {
+            checked.formats.space_depth = render_formats::find_depth_stencil_format(context.gpu);
+            if (checked.formats.space_depth == VK_FORMAT_UNDEFINED) {
+                printf("Device has no depth/stencil format for the stencil jar mask, using the jar mask target instead\n");
+                checked.stencil_jar_mask = false;
+                checked.formats.space_depth = defaults.space_depth;
+            }
+        }
+        return checked;
+    }
+
+    std::vector<render_formats::TargetTraffic> target_traffic(const RenderSettings& render_settings, const VkExtent2D extent) {
+        const uint64_t texel_count = static_cast<uint64_t>(extent.width) * extent.height;
+        auto traffic = [&](const char* target, const VkFormat format) {
+            // Written in full by the pass that draws it, then read in full by compose, or by the blit for the compose target itself
+            return render_formats::TargetTraffic{ target, format, 2 * texel_count * render_formats::texel_bytes(format) };
+        };
+        std::vector<render_formats::TargetTraffic> targets;
+        targets.push_back(traffic("space", render_settings.formats.space));
+        targets.push_back(traffic("space_depth", render_settings.formats.space_depth));
+        if (!render_settings.fused_compose) {
+            targets.push_back(traffic("grid", render_settings.formats.grid));
+        }
+        // The stencil rides along in space_depth, leaving only the quarter size feathered mask, if that
+        if (!render_settings.stencil_jar_mask) {
+            targets.push_back(traffic("jar_mask", render_settings.formats.jar_mask));
+            targets.push_back(traffic("jar_mask_depth", JAR_MASK_DEPTH_FORMAT));
+        }
+        else if (render_settings.feathered_jar_mask) {
+            render_formats::TargetTraffic feathered = traffic("jar_mask", render_settings.formats.jar_mask);
+            feathered.bytes_per_frame /= 4;
+            targets.push_back(feathered);
+        }
+        if (!render_settings.direct_compose) {
+            targets.push_back(traffic("compose", render_settings.formats.compose));
+        }
+        return targets;
+    }
+
+    bool supports_visibility_buffer(const vk_types::Context& context) {
+        VkPhysicalDeviceFeatures features = {};
+        vkGetPhysicalDeviceFeatures(context.gpu, &features);
+        return features.geometryShader == VK_TRUE;
+    }
+
+    VisibilityDrawRecords build_visibility_draw_records(vk_types::Context& context, const std::vector<Drawable>& drawables, vk_types::CleanupProcedures& lifetime) {
+        std::vector<VisibilityDrawRecord> records;
+        for (const Drawable& drawable : drawables) {
+            const geometry::GpuModel& model = drawable.gpu_model;
+            for (size_t piece = 0; piece < model.vertex_buffers.size(); ++piece) {
+                const vk_types::GpuMeshBuffers& buffer_group = model.vertex_buffers[piece];
+                if (buffer_group.index_count / 3 > VISIBILITY_MAX_TRIANGLES) {
+                    printf("A piece with %u triangles is more than the visibility buffer can address, the limit is %llu\n", buffer_group.index_count / 3, static_cast<unsigned long long>(VISIBILITY_MAX_TRIANGLES));
+                    exit(EXIT_FAILURE);
+                }
+                VisibilityDrawRecord record = {};
+                record.index_buffer_address = buffer_group.index_buffer_address;
+                record.position_buffer_address = buffer_group.position_buffer_address;
+                record.normal_buffer_address = buffer_group.normal_buffer_address;
+                record.texture_coordinate_buffer_address = buffer_group.texture_coordinate_buffer_address;
+                record.model = drawable.transform.get();
+                record.diffuse_texture_index = model.diffuse_texture_indices[piece];
+                record.specular_texture_index = model.specular_texture_indices[piece];
+                record.normal_texture_index = model.normal_texture_indices[piece];
+                records.push_back(record);
+            }
+        }
+        if (records.size() > VISIBILITY_MAX_DRAWS) {
+            printf("The scene has %zu pieces, more than the %llu the visibility buffer can address\n", records.size(), static_cast<unsigned long long>(VISIBILITY_MAX_DRAWS));
+            exit(EXIT_FAILURE);
+        }
+
+        VisibilityDrawRecords draw_records = {};
+        draw_records.draw_count = static_cast<uint32_t>(records.size());
+        // Buffers can't be empty, a scene without drawables never reads the records anyway
+        if (!records.empty()) {
+            draw_records.buffer = vk_buffer::upload_addressed_buffer(context, records.data(), records.size() * sizeof(VisibilityDrawRecord), lifetime);
+        }
+        return draw_records;
+    }
+
     Drawable make_drawable(vk_types::Context& context, const geometry::HostModel& model_data) {
         geometry::GpuModel drawable_gpu_model = geometry::upload_model(context, model_data);
         // Set up transform so the preferred coordinate system can be used from here. Build the uniform resources with it
@@ -614,16 +1437,72 @@ namespace vk_layer {
         return drawable;
     }
 
+    InstancedDrawable make_instanced_drawable(vk_types::Context& context, const geometry::HostModel& model_data, const uint32_t capacity) {
+        // Buffers can't be empty
+        if (capacity == 0) {
+            printf("An instanced drawable needs room for at least one instance\n");
+            exit(EXIT_FAILURE);
+        }
+        InstancedDrawable drawable = {};
+        drawable.gpu_model = geometry::upload_model(context, model_data);
+        drawable.basis = geometry::make_x_right_y_up_z_forward_transform(model_data.basis);
+        drawable.capacity = capacity;
+        drawable.transforms.reserve(capacity);
+        drawable.handle_slots.reserve(capacity);
+        drawable.slot_handles.reserve(capacity);
+        drawable.free_handles.reserve(capacity);
+        for (uint32_t frame = 0; frame < context.buffer_count; ++frame) {
+            drawable.transform_buffers.push_back(vk_buffer::create_addressed_buffer(context, capacity * sizeof(glm::mat4), VMA_MEMORY_USAGE_CPU_TO_GPU, context.cleanup_procedures));
+        }
+        return drawable;
+    }
+
+    uint32_t add_instance(InstancedDrawable& drawable, const glm::mat4& transform) {
+        if (drawable.transforms.size() >= drawable.capacity) {
+            printf("Instanced drawable is already full with %u instances\n", drawable.capacity);
+            exit(EXIT_FAILURE);
+        }
+        uint32_t handle = static_cast<uint32_t>(drawable.handle_slots.size());
+        if (!drawable.free_handles.empty()) {
+            handle = drawable.free_handles.back();
+            drawable.free_handles.pop_back();
+        }
+        else {
+            drawable.handle_slots.push_back(0);
+        }
+        drawable.handle_slots[handle] = static_cast<uint32_t>(drawable.transforms.size());
+        drawable.slot_handles.push_back(handle);
+        drawable.transforms.push_back(transform * drawable.basis);
+        return handle;
+    }
+
+    void set_instance(InstancedDrawable& drawable, const uint32_t handle, const glm::mat4& transform) {
+        drawable.transforms[drawable.handle_slots[handle]] = transform * drawable.basis;
+    }
+
+    void remove_instance(InstancedDrawable& drawable, const uint32_t handle) {
+        const uint32_t slot = drawable.handle_slots[handle];
+        const uint32_t last_handle = drawable.slot_handles.back();
+        drawable.transforms[slot] = drawable.transforms.back();
+        drawable.slot_handles[slot] = last_handle;
+        drawable.handle_slots[last_handle] = slot;
+        drawable.transforms.pop_back();
+        drawable.slot_handles.pop_back();
+        drawable.free_handles.push_back(handle);
+    }
+
     DrawState draw( const vk_types::Context& vk_res, 
                     const Pipelines& pipelines, 
                     const RenderTargets& render_targets,
                     const std::vector<Drawable>& drawables, 
                     const std::vector<Drawable>& masking_jars, 
-                    const Drawable& skybox, 
+                    const std::vector<InstancedDrawable>& instanced_drawables,
+                    const VisibilityDrawRecords& visibility_draw_records,
                     const uint32_t skybox_texture_index, 
                     const DrawState& state)
     {
         // Wait for previous frame to finish drawing (if applicable). Timeout 1s
+        TRACE_ZONE_BEGIN(fence_wait_zone, "fence wait");
         if (state.frame_num >= vk_res.buffer_count) {
             uint32_t wait_frame = state.frame_in_flight;
             if ((vkWaitForFences(vk_res.device, 1, &(vk_res.synchronization[wait_frame].render_fence), VK_TRUE, 1000000000)) != VK_SUCCESS) {
@@ -643,16 +1522,53 @@ namespace vk_layer {
                 exit(EXIT_FAILURE);
             }
         }
+        TRACE_ZONE_END(fence_wait_zone);
+
+        // The fence guarantees the GPU is done with this frame's uniform buffers, so now they can take the values set last frame
+        TRACE_ZONE_BEGIN(uniform_push_zone, "uniform push");
+        BufferedUniform<GlobalUniforms> frame_global_uniforms = state.main_dynamic_uniforms;
+        frame_global_uniforms.push(state.frame_in_flight);
+        TRACE_ZONE_END(uniform_push_zone);
+
+        // Likewise for this frame's point light buffer
+        if (state.render_settings.tiled_lights) {
+            TRACE_ZONE("light upload");
+            const vk_types::AllocatedBuffer& light_buffer = state.lights->light_buffers[state.frame_in_flight].buffer;
+            lights::write_frame(state.lights->field, state.frame_num, static_cast<lights::PointLight*>(light_buffer.info.pMappedData));
+        }
+        const FrameLights frame_lights = make_frame_lights(state);
+
+        // And for each instanced drawable's transforms, as they stand now
+        if (state.render_settings.instancing) {
+            TRACE_ZONE("instance upload");
+            for (const InstancedDrawable& instanced : instanced_drawables) {
+                const vk_types::AllocatedBuffer& transform_buffer = instanced.transform_buffers[state.frame_in_flight].buffer;
+                std::copy(instanced.transforms.begin(), instanced.transforms.end(), static_cast<glm::mat4*>(transform_buffer.info.pMappedData));
+            }
+        }
+
+        // And for the occlusion counters the last frame in this slot left behind
+        OcclusionCulling* occlusion = state.render_settings.occlusion_culling ? state.occlusion : nullptr;
+        if ((occlusion != nullptr) && (state.frame_num >= vk_res.buffer_count)) {
+            count_occlusion_frame(vk_res, *occlusion, state.frame_in_flight);
+        }
+
+        // Headless contexts have no swapchain, in which case the frame ends in compose_storage and nothing is presented
+        const bool presenting = vk_res.swapchain.handle != VK_NULL_HANDLE;
 
         // Request image from the swapchain, 1s timeout
         uint32_t swapchain_image_index = 0;
-        VkResult img_get_result = (vkAcquireNextImageKHR(vk_res.device, vk_res.swapchain.handle, 1000000000, vk_res.synchronization[state.buf_num].swapchain_semaphore, nullptr, &swapchain_image_index));
-        if (img_get_result != VK_SUCCESS) {
-            printf("Unable to get swapchain image for frame %d\n", state.buf_num);
-            exit(EXIT_FAILURE);
+        if (presenting) {
+            TRACE_ZONE("acquire");
+            VkResult img_get_result = (vkAcquireNextImageKHR(vk_res.device, vk_res.swapchain.handle, 1000000000, vk_res.synchronization[state.buf_num].swapchain_semaphore, nullptr, &swapchain_image_index));
+            if (img_get_result != VK_SUCCESS) {
+                printf("Unable to get swapchain image for frame %d\n", state.buf_num);
+                exit(EXIT_FAILURE);
+            }
         }
 
         /// Begin setting up command buffer and recording ///
+        TRACE_ZONE_BEGIN(record_zone, "record");
         // Rename for ergonomics
         VkCommandBuffer cmd = vk_res.command[state.buf_num].buffer_primary;
 
@@ -675,47 +1591,116 @@ namespace vk_layer {
             exit(EXIT_FAILURE);
         }
 
-        // Make the draw target drawable by compute shaders
-        sync::transition_image(cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-        auto get_grid_descriptor_sets = [&]() {
-            std::vector<VkDescriptorSet> sets = {
-                vk_res.mega_descriptor_set.bundle.set
-            };
-            return sets;
+        // Profiling is optional, these do nothing without a profiler. Passes are bracketed including their layout transitions
+        vk_profiler::GpuProfiler* profiler = state.gpu_profiler;
+        auto begin_pass_in = [&](const VkCommandBuffer pass_cmd, vk_profiler::Pass pass) {
+            if (profiler != nullptr) {
+                vk_profiler::begin_pass(*profiler, pass_cmd, state.buf_num, pass);
+            }
         };
-        auto set_grid_push_constants = [&]() {
-            GridPassPushConstants constants = {};
-            constants.grid_storage_index = render_targets.grid_storage_index;
-            vkCmdPushConstants(cmd, pipelines.grid.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GridPassPushConstants), &constants);
-        };
-        draw_compute(cmd, 
-                     get_grid_descriptor_sets,
-                     set_grid_push_constants,
-                     pipelines.grid,
-                     std::ceil(render_targets.grid.image_extent.width / 16.0),
-                     std::ceil(render_targets.grid.image_extent.height / 16.0),
-                     state);
-
-        // Draw the skybox onto the target
-        sync::transition_image(cmd, render_targets.space.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        auto get_skybox_descriptor_sets = [&](size_t piece) {
-            std::vector<VkDescriptorSet> graphics_descriptor_sets = { 
-                state.skybox_dynamic_uniforms.get_descriptor_set(state.frame_in_flight),
-                vk_res.mega_descriptor_set.bundle.set
-            };
-            return graphics_descriptor_sets;
+        auto end_pass_in = [&](const VkCommandBuffer pass_cmd, vk_profiler::Pass pass) {
+            if (profiler != nullptr) {
+                vk_profiler::end_pass(*profiler, pass_cmd, state.buf_num, pass);
+            }
         };
-        auto set_skybox_push_constants = [&](size_t piece) {
-            SkyboxPassPushConstants constants = {};
-            constants.skybox_texture_index = skybox_texture_index;
-            vkCmdPushConstants(cmd, pipelines.skybox.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SkyboxPassPushConstants), &constants);
+        auto begin_pass = [&](vk_profiler::Pass pass) {
+            begin_pass_in(cmd, pass);
         };
-        draw_background_skybox(cmd, get_skybox_descriptor_sets, set_skybox_push_constants, render_targets.space, pipelines.skybox, skybox, state);
+        auto end_pass = [&](vk_profiler::Pass pass) {
+            end_pass_in(cmd, pass);
+        };
+        if (profiler != nullptr) {
+            vk_profiler::begin_frame(*profiler, cmd, state.buf_num, state.frame_num);
+        }
+
+        // Compute work that doesn't depend on this frame's rasterization is recorded into a command buffer for the compute queue instead,
+        // and submitted as soon as it's recorded so it runs while the graphics work is recorded and drawn
+        const bool async_compute = state.render_settings.async_compute;
+        VkCommandBuffer compute_cmd = VK_NULL_HANDLE;
+        if (async_compute) {
+            compute_cmd = vk_res.compute_command[state.buf_num].buffer_primary;
+            if ((vkResetCommandBuffer(compute_cmd, 0)) != VK_SUCCESS) {
+                printf("Unable to reset compute command buffer\n");
+                exit(EXIT_FAILURE);
+            }
+            if ((vkBeginCommandBuffer(compute_cmd, &cmd_begin_info)) != VK_SUCCESS) {
+                printf("Unable to begin compute command buffer recording\n");
+                exit(EXIT_FAILURE);
+            }
+            if (profiler != nullptr) {
+                vk_profiler::begin_async_frame(*profiler, compute_cmd, state.buf_num);
+            }
+        }
+
+        // Every pass draws into the same corner of the full size targets, picked from the latest GPU frame time the profiler read back
+        VkExtent2D render_extent = render_targets.compose_storage.image_extent;
+        if (state.resolution != nullptr) {
+            if (profiler != nullptr) {
+                dynamic_resolution::update(*state.resolution, profiler->latest_frame_num, profiler->latest_frame_ms);
+            }
+            render_extent = dynamic_resolution::scaled_extent(render_extent, state.resolution->scale);
+        }
+
+        // Make the draw target drawable by compute shaders. A fused compose draws the grid itself later on
+        if (!state.render_settings.fused_compose) {
+            const VkCommandBuffer grid_cmd = async_compute ? compute_cmd : cmd;
+            begin_pass_in(grid_cmd, vk_profiler::Pass::Grid);
+            sync::transition_image(grid_cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            auto get_grid_descriptor_sets = [&]() {
+                std::vector<VkDescriptorSet> sets = {
+                    vk_res.mega_descriptor_set.bundle.set
+                };
+                return sets;
+            };
+            auto set_grid_push_constants = [&]() {
+                GridPassPushConstants constants = make_grid_push_constants(render_targets, render_extent);
+                vkCmdPushConstants(grid_cmd, pipelines.grid.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GridPassPushConstants), &constants);
+            };
+            draw_compute(grid_cmd, 
+                         get_grid_descriptor_sets,
+                         set_grid_push_constants,
+                         pipelines.grid,
+                         dispatch_count(render_extent.width, pipelines.grid.workgroup_size.width),
+                         dispatch_count(render_extent.height, pipelines.grid.workgroup_size.height),
+                         state);
+            // Hand the grid over to the graphics queue, which acquires it with the same barrier just before compose reads it
+            if (async_compute) {
+                sync::transfer_image(grid_cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, vk_res.queues.compute_family_index, vk_res.queues.graphics_family_index);
+            }
+            end_pass_in(grid_cmd, vk_profiler::Pass::Grid);
+        }
+
+        if (async_compute) {
+            if ((vkEndCommandBuffer(compute_cmd)) != VK_SUCCESS) {
+                printf("Unable to end compute command buffer recording\n");
+                exit(EXIT_FAILURE);
+            }
+            // The grid is overwritten from scratch, but not before the previous frame's compose is done reading it
+            std::vector<VkSemaphoreSubmitInfo> compute_wait_infos;
+            if (state.frame_num > 0) {
+                const uint8_t previous_buf = static_cast<uint8_t>((state.buf_num + vk_res.buffer_count - 1u) % vk_res.buffer_count);
+                compute_wait_infos.push_back(make_semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, vk_res.synchronization[previous_buf].graphics_semaphore));
+            }
+            const std::array<VkSemaphoreSubmitInfo, 1> compute_signal_infos = {
+                make_semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, vk_res.synchronization[state.buf_num].compute_semaphore)
+            };
+            VkCommandBufferSubmitInfo compute_submit_info = make_command_buffer_submit_info(compute_cmd);
+            VkSubmitInfo2 compute_submit = make_submit_info(compute_submit_info, compute_signal_infos, compute_wait_infos);
+            // No fence, the graphics submission waits on this one and its fence covers both
+            TRACE_ZONE("compute submit");
+            VkResult res = vkQueueSubmit2(vk_res.queues.compute, 1, &compute_submit, VK_NULL_HANDLE);
+            if (res != VK_SUCCESS) {
+                printf("Unable to submit compute command buffer, result %d\n", res);
+                exit(EXIT_FAILURE);
+            }
+        }
 
         // Build the jar cutaway mask
-        sync::transition_image(cmd, render_targets.jar_mask.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        for (auto& jar : masking_jars) {
-            auto get_jar_descriptor_sets = [&](size_t piece) {
+        begin_pass(vk_profiler::Pass::JarMask);
+        const bool stencil_jar_mask = state.render_settings.stencil_jar_mask;
+        const VkImageLayout space_depth_layout = depth_attachment_layout(render_targets.space_depth);
+        auto get_jar_descriptor_sets_for = [&](const Drawable& jar) {
+            return [&state, &vk_res, &jar](size_t piece) {
                 std::vector<VkDescriptorSet> jar_descriptor_sets = { 
                     state.main_dynamic_uniforms.get_descriptor_set(state.frame_in_flight),
                     vk_res.mega_descriptor_set.bundle.set,
@@ -723,14 +1708,36 @@ namespace vk_layer {
                 };
                 return jar_descriptor_sets;
             };
-            bool CLEAR_COLOR = true;
-            draw_geometry(cmd, get_jar_descriptor_sets, [](size_t piece){}, CLEAR_COLOR, render_targets.jar_mask, render_targets.jar_mask_depth, pipelines.jar_cutaway_mask, jar, state);
+        };
+        if (stencil_jar_mask) {
+            // Starts the space depth buffer's frame, the space passes only clear its depth from here on
+            transition_depth(cmd, render_targets.space_depth, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            VkClearDepthStencilValue cleared = { 1.0f, 0 };
+            VkImageSubresourceRange depth_stencil_range = vk_image::make_subresource_range(vk_image::image_aspects(render_targets.space_depth.image_format));
+            vkCmdClearDepthStencilImage(cmd, render_targets.space_depth.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &cleared, 1, &depth_stencil_range);
+            transition_depth(cmd, render_targets.space_depth, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, space_depth_layout);
+            for (const Drawable& jar : masking_jars) {
+                draw_geometry(cmd, get_jar_descriptor_sets_for(jar), [](size_t piece){}, false, false, {}, render_targets.space_depth, pipelines.jar_stencil, jar.gpu_model, vk_res.geometry, render_extent, state);
+            }
+        }
+        // The stencil only needs the mask for its feathered edge, drawn at half resolution without a depth target
+        if (!stencil_jar_mask || state.render_settings.feathered_jar_mask) {
+            const VkExtent2D mask_extent = jar_mask_extent(state.render_settings, render_extent);
+            sync::transition_image(cmd, render_targets.jar_mask.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+            for (size_t jar_index = 0; jar_index < masking_jars.size(); ++jar_index) {
+                const Drawable& jar = masking_jars[jar_index];
+                // Only the first jar clears, the rest accumulate on top of it
+                bool first_jar = (jar_index == 0);
+                draw_geometry(cmd, get_jar_descriptor_sets_for(jar), [](size_t piece){}, first_jar, first_jar && !stencil_jar_mask, render_targets.jar_mask, render_targets.jar_mask_depth, pipelines.jar_cutaway_mask, jar.gpu_model, vk_res.geometry, mask_extent, state);
+            }
+            // Final from here, and read as early as the depth pyramid
+            sync::transition_image(cmd, render_targets.jar_mask.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
         }
+        end_pass(vk_profiler::Pass::JarMask);
         
-        // Draw the space scene
-        sync::transition_image(cmd, render_targets.space.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        for (auto& drawable : drawables) {
-            auto get_graphics_descriptor_sets = [&](size_t piece) {
+        // The pre-pass, the space pass, and the visibility pass all bind the same per drawable descriptor sets
+        auto get_graphics_descriptor_sets_for = [&](const Drawable& drawable) {
+            return [&state, &vk_res, &drawable](size_t piece) {
                 std::vector<VkDescriptorSet> graphics_descriptor_sets = { 
                     state.main_dynamic_uniforms.get_descriptor_set(state.frame_in_flight),
                     vk_res.mega_descriptor_set.bundle.set,
@@ -738,124 +1745,575 @@ namespace vk_layer {
                 };
                 return graphics_descriptor_sets;
             };
-            auto set_graphics_push_constants = [&](size_t piece) {
+        };
+        // Instanced drawables take their model matrices from push constants instead, which leaves only the shared sets
+        auto get_instanced_descriptor_sets = [&](size_t piece) {
+            std::vector<VkDescriptorSet> instanced_descriptor_sets = {
+                state.main_dynamic_uniforms.get_descriptor_set(state.frame_in_flight),
+                vk_res.mega_descriptor_set.bundle.set
+            };
+            return instanced_descriptor_sets;
+        };
+        auto set_graphics_push_constants_for = [&](const geometry::GpuModel& model, const vk_types::Pipeline& pipeline) {
+            return [cmd, &model, &pipeline, &frame_lights](size_t piece) {
                 SpacePassPushConstants constants = {};
-                constants.diffuse_texture_index = drawable.gpu_model.diffuse_texture_indices[piece];
-                constants.normal_texture_index = drawable.gpu_model.normal_texture_indices[piece];
-                constants.specular_texture_index = drawable.gpu_model.specular_texture_indices[piece];
+                constants.diffuse_texture_index = model.diffuse_texture_indices[piece];
+                constants.normal_texture_index = model.normal_texture_indices[piece];
+                constants.specular_texture_index = model.specular_texture_indices[piece];
+                constants.light_tile_count_x = frame_lights.light_tile_count_x;
+                constants.lights_address = frame_lights.lights_address;
+                constants.light_tiles_address = frame_lights.light_tiles_address;
+
+                vkCmdPushConstants(cmd, pipeline.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SpacePassPushConstants), &constants);
+            };
+        };
+
+        // Bins the point lights into tiles against the depth laid down so far. Depth goes back to being an attachment afterwards
+        auto cull_lights = [&]() {
+            begin_pass(vk_profiler::Pass::LightCulling);
+            transition_depth(cmd, render_targets.space_depth, space_depth_layout, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+            auto get_culling_descriptor_sets = [&]() {
+                std::vector<VkDescriptorSet> sets = {
+                    state.main_dynamic_uniforms.get_descriptor_set(state.frame_in_flight),
+                    vk_res.mega_descriptor_set.bundle.set
+                };
+                return sets;
+            };
+            auto set_culling_push_constants = [&]() {
+                LightCullingPushConstants constants = {};
+                constants.lights_address = frame_lights.lights_address;
+                constants.light_tiles_address = frame_lights.light_tiles_address;
+                constants.light_count = frame_lights.light_count;
+                constants.light_tile_count_x = frame_lights.light_tile_count_x;
+                constants.space_depth_index = render_targets.space_depth_index;
+                constants.render_width = render_extent.width;
+                constants.render_height = render_extent.height;
+                vkCmdPushConstants(cmd, pipelines.light_culling.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LightCullingPushConstants), &constants);
+            };
+            draw_compute(cmd,
+                         get_culling_descriptor_sets,
+                         set_culling_push_constants,
+                         pipelines.light_culling,
+                         dispatch_count(render_extent.width, LIGHT_TILE_SIZE),
+                         dispatch_count(render_extent.height, LIGHT_TILE_SIZE),
+                         state);
+            transition_depth(cmd, render_targets.space_depth, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, space_depth_layout);
+            sync::memory_barrier(cmd);
+            end_pass(vk_profiler::Pass::LightCulling);
+        };
+
+        // Occlusion culling. The early phase tests against the pyramid from last frame's depth, through last frame's camera and extent so its depths line up.
+        // The late phase tests whatever that left out against the pyramid built from this frame's early draws, through this frame's camera
+        const GlobalUniforms frame_camera = frame_global_uniforms.get();
+        const glm::mat4 view_projection = frame_camera.projection * frame_camera.view;
+
+        // Pieces entirely outside the view volume don't get their draws recorded. The planes are taken into each drawable's own space, where its piece bounds are
+        std::vector<std::vector<uint8_t>> frustum_visible(drawables.size());
+        uint32_t frustum_culled_pieces = 0;
+        double frustum_cull_ms = 0.0;
+        if (state.render_settings.frustum_culling) {
+            TRACE_ZONE("frustum cull");
+            auto cull_start = std::chrono::steady_clock::now();
+            for (size_t drawable_index = 0; drawable_index < drawables.size(); ++drawable_index) {
+                const Drawable& drawable = drawables[drawable_index];
+                const frustum::Planes planes = frustum::extract_planes(view_projection * drawable.transform.get());
+                frustum_culled_pieces += frustum::cull_pieces(planes, drawable.gpu_model.piece_bounds, frustum_visible[drawable_index]);
+            }
+            frustum_cull_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cull_start).count();
+        }
+        auto get_occlusion_descriptor_sets = [&]() {
+            std::vector<VkDescriptorSet> sets = {
+                vk_res.mega_descriptor_set.bundle.set
+            };
+            return sets;
+        };
+        auto cull_pieces = [&](const uint32_t phase) {
+            const bool late = (phase == OCCLUSION_PHASE_LATE);
+            begin_pass(late ? vk_profiler::Pass::LateCull : vk_profiler::Pass::EarlyCull);
+            if (!late) {
+                vkCmdFillBuffer(cmd, occlusion->counters[state.frame_in_flight].buffer.buffer, 0, sizeof(OcclusionCounters), 0);
+                sync::memory_barrier(cmd);
+            }
+            const vk_types::Pipeline& pipeline = pipelines.occlusion_cull[phase];
+            auto set_cull_push_constants = [&]() {
+                // Before the first pyramid there's only the frustum, from this frame's camera
+                const bool has_pyramid = (occlusion->pyramid_levels > 0);
+                OcclusionCullPushConstants constants = {};
+                constants.view_projection = has_pyramid ? occlusion->pyramid_view_projection : view_projection;
+                constants.bounds_address = occlusion->bounds.address;
+                constants.draws_address = occlusion->draws.address;
+                constants.counters_address = occlusion->counters[state.frame_in_flight].address;
+                constants.piece_count = occlusion->piece_count;
+                constants.pyramid_index = occlusion->pyramid_sampled_index;
+                constants.pyramid_levels = occlusion->pyramid_levels;
+                constants.depth_width = occlusion->pyramid_extent.width;
+                constants.depth_height = occlusion->pyramid_extent.height;
+                vkCmdPushConstants(cmd, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionCullPushConstants), &constants);
+            };
+            draw_compute(cmd,
+                         get_occlusion_descriptor_sets,
+                         set_cull_push_constants,
+                         pipeline,
+                         dispatch_count(occlusion->piece_count, pipeline.workgroup_size.width),
+                         1,
+                         state);
+            // The draws read the instance counts as indirect arguments
+            sync::memory_barrier(cmd);
+            end_pass(late ? vk_profiler::Pass::LateCull : vk_profiler::Pass::EarlyCull);
+        };
+        // Reduces this frame's depth so far into the pyramid, down to a single texel. The early phase has already read last frame's,
+        // so what's there is thrown away. Each level goes to read only as soon as it's written, for the next level to read
+        auto build_depth_pyramid = [&]() {
+            begin_pass(vk_profiler::Pass::DepthPyramid);
+            transition_depth(cmd, render_targets.space_depth, space_depth_layout, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+            sync::transition_image(cmd, occlusion->pyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            const uint32_t allocated_levels = static_cast<uint32_t>(occlusion->pyramid_storage_indices.size());
+            VkExtent2D source_extent = render_extent;
+            uint32_t level = 0;
+            while (level < allocated_levels) {
+                const VkExtent2D level_extent = { dispatch_count(source_extent.width, 2), dispatch_count(source_extent.height, 2) };
+                auto set_pyramid_push_constants = [&]() {
+                    DepthPyramidPushConstants constants = {};
+                    constants.source_index = (level == 0) ? render_targets.space_depth_index : occlusion->pyramid_sampled_index;
+                    constants.source_level = (level == 0) ? 0 : level - 1;
+                    constants.source_width = source_extent.width;
+                    constants.source_height = source_extent.height;
+                    constants.destination_index = occlusion->pyramid_storage_indices[level];
+                    constants.destination_width = level_extent.width;
+                    constants.destination_height = level_extent.height;
+                    constants.from_depth = (level == 0) ? VK_TRUE : VK_FALSE;
+                    constants.jar_mask_index = render_targets.jar_mask_index;
+                    constants.jar_stencil_index = render_targets.jar_stencil_index;
+                    constants.target_width = render_targets.compose_storage.image_extent.width;
+                    constants.target_height = render_targets.compose_storage.image_extent.height;
+                    vkCmdPushConstants(cmd, pipelines.depth_pyramid.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidPushConstants), &constants);
+                };
+                draw_compute(cmd,
+                             get_occlusion_descriptor_sets,
+                             set_pyramid_push_constants,
+                             pipelines.depth_pyramid,
+                             dispatch_count(level_extent.width, pipelines.depth_pyramid.workgroup_size.width),
+                             dispatch_count(level_extent.height, pipelines.depth_pyramid.workgroup_size.height),
+                             state);
+                sync::transition_image(cmd, occlusion->pyramid.image, pyramid_level_range(level, 1), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+                source_extent = level_extent;
+                ++level;
+                if ((level_extent.width == 1) && (level_extent.height == 1)) {
+                    break;
+                }
+            }
+            // A scaled down frame doesn't reach the last levels, which still have to match the sampled view's layout
+            if (level < allocated_levels) {
+                sync::transition_image(cmd, occlusion->pyramid.image, pyramid_level_range(level, VK_REMAINING_MIP_LEVELS), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+            }
+            transition_depth(cmd, render_targets.space_depth, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, space_depth_layout);
+            occlusion->pyramid_view_projection = view_projection;
+            occlusion->pyramid_extent = render_extent;
+            occlusion->pyramid_levels = level;
+            end_pass(vk_profiler::Pass::DepthPyramid);
+        };
+        // Where a drawable's pieces inside the frustum get their draws, from the given phases' commands. Without occlusion culling they're drawn directly
+        auto culled_draws_for = [&](const size_t drawable_index, const std::vector<uint32_t>& phases) {
+            CulledDraws culled = {};
+            culled.visible_pieces = frustum_visible[drawable_index];
+            if (occlusion == nullptr) {
+                return culled;
+            }
+            culled.commands = occlusion->draws.buffer.buffer;
+            for (const uint32_t phase : phases) {
+                const uint64_t first_command = static_cast<uint64_t>(phase) * occlusion->piece_count + occlusion->first_pieces[drawable_index];
+                culled.first_offsets.push_back(first_command * sizeof(VkDrawIndexedIndirectCommand));
+            }
+            return culled;
+        };
+        // Every instanced drawable with any instances, in one draw per piece. They aren't culled, so they only go in with the early phase,
+        // where they're also in time for the pyramid. Depth has always been cleared by the main drawables ahead of them
+        auto draw_instanced = [&](const vk_types::Pipeline& pipeline) {
+            if (!state.render_settings.instancing) {
+                return;
+            }
+            for (const InstancedDrawable& instanced : instanced_drawables) {
+                if (instanced.transforms.empty()) {
+                    continue;
+                }
+                DrawInstances instances = {};
+                instances.count = static_cast<uint32_t>(instanced.transforms.size());
+                instances.transforms_address = instanced.transform_buffers[state.frame_in_flight].address;
+                draw_geometry(cmd, get_instanced_descriptor_sets, set_graphics_push_constants_for(instanced.gpu_model, pipeline), false, false, render_targets.space, render_targets.space_depth, pipeline, instanced.gpu_model, vk_res.geometry, render_extent, state, {}, instances);
+            }
+        };
+
+        // Runs a pass that lays down the space scene's depth. With occlusion culling it's culled and drawn once per phase, with the pyramid rebuilt
+        // in between. Only the early phase, which is the only one without culling, should clear anything
+        auto draw_in_phases = [&](const vk_profiler::Pass pass, const std::function<void(const uint32_t phase)>& draw_phase) {
+            if (occlusion != nullptr) {
+                cull_pieces(OCCLUSION_PHASE_EARLY);
+            }
+            begin_pass(pass);
+            draw_phase(OCCLUSION_PHASE_EARLY);
+            end_pass(pass);
+            if (occlusion == nullptr) {
+                return;
+            }
+            build_depth_pyramid();
+            cull_pieces(OCCLUSION_PHASE_LATE);
+            begin_pass(vk_profiler::Pass::LateDraw);
+            draw_phase(OCCLUSION_PHASE_LATE);
+            end_pass(vk_profiler::Pass::LateDraw);
+        };
+
+        // Color doesn't need clearing since the skybox fills in whatever the geometry leaves uncovered.
+        // Depth is shared by every drawable and the skybox after them, so it's only cleared before the first. The jar's stencil has to survive to here
+        transition_depth(cmd, render_targets.space_depth, stencil_jar_mask ? space_depth_layout : VK_IMAGE_LAYOUT_UNDEFINED, space_depth_layout);
+        bool DO_NOT_CLEAR_COLOR = false;
+        // Layout the skybox finds the space target in
+        VkImageLayout space_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        if (state.render_settings.visibility_buffer) {
+            // Rasterize IDs only. The first draw clears the target to 0, which marks pixels nothing covers. Draw IDs don't depend on the phase
+            draw_in_phases(vk_profiler::Pass::Visibility, [&](const uint32_t phase) {
+                const bool early_phase = (phase == OCCLUSION_PHASE_EARLY);
+                if (early_phase) {
+                    sync::transition_image(cmd, render_targets.visibility.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+                }
+                uint32_t first_draw_id = 0;
+                for (size_t drawable_index = 0; drawable_index < drawables.size(); ++drawable_index) {
+                    const Drawable& drawable = drawables[drawable_index];
+                    auto set_visibility_push_constants = [&](size_t piece) {
+                        VisibilityPassPushConstants constants = {};
+                        constants.diffuse_texture_index = drawable.gpu_model.diffuse_texture_indices[piece];
+                        constants.draw_id = first_draw_id + static_cast<uint32_t>(piece);
+                        vkCmdPushConstants(cmd, pipelines.visibility.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(VisibilityPassPushConstants), &constants);
+                    };
+                    bool clear = early_phase && (drawable_index == 0);
+                    draw_geometry(cmd, get_graphics_descriptor_sets_for(drawable), set_visibility_push_constants, clear, clear, render_targets.visibility, render_targets.space_depth, pipelines.visibility, drawable.gpu_model, vk_res.geometry, render_extent, state, culled_draws_for(drawable_index, { phase }));
+                    first_draw_id += static_cast<uint32_t>(drawable.gpu_model.vertex_buffers.size());
+                }
+            });
+
+            if (state.render_settings.tiled_lights) {
+                cull_lights();
+            }
+
+            // Shade every covered pixel once, straight into the space target
+            begin_pass(vk_profiler::Pass::VisibilityShade);
+            sync::transition_image(cmd, render_targets.visibility.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+            sync::transition_image(cmd, render_targets.space.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            auto get_shade_descriptor_sets = [&]() {
+                std::vector<VkDescriptorSet> sets = {
+                    state.main_dynamic_uniforms.get_descriptor_set(state.frame_in_flight),
+                    vk_res.mega_descriptor_set.bundle.set
+                };
+                return sets;
+            };
+            auto set_shade_push_constants = [&]() {
+                VisibilityShadePushConstants constants = make_visibility_shade_push_constants(render_targets, visibility_draw_records, frame_lights, render_extent);
+                vkCmdPushConstants(cmd, pipelines.visibility_shade.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VisibilityShadePushConstants), &constants);
+            };
+            draw_compute(cmd,
+                         get_shade_descriptor_sets,
+                         set_shade_push_constants,
+                         pipelines.visibility_shade,
+                         dispatch_count(render_extent.width, pipelines.visibility_shade.workgroup_size.width),
+                         dispatch_count(render_extent.height, pipelines.visibility_shade.workgroup_size.height),
+                         state);
+            end_pass(vk_profiler::Pass::VisibilityShade);
+            space_layout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+        else {
+            sync::transition_image(cmd, render_targets.space.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+            bool space_depth_cleared = false;
+
+            // Lay down the final depth of the space scene, so the space pass shades each pixel once
+            if (state.render_settings.depth_prepass) {
+                draw_in_phases(vk_profiler::Pass::DepthPrepass, [&](const uint32_t phase) {
+                    for (size_t drawable_index = 0; drawable_index < drawables.size(); ++drawable_index) {
+                        const Drawable& drawable = drawables[drawable_index];
+                        bool clear_depth = (phase == OCCLUSION_PHASE_EARLY) && (drawable_index == 0);
+                        draw_geometry(cmd, get_graphics_descriptor_sets_for(drawable), set_graphics_push_constants_for(drawable.gpu_model, pipelines.depth_prepass), DO_NOT_CLEAR_COLOR, clear_depth, render_targets.space, render_targets.space_depth, pipelines.depth_prepass, drawable.gpu_model, vk_res.geometry, render_extent, state, culled_draws_for(drawable_index, { phase }));
+                    }
+                    if (phase == OCCLUSION_PHASE_EARLY) {
+                        draw_instanced(pipelines.depth_prepass_instanced);
+                    }
+                });
+                space_depth_cleared = true;
+                transition_depth(cmd, render_targets.space_depth, space_depth_layout, space_depth_layout);
+            }
+
+            // Tiled lights always come with the pre-pass here, so depth is final by now
+            if (state.render_settings.tiled_lights) {
+                cull_lights();
+            }
 
-                vkCmdPushConstants(cmd, pipelines.space.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SpacePassPushConstants), &constants);
+            // Draw the space scene. After the pre-pass, depth is final and whatever either phase let through gets shaded in one go
+            auto draw_space = [&](const std::vector<uint32_t>& phases, const bool clear_first_depth) {
+                for (size_t drawable_index = 0; drawable_index < drawables.size(); ++drawable_index) {
+                    const Drawable& drawable = drawables[drawable_index];
+                    bool clear_depth = clear_first_depth && (drawable_index == 0);
+                    draw_geometry(cmd, get_graphics_descriptor_sets_for(drawable), set_graphics_push_constants_for(drawable.gpu_model, pipelines.space), DO_NOT_CLEAR_COLOR, clear_depth, render_targets.space, render_targets.space_depth, pipelines.space, drawable.gpu_model, vk_res.geometry, render_extent, state, culled_draws_for(drawable_index, phases));
+                }
+                if (std::find(phases.begin(), phases.end(), OCCLUSION_PHASE_EARLY) != phases.end()) {
+                    draw_instanced(pipelines.space_instanced);
+                }
             };
-            bool DO_NOT_CLEAR_COLOR = false;
-            draw_geometry(cmd, get_graphics_descriptor_sets, set_graphics_push_constants, DO_NOT_CLEAR_COLOR, render_targets.space, render_targets.space_depth, pipelines.space, drawable, state);
+            if (space_depth_cleared) {
+                begin_pass(vk_profiler::Pass::Space);
+                draw_space({ OCCLUSION_PHASE_EARLY, OCCLUSION_PHASE_LATE }, false);
+                end_pass(vk_profiler::Pass::Space);
+            }
+            else {
+                draw_in_phases(vk_profiler::Pass::Space, [&](const uint32_t phase) {
+                    draw_space({ phase }, phase == OCCLUSION_PHASE_EARLY);
+                });
+            }
+        }
+
+        // Fill in the sky behind the space scene
+        begin_pass(vk_profiler::Pass::Skybox);
+        sync::transition_image(cmd, render_targets.space.image, space_layout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        transition_depth(cmd, render_targets.space_depth, space_depth_layout, space_depth_layout);
+        auto get_skybox_descriptor_sets = [&]() {
+            std::vector<VkDescriptorSet> skybox_descriptor_sets = { 
+                state.main_dynamic_uniforms.get_descriptor_set(state.frame_in_flight),
+                vk_res.mega_descriptor_set.bundle.set
+            };
+            return skybox_descriptor_sets;
+        };
+        auto set_skybox_push_constants = [&]() {
+            SkyboxPassPushConstants constants = {};
+            constants.skybox_texture_index = skybox_texture_index;
+            vkCmdPushConstants(cmd, pipelines.skybox.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SkyboxPassPushConstants), &constants);
+        };
+        draw_skybox(cmd, get_skybox_descriptor_sets, set_skybox_push_constants, render_targets.space, render_targets.space_depth, pipelines.skybox, render_extent, state);
+        end_pass(vk_profiler::Pass::Skybox);
+
+        // With async compute the frame goes to the graphics queue in two submissions. Everything recorded so far goes first and waits on
+        // nothing, so the graphics queue's own compute passes don't stall behind the grid. Compose onwards waits on the compute queue
+        if (async_compute) {
+            if ((vkEndCommandBuffer(cmd)) != VK_SUCCESS) {
+                printf("Unable to end command buffer recording\n");
+                exit(EXIT_FAILURE);
+            }
+            VkCommandBufferSubmitInfo raster_submit_info = make_command_buffer_submit_info(cmd);
+            VkSubmitInfo2 raster_submit = make_submit_info(raster_submit_info, {}, {});
+            // No fence, the compose submission goes to the same queue after this one and its fence covers both
+            TRACE_ZONE("raster submit");
+            VkResult res = vkQueueSubmit2(vk_res.queues.graphics, 1, &raster_submit, VK_NULL_HANDLE);
+            if (res != VK_SUCCESS) {
+                printf("Unable to submit command buffer, result %d\n", res);
+                exit(EXIT_FAILURE);
+            }
+
+            cmd = vk_res.compose_command[state.buf_num].buffer_primary;
+            if ((vkResetCommandBuffer(cmd, 0)) != VK_SUCCESS) {
+                printf("Unable to reset compose command buffer\n");
+                exit(EXIT_FAILURE);
+            }
+            if ((vkBeginCommandBuffer(cmd, &cmd_begin_info)) != VK_SUCCESS) {
+                printf("Unable to begin compose command buffer recording\n");
+                exit(EXIT_FAILURE);
+            }
         }
 
         // Compose the gbuffers together
-        sync::transition_image(cmd, render_targets.compose_storage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        // Full size frames can go straight into the swapchain image. Scaled down ones still need the blit to fill it
+        const bool compose_to_swapchain = presenting && state.render_settings.direct_compose &&
+            (render_extent.width == vk_res.swapchain.extent.width) && (render_extent.height == vk_res.swapchain.extent.height);
+        const VkImage compose_image = compose_to_swapchain ? vk_res.swapchain.images[swapchain_image_index] : render_targets.compose_storage.image;
+        const uint32_t compose_index = compose_to_swapchain ? render_targets.swapchain_storage_indices[swapchain_image_index] : render_targets.compose_storage_index;
+        // Classified compose times its layout transitions along with the classifier
+        begin_pass(state.render_settings.classified_compose ? vk_profiler::Pass::ComposeClassify : vk_profiler::Pass::Compose);
+        sync::transition_image(cmd, compose_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
         sync::transition_image(cmd, render_targets.space.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
-        sync::transition_image(cmd, render_targets.space_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
-        sync::transition_image(cmd, render_targets.jar_mask.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
-        sync::transition_image(cmd, render_targets.jar_mask_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
-        sync::transition_image(cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+        transition_depth(cmd, render_targets.space_depth, space_depth_layout, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+        if (!stencil_jar_mask) {
+            transition_depth(cmd, render_targets.jar_mask_depth, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+        }
+        if (async_compute) {
+            sync::transfer_image(cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, vk_res.queues.compute_family_index, vk_res.queues.graphics_family_index);
+        }
+        else if (!state.render_settings.fused_compose) {
+            sync::transition_image(cmd, render_targets.grid.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+        }
         auto get_compose_descriptor_sets = [&]() {
             std::vector<VkDescriptorSet> sets = {
                 vk_res.mega_descriptor_set.bundle.set
             };
             return sets;
         };
-        auto set_compose_push_constants = [&]() {
-            ComposePassPushConstants constants = {};
-            constants.compose_storage_index = render_targets.compose_storage_index;
-            constants.grid_sampled_index = render_targets.grid_sampled_index;
-            constants.grid_sampler_index = render_targets.grid_sampler_index;
-            constants.jar_mask_depth_index = render_targets.jar_mask_depth_index;
-            constants.jar_mask_index = render_targets.jar_mask_index;
-            constants.space_depth_index = render_targets.space_depth_index;
-            constants.space_index = render_targets.space_index;
-            vkCmdPushConstants(cmd, pipelines.compose.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComposePassPushConstants), &constants);
+        auto set_compose_push_constants_for = [&](const vk_types::Pipeline& pipeline) {
+            return [&, pipeline]() {
+                ComposePassPushConstants constants = make_compose_push_constants(render_targets, render_extent);
+                constants.compose_storage_index = compose_index;
+                vkCmdPushConstants(cmd, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComposePassPushConstants), &constants);
+            };
         };
-        draw_compute(cmd, 
-                     get_compose_descriptor_sets,
-                     set_compose_push_constants,
-                     pipelines.compose,
-                     std::ceil(render_targets.compose_storage.image_extent.width / 16.0),
-                     std::ceil(render_targets.compose_storage.image_extent.height / 16.0),
-                     state);
+        if (!state.render_settings.classified_compose) {
+            draw_compute(cmd, 
+                         get_compose_descriptor_sets,
+                         set_compose_push_constants_for(pipelines.compose),
+                         pipelines.compose,
+                         dispatch_count(render_extent.width, pipelines.compose.workgroup_size.width),
+                         dispatch_count(render_extent.height, pipelines.compose.workgroup_size.height),
+                         state);
+        }
+        else {
+            // Every class starts the frame with an empty list, then the classifier counts tiles into the dispatch sizes
+            std::array<VkDispatchIndirectCommand, COMPOSE_TILE_CLASS_COUNT> empty_dispatches = {};
+            empty_dispatches.fill({ 0, 1, 1 });
+            vkCmdUpdateBuffer(cmd, render_targets.compose_tiles.buffer.buffer, 0, sizeof(empty_dispatches), empty_dispatches.data());
+            sync::memory_barrier(cmd);
+            draw_compute(cmd,
+                         get_compose_descriptor_sets,
+                         set_compose_push_constants_for(pipelines.compose_classify),
+                         pipelines.compose_classify,
+                         dispatch_count(render_extent.width, COMPOSE_TILE_SIZE),
+                         dispatch_count(render_extent.height, COMPOSE_TILE_SIZE),
+                         state);
+            sync::memory_barrier(cmd);
+            end_pass(vk_profiler::Pass::ComposeClassify);
+
+            // Each class only runs over its own tiles, so the cost follows how much of the jar's outline is on screen rather than the resolution
+            begin_pass(vk_profiler::Pass::Compose);
+            for (uint32_t tile_class = 0; tile_class < COMPOSE_TILE_CLASS_COUNT; ++tile_class) {
+                const vk_types::Pipeline& pipeline = pipelines.compose_tiles[tile_class];
+                draw_compute_indirect(cmd,
+                                      get_compose_descriptor_sets,
+                                      set_compose_push_constants_for(pipeline),
+                                      pipeline,
+                                      render_targets.compose_tiles.buffer.buffer,
+                                      tile_class * sizeof(VkDispatchIndirectCommand));
+            }
+        }
+        end_pass(vk_profiler::Pass::Compose);
 
-        // Transfer from the draw target to the swapchain
-        sync::transition_image(cmd, render_targets.compose_storage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-        sync::transition_image(cmd, vk_res.swapchain.images[swapchain_image_index], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        vk_image::blit_image_to_image_no_mipmap(cmd, render_targets.compose_storage.image, vk_res.swapchain.images[swapchain_image_index], render_targets.compose_storage.image_extent, vk_res.swapchain.extent);
+        // Transfer from the draw target to the swapchain, scaling the rendered corner up to fill it. Headless frames stop here with compose_storage left as a transfer source for readback
+        if (compose_to_swapchain) {
+            sync::transition_image(cmd, compose_image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        }
+        else {
+            sync::transition_image(cmd, render_targets.compose_storage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        }
+        if (presenting && !compose_to_swapchain) {
+            begin_pass(vk_profiler::Pass::Blit);
+            sync::transition_image(cmd, vk_res.swapchain.images[swapchain_image_index], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            vk_image::blit_image_to_image_no_mipmap(cmd, render_targets.compose_storage.image, vk_res.swapchain.images[swapchain_image_index], render_extent, vk_res.swapchain.extent);
+
+            // After drawing, transition the image to presentable
+            sync::transition_image(cmd, vk_res.swapchain.images[swapchain_image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            end_pass(vk_profiler::Pass::Blit);
+        }
 
-        // After drawing, transition the image to presentable
-        sync::transition_image(cmd, vk_res.swapchain.images[swapchain_image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        if (profiler != nullptr) {
+            vk_profiler::end_frame(*profiler, cmd, state.buf_num);
+        }
 
         // Finalize the command buffer, making it executable
         if ((vkEndCommandBuffer(cmd)) != VK_SUCCESS) {
             printf("Unable to end command buffer recording\n");
             exit(EXIT_FAILURE);
         }
+        TRACE_ZONE_END(record_zone);
 
         /// Prep for queue submission ///
         VkCommandBufferSubmitInfo cmd_submit_info = make_command_buffer_submit_info(cmd);
-        // Setup our semaphores.
-        // We wait on the swapchain becoming ready
-        VkSemaphoreSubmitInfo wait_semaphore_info = make_semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, vk_res.synchronization[state.buf_num].swapchain_semaphore);
-        // We signal the render semaphore when we're done drawing
-        VkSemaphoreSubmitInfo signal_semaphore_info = make_semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, vk_res.synchronization[state.buf_num].render_semaphore);
-        VkSubmitInfo2 submit_info = make_submit_info(cmd_submit_info, signal_semaphore_info, wait_semaphore_info);
+        // Setup our semaphores. Without a swapchain there's nothing to wait on or signal for presentation
+        std::vector<VkSemaphoreSubmitInfo> wait_semaphore_infos;
+        std::vector<VkSemaphoreSubmitInfo> signal_semaphore_infos;
+        if (presenting) {
+            // We wait on the swapchain becoming ready
+            wait_semaphore_infos.push_back(make_semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, vk_res.synchronization[state.buf_num].swapchain_semaphore));
+            // We signal the render semaphore when we're done drawing
+            signal_semaphore_infos.push_back(make_semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, vk_res.synchronization[state.buf_num].render_semaphore));
+        }
+        if (async_compute) {
+            // Compose is the first thing in this submission that needs the grid, and it's a compute shader.
+            // The next frame's async work waits in turn for compose to be done with the grid
+            wait_semaphore_infos.push_back(make_semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, vk_res.synchronization[state.buf_num].compute_semaphore));
+            signal_semaphore_infos.push_back(make_semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, vk_res.synchronization[state.buf_num].graphics_semaphore));
+        }
+        VkSubmitInfo2 submit_info = make_submit_info(cmd_submit_info, signal_semaphore_infos, wait_semaphore_infos);
 
         // Fire the command buffer off to the queue
+        TRACE_ZONE_BEGIN(submit_zone, "submit");
         if (auto res = (vkQueueSubmit2(vk_res.queues.graphics, 1, &submit_info, vk_res.synchronization[state.buf_num].render_fence)) != VK_SUCCESS) {
             printf("Unable to submit command buffer, result %d\n", res);
             exit(EXIT_FAILURE);
         }
+        TRACE_ZONE_END(submit_zone);
 
         /// Setup presentation ///
-        VkPresentInfoKHR present_info = {};
-        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-        present_info.pNext = nullptr;
-        present_info.pSwapchains = &vk_res.swapchain.handle;
-        present_info.swapchainCount = 1;
+        if (presenting) {
+            TRACE_ZONE("present");
+            VkPresentInfoKHR present_info = {};
+            present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            present_info.pNext = nullptr;
+            present_info.pSwapchains = &vk_res.swapchain.handle;
+            present_info.swapchainCount = 1;
 
-        present_info.pWaitSemaphores = &vk_res.synchronization[state.buf_num].render_semaphore;
-        present_info.waitSemaphoreCount = 1;
+            present_info.pWaitSemaphores = &vk_res.synchronization[state.buf_num].render_semaphore;
+            present_info.waitSemaphoreCount = 1;
 
-        present_info.pImageIndices = &swapchain_image_index;
+            present_info.pImageIndices = &swapchain_image_index;
 
-        if(vkQueuePresentKHR(vk_res.queues.graphics, &present_info) != VK_SUCCESS) {
-            printf("Unable to present image\n");
-            exit(EXIT_FAILURE);
+            if(vkQueuePresentKHR(vk_res.queues.graphics, &present_info) != VK_SUCCESS) {
+                printf("Unable to present image\n");
+                exit(EXIT_FAILURE);
+            }
         }
 
         /// Update state for next frame ///
-        glm::mat4 rotated_view = glm::rotate(state.main_dynamic_uniforms.get().view, glm::radians(-0.01f), glm::vec3(0.0f, 1.0f, 0.0f));
-        //glm::mat4 rotated_view = state.main_dynamic_uniforms.view.get();
-        //glm::vec4 rotated_sun = glm::rotate(state.main_dynamic_uniforms.sun_direction.get(), glm::radians(0.01f), glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::vec4 rotated_sun = state.main_dynamic_uniforms.get().sun_direction;
-
-        // Face the same direction as the main rendering camera
-        glm::mat4 cam_rotation = glm::mat4x4(rotated_view[0], rotated_view[1], rotated_view[2], glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        TRACE_ZONE("uniform update");
+        // No animation leaves the camera where it is
+        GlobalUniforms updated_main_data = state.animate_uniforms ? 
+            state.animate_uniforms(frame_global_uniforms.get(), state.frame_num + 1) :
+            frame_global_uniforms.get();
 
+        // Only the canonical values are updated here. The next frame's buffers may still be in use until its fence is waited on, so pushing happens then
         auto next_frame_index = (state.frame_in_flight + 1) % vk_res.buffer_count;
-        GlobalUniforms updated_main_data = state.main_dynamic_uniforms.get();
-        updated_main_data.view = rotated_view;
-        updated_main_data.sun_direction = rotated_sun;
-        BufferedUniform<GlobalUniforms> new_global_uniforms = state.main_dynamic_uniforms;
+        BufferedUniform<GlobalUniforms> new_global_uniforms = frame_global_uniforms;
         new_global_uniforms.set(updated_main_data);
-        new_global_uniforms.push(next_frame_index);
-
-        SkyboxUniforms updated_skybox_data = { cam_rotation };
-        BufferedUniform<SkyboxUniforms> new_skybox_uniforms = state.skybox_dynamic_uniforms;
-        new_skybox_uniforms.set(updated_skybox_data);
-        new_skybox_uniforms.push(next_frame_index);
 
         return DrawState {
             .buf_num = static_cast<uint8_t>((state.buf_num + 1u) % vk_res.buffer_count),
             .frame_num = state.frame_num + 1,
             .frame_in_flight = next_frame_index,
             .main_dynamic_uniforms = new_global_uniforms,
-            .skybox_dynamic_uniforms = new_skybox_uniforms
+            .gpu_profiler = state.gpu_profiler,
+            .animate_uniforms = state.animate_uniforms,
+            .render_settings = state.render_settings,
+            .lights = state.lights,
+            .resolution = state.resolution,
+            .occlusion = state.occlusion,
+            .frustum_culled_pieces = frustum_culled_pieces,
+            .frustum_cull_ms = frustum_cull_ms
+        };
+    }
+
+    UniformAnimation spin_view() {
+        return [](const GlobalUniforms& current, const uint64_t frame_num) {
+            GlobalUniforms next = current;
+            next.view = glm::rotate(current.view, glm::radians(-0.01f), glm::vec3(0.0f, 1.0f, 0.0f));
+            return next;
+        };
+    }
+
+    UniformAnimation scripted_camera_path(const GlobalUniforms& start) {
+        return [start](const GlobalUniforms& current, const uint64_t frame_num) {
+            // Everything is a function of the frame number alone so runs line up frame for frame, without accumulated float drift
+            const uint64_t ORBIT_FRAMES = 3600;
+            const uint64_t DOLLY_FRAMES = 1200;
+            const uint64_t SUN_FRAMES = 7200;
+            float orbit = glm::two_pi<float>() * static_cast<float>(frame_num % ORBIT_FRAMES) / static_cast<float>(ORBIT_FRAMES);
+            float dolly = glm::two_pi<float>() * static_cast<float>(frame_num % DOLLY_FRAMES) / static_cast<float>(DOLLY_FRAMES);
+            float sun = glm::two_pi<float>() * static_cast<float>(frame_num % SUN_FRAMES) / static_cast<float>(SUN_FRAMES);
+
+            GlobalUniforms next = current;
+            // Orbit the scene while easing in and out a little so depth complexity varies over the run
+            glm::mat4 dolly_offset = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.5f * std::sin(dolly)));
+            next.view = dolly_offset * glm::rotate(start.view, -orbit, glm::vec3(0.0f, 1.0f, 0.0f));
+            next.sun_direction = glm::rotate(glm::mat4(1.0f), sun, glm::vec3(1.0f, 0.0f, 0.0f)) * start.sun_direction;
+            return next;
         };
     }
 
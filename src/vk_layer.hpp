@@ -5,6 +5,8 @@
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
+#include <array>
+#include <string>
 #include <vector>
 #include <span>
 #include <deque>
@@ -15,6 +17,12 @@
 #include "vk_descriptors.hpp"
 #include "geometry.hpp"
 #include "glmvk.hpp"
+#include "vk_profiler.hpp"
+#include "vk_pipeline_cache.hpp"
+#include "workgroup_tuning.hpp"
+#include "lights.hpp"
+#include "dynamic_resolution.hpp"
+#include "render_formats.hpp"
 
 namespace vk_layer
 {
@@ -75,30 +83,117 @@ namespace vk_layer
         BufferedUniform<glm::mat4> transform;
     };
 
+    // Many copies of one model, drawn with a single instanced draw per piece. The model matrices are kept packed in draw order
+    // and copied into that frame's transform buffer every frame, so instances can come and go without anything being reallocated.
+    // Handles stay valid until the instance is removed, however the instances behind them get moved around
+    struct InstancedDrawable {
+        geometry::GpuModel gpu_model;
+        // Turns the model's own axes into the renderer's, applied ahead of every instance's transform
+        glm::mat4 basis;
+        std::vector<glm::mat4> transforms;
+        // Where each handle's transform sits in transforms, and the handle of each transform
+        std::vector<uint32_t> handle_slots;
+        std::vector<uint32_t> slot_handles;
+        std::vector<uint32_t> free_handles;
+        // Host visible, one per frame in flight, each with room for capacity transforms
+        std::vector<vk_types::AddressedBuffer> transform_buffers;
+        uint32_t capacity;
+    };
+
     struct GlobalUniforms {
         glm::mat4 view;
         glm::mat4 projection;
         glm::vec4 sun_direction;
     };
 
-    struct SkyboxUniforms {
-        glm::mat4 cam_rotation;
-    };
-
     struct Texture {
         vk_types::AllocatedImage allocated_image;
         VkDescriptorSet descriptor;
         VkDescriptorSetLayout layout;
     };
 
+    // Render width and height throughout are the corner of the full size targets drawn into this frame
     struct GridPassPushConstants {
         uint32_t grid_storage_index;
+        uint32_t render_width;
+        uint32_t render_height;
     };
 
+    // A light tile count of 0 leaves out point lights, and the light addresses go unread
     struct SpacePassPushConstants {
         uint32_t diffuse_texture_index;
         uint32_t specular_texture_index;
         uint32_t normal_texture_index;
+        uint32_t light_tile_count_x;
+        VkDeviceAddress lights_address;
+        VkDeviceAddress light_tiles_address;
+    };
+
+    struct VisibilityPassPushConstants {
+        uint32_t diffuse_texture_index;
+        uint32_t draw_id;
+    };
+
+    // Matches VertexStreams in pulled_vertex.glsl. The start of each of the geometry arena's streams, pushed to the vertex stage of pipelines that pull vertices after the fragment stage's constants
+    struct VertexStreamPushConstants {
+        VkDeviceAddress positions_address;
+        VkDeviceAddress normals_address;
+        VkDeviceAddress texture_coordinates_address;
+        // Model matrix of each instance. Zero and unread outside instanced draws
+        VkDeviceAddress instance_transforms_address;
+    };
+    const uint32_t PULLED_VERTEX_STREAMS_OFFSET = 32;
+    static_assert(sizeof(SpacePassPushConstants) <= PULLED_VERTEX_STREAMS_OFFSET && sizeof(VisibilityPassPushConstants) <= PULLED_VERTEX_STREAMS_OFFSET,
+                  "Fragment push constants of the space scene would overlap the pulled vertex streams");
+
+    struct VisibilityShadePushConstants {
+        VkDeviceAddress draw_records_address;
+        uint32_t visibility_storage_index;
+        uint32_t space_storage_index;
+        VkDeviceAddress lights_address;
+        VkDeviceAddress light_tiles_address;
+        uint32_t light_tile_count_x;
+        uint32_t render_width;
+        uint32_t render_height;
+    };
+
+    struct LightCullingPushConstants {
+        VkDeviceAddress lights_address;
+        VkDeviceAddress light_tiles_address;
+        uint32_t light_count;
+        uint32_t light_tile_count_x;
+        uint32_t space_depth_index;
+        uint32_t render_width;
+        uint32_t render_height;
+    };
+
+    // Culls one phase's worth of pieces, one invocation each. No pyramid levels leaves only the frustum test
+    struct OcclusionCullPushConstants {
+        glm::mat4 view_projection;
+        VkDeviceAddress bounds_address;
+        VkDeviceAddress draws_address;
+        VkDeviceAddress counters_address;
+        uint32_t piece_count;
+        uint32_t pyramid_index;
+        uint32_t pyramid_levels;
+        uint32_t depth_width;
+        uint32_t depth_height;
+    };
+
+    // Reduces one level of the depth pyramid from the space depth buffer, or from the level below
+    struct DepthPyramidPushConstants {
+        uint32_t source_index;
+        uint32_t source_level;
+        uint32_t source_width;
+        uint32_t source_height;
+        uint32_t destination_index;
+        uint32_t destination_width;
+        uint32_t destination_height;
+        uint32_t from_depth;
+        uint32_t jar_mask_index;
+        uint32_t jar_stencil_index;
+        uint32_t target_width;
+        uint32_t target_height;
     };
 
     struct SkyboxPassPushConstants {
@@ -111,25 +206,76 @@ namespace vk_layer
         uint32_t space_index;
         uint32_t space_depth_index;
         uint32_t jar_mask_index;
-        uint32_t jar_mask_depth_index;
+        uint32_t jar_stencil_index;
+        // compose_storage, or this frame's swapchain image when composing directly
         uint32_t compose_storage_index;
+        uint32_t render_width;
+        uint32_t render_height;
+        // Zero unless compose is classified
+        VkDeviceAddress tiles_address;
     };
 
+    struct RenderSettings {
+        // Evaluate the grid pattern inside the compose pass rather than writing it to a target first. Leaves out the grid target and its pass
+        bool fused_compose;
+        // Lay down depth for the space scene first with a cheap alpha tested pass, so the full shading only runs once per visible pixel
+        bool depth_prepass;
+        // Rasterize only draw and triangle IDs for the space scene, then shade every covered pixel once in a compute pass.
+        // Takes the place of the depth pre-pass, which has nothing left to save
+        bool visibility_buffer;
+        // Bin point lights into screen tiles against the space scene's depth, so shading only loops over the lights in its tile.
+        // Culling needs depth first, which comes from the visibility pass or else the depth pre-pass
+        bool tiled_lights;
+        // Sort screen tiles by how much of the jar mask covers them first, so only tiles on the jar's outline pay for the full blend
+        bool classified_compose;
+        // Mark the inner surfaces of the jar in the stencil of the space depth buffer instead of drawing a mask and depth target of their own,
+        // and only draw the space scene where they're marked. The space depth buffer takes a depth/stencil format for it
+        bool stencil_jar_mask;
+        // Soften the stencil's hard edge with a feathered mask drawn at half resolution. Ignored without the stencil mask
+        bool feathered_jar_mask;
+        // Compose straight into the swapchain image on frames rendered at full size, skipping compose_storage and the blit.
+        // Needs a swapchain created with storage usage, whose UNORM format leaves compose to encode sRGB itself, on the blit's frames too
+        bool direct_compose;
+        // Only draw the pieces of the space scene that aren't hidden behind what's already been drawn, tested against a depth pyramid on the GPU.
+        // Whatever lays down the scene's depth draws twice, once for what last frame's pyramid lets through and once for what this frame's does
+        bool occlusion_culling;
+        // Test every piece's bounds against the camera's frustum on the CPU and skip recording draws for the ones outside it
+        bool frustum_culling;
+        // Run the grid pass on a compute only queue so it overlaps the raster passes, handing the grid target to graphics for compose.
+        // Needs a context with a compute queue, and a grid pass to move, so not with a fused compose
+        bool async_compute;
+        // Have the space scene's vertex shaders fetch attributes through the geometry arena's stream addresses rather than from bound vertex buffers.
+        // Indices still go through the bound index buffer. The jar masks keep fixed function vertex input
+        bool vertex_pulling;
+        // Build the pipelines instanced drawables are drawn with. They always pull their vertices, and aren't drawn into the visibility buffer
+        bool instancing;
+        render_formats::TargetFormats formats;
+    };
+
+    // The grid target and its descriptors are only created when compose isn't fused, the visibility target and the space storage handle only with the visibility buffer.
+    // With the stencil jar mask there's no jar mask depth, the stencil handle reads space_depth's stencil, and the jar mask is only there at half size when feathered
     struct RenderTargets {
         uint32_t grid_storage_index;
         uint32_t grid_sampled_index;
         uint32_t grid_sampler_index;
         vk_types::AllocatedImage grid;
         uint32_t space_index;
+        uint32_t space_storage_index;
         vk_types::AllocatedImage space;
+        uint32_t visibility_storage_index;
+        vk_types::AllocatedImage visibility;
         uint32_t space_depth_index;
         vk_types::AllocatedImage space_depth;
         uint32_t jar_mask_index;
         vk_types::AllocatedImage jar_mask;
-        uint32_t jar_mask_depth_index;
         vk_types::AllocatedImage jar_mask_depth;
+        uint32_t jar_stencil_index;
         uint32_t compose_storage_index;
         vk_types::AllocatedImage compose_storage;
+        // Storage handle of each swapchain image, by swapchain image index. Only registered with direct compose
+        std::vector<uint32_t> swapchain_storage_indices;
+        // Only created with classified compose. Indirect dispatch arguments for each tile class followed by the tiles themselves, laid out as in compose_tiles.glsl
+        vk_types::AddressedBuffer compose_tiles;
     };
 
     struct DescriptorSetLayouts {
@@ -138,31 +284,176 @@ namespace vk_layer
         std::vector<VkDescriptorSetLayout>& jar_cutaway_mask;
         std::vector<VkDescriptorSetLayout>& graphics;
         std::vector<VkDescriptorSetLayout>& compose;
+        std::vector<VkDescriptorSetLayout>& visibility_shade;
+        std::vector<VkDescriptorSetLayout>& light_culling;
+        std::vector<VkDescriptorSetLayout>& occlusion_culling;
     };
 
     struct Pipelines {
         vk_types::Pipeline grid;
         vk_types::Pipeline skybox;
+        // Not built with the stencil jar mask unless it's feathered, in which case it draws the half resolution mask
         vk_types::Pipeline jar_cutaway_mask;
+        // Only built with the stencil jar mask
+        vk_types::Pipeline jar_stencil;
         vk_types::Pipeline space;
+        // Only built when the depth pre-pass is on
+        vk_types::Pipeline depth_prepass;
+        // Only built with instancing, the pre-pass one only along with the depth pre-pass
+        vk_types::Pipeline space_instanced;
+        vk_types::Pipeline depth_prepass_instanced;
+        // Only built with the visibility buffer, in place of space
+        vk_types::Pipeline visibility;
+        vk_types::Pipeline visibility_shade;
+        // Only built with tiled lights
+        vk_types::Pipeline light_culling;
+        // Not built with classified compose, which has the classifier and a pipeline per tile class in its place
         vk_types::Pipeline compose;
+        vk_types::Pipeline compose_classify;
+        std::array<vk_types::Pipeline, 3> compose_tiles;
+        // Only built with occlusion culling. The early phase's culling pipeline first, then the late phase's
+        vk_types::Pipeline depth_pyramid;
+        std::array<vk_types::Pipeline, 2> occlusion_cull;
+    };
+
+    // Everything the visibility buffer's shading pass needs to rebuild a piece's triangles, laid out to match visibility_shade.glsl.comp
+    struct VisibilityDrawRecord {
+        VkDeviceAddress index_buffer_address;
+        VkDeviceAddress position_buffer_address;
+        VkDeviceAddress normal_buffer_address;
+        VkDeviceAddress texture_coordinate_buffer_address;
+        glm::mat4 model;
+        uint32_t diffuse_texture_index;
+        uint32_t specular_texture_index;
+        uint32_t normal_texture_index;
+        uint32_t padding;
     };
 
+    // One record per piece of every drawable, in draw order. The draw ID written to the visibility target indexes into these
+    struct VisibilityDrawRecords {
+        vk_types::AddressedBuffer buffer;
+        uint32_t draw_count;
+    };
+
+    // Point lights and the per tile lists they're culled into. The lights themselves are rewritten every frame,
+    // so there's a host visible buffer per frame in flight. The tile lists are only touched by the GPU within a frame
+    struct LightResources {
+        lights::LightField field;
+        std::vector<vk_types::AddressedBuffer> light_buffers;
+        vk_types::AddressedBuffer light_tiles;
+        VkExtent2D tile_count;
+    };
+
+    // Matches Counters in occlusion_cull.glsl.comp. Only the late phase counts, so every piece ends up in exactly one of these each frame
+    struct OcclusionCounters {
+        uint32_t early_drawn;
+        uint32_t late_drawn;
+        uint32_t frustum_culled;
+        uint32_t occlusion_culled;
+    };
+
+    // Everything two phase occlusion culling of the main drawables needs. The pieces are culled by their bounding spheres, and only
+    // ever have the instance counts of their indirect draws changed, so the pieces keep their own index buffers and draw order
+    struct OcclusionCulling {
+        // World space sphere around each piece of every drawable, in draw order
+        vk_types::AddressedBuffer bounds;
+        // A VkDrawIndexedIndirectCommand per piece for the early phase, followed by another per piece for the late phase
+        vk_types::AddressedBuffer draws;
+        // Host visible, one per frame in flight, read back once that frame's fence has been waited on
+        std::vector<vk_types::AddressedBuffer> counters;
+        // Where each drawable's pieces start among all of them
+        std::vector<uint32_t> first_pieces;
+        uint32_t piece_count;
+        // Farthest depth over each 2x2 of the level below. Level 0 halves the space depth buffer, rounded up to a power of two so
+        // every level is at least as large as the rounded up reductions of any render extent need
+        vk_types::AllocatedImage pyramid;
+        uint32_t pyramid_sampled_index;
+        std::vector<uint32_t> pyramid_storage_indices;
+        // What the pyramid was last built from, which the next frame's early phase tests against. No levels until the first build
+        glm::mat4 pyramid_view_projection;
+        VkExtent2D pyramid_extent;
+        uint32_t pyramid_levels;
+        // Sums of the counters over every frame read back so far
+        uint64_t counted_frames;
+        uint64_t early_drawn;
+        uint64_t late_drawn;
+        uint64_t frustum_culled;
+        uint64_t occlusion_culled;
+    };
+
+    // Produces the global uniforms for the given frame from the previous frame's
+    using UniformAnimation = std::function<GlobalUniforms(const GlobalUniforms& current, const uint64_t frame_num)>;
+
     struct DrawState {
         uint8_t buf_num;
         uint64_t frame_num;
         uint64_t frame_in_flight;
         BufferedUniform<GlobalUniforms> main_dynamic_uniforms;
-        BufferedUniform<SkyboxUniforms> skybox_dynamic_uniforms;
+        // Optional, times and labels each pass when set
+        vk_profiler::GpuProfiler* gpu_profiler;
+        // Optional, the camera and sun stay put without one
+        UniformAnimation animate_uniforms;
+        // Must match the settings the render targets and pipelines were built with
+        RenderSettings render_settings;
+        // Needed when render_settings has tiled lights, ignored otherwise
+        const LightResources* lights;
+        // Optional, frames render at the full size of the targets without one. Fed the profiler's frame times, so timing has to be on
+        dynamic_resolution::Controller* resolution;
+        // Needed when render_settings has occlusion culling, ignored otherwise. Keeps the pyramid's history and the counters between frames
+        OcclusionCulling* occlusion;
+        // Filled in by draw for the frame it just recorded: pieces frustum culling skipped, and how long testing them took on the CPU
+        uint32_t frustum_culled_pieces;
+        double frustum_cull_ms;
     };
 
     // Registers the skybox texture with the mega descriptor set as a combined sampler image, returns the descriptor index
     uint32_t upload_skybox(vk_types::Context& context, const vk_image::HostImage& skybox_image, vk_types::CleanupProcedures& lifetime);
-    Pipelines build_pipelines(vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, RenderTargets& render_targets, vk_types::CleanupProcedures& lifetime);
+    struct PipelineSettings {
+        // Threads compiling pipelines at once
+        size_t thread_count;
+        // Load SPIR-V from this directory instead of the copies embedded in the binary. Empty uses the embedded ones
+        std::string shader_directory;
+        // Local sizes the compute passes are specialized with
+        workgroup_tuning::WorkgroupSizes workgroup_sizes;
+    };
+
+    // Compiles every pipeline concurrently and returns once they're all done. The grid pipeline is left out when compose is fused,
+    // the depth pre-pass and light culling pipelines unless those are turned on, and the visibility buffer's pipelines take the place of the space pipeline when it's on.
+    // The stencil jar mask swaps in the jar stencil pipeline, keeping the jar cutaway mask pipeline only when feathered. Occlusion culling adds the pyramid and culling pipelines,
+    // and instancing the instanced space and pre-pass pipelines.
+    // Pipelines come out of the pipeline cache and are owned by it, lifetime covers the shaders and layouts
+    Pipelines build_pipelines(vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, RenderTargets& render_targets, vk_pipeline_cache::PipelineCache& pipeline_cache, const RenderSettings& render_settings, const PipelineSettings& settings, vk_types::CleanupProcedures& lifetime);
+    // Times every workgroup size candidate for the grid and compose passes on this device and returns the fastest of each.
+    // Falls back to the sizes in settings if the device can't time them. Candidate pipelines stay in the pipeline cache
+    workgroup_tuning::WorkgroupSizes autotune_workgroup_sizes(vk_types::Context& context, const DescriptorSetLayouts& descriptor_layouts, const RenderTargets& render_targets, vk_pipeline_cache::PipelineCache& pipeline_cache, const RenderSettings& render_settings, const PipelineSettings& settings, vk_types::CleanupProcedures& lifetime);
     BufferedUniform<GlobalUniforms> build_global_uniforms(vk_types::Context& context, const size_t buffer_count, vk_types::CleanupProcedures& lifetime);
-    BufferedUniform<SkyboxUniforms> build_skybox_uniforms(vk_types::Context& context, const size_t buffer_count, vk_types::CleanupProcedures& lifetime);
-    RenderTargets build_render_targets(vk_types::Context& context, vk_types::CleanupProcedures& lifetime);
+    RenderTargets build_render_targets(vk_types::Context& context, const RenderSettings& render_settings, vk_types::CleanupProcedures& lifetime);
+    // Writing triangle IDs from the fragment shader needs the geometryShader feature
+    bool supports_visibility_buffer(const vk_types::Context& context);
+    // Model matrices are copied in as they are now, so these have to be rebuilt if a drawable's transform changes afterwards.
+    // Prints and exits if the drawables have more pieces or triangles than the visibility target's IDs can address
+    VisibilityDrawRecords build_visibility_draw_records(vk_types::Context& context, const std::vector<Drawable>& drawables, vk_types::CleanupProcedures& lifetime);
+    // Generates the light field and the buffers it's drawn from, with tile lists sized to the render targets
+    LightResources build_light_resources(vk_types::Context& context, const uint32_t light_count, const RenderTargets& render_targets, vk_types::CleanupProcedures& lifetime);
+    // Bounds are transformed by the drawables' transforms as they are now, so like the visibility draw records these have to be rebuilt if one changes.
+    // The pyramid is sized to the render targets and registered with the mega descriptor set
+    OcclusionCulling build_occlusion_culling(vk_types::Context& context, const std::vector<Drawable>& drawables, const RenderTargets& render_targets, vk_types::CleanupProcedures& lifetime);
+    // Grid target traffic per frame that fusing compose avoids at this extent: one full write by the grid pass and one full read by compose
+    uint64_t fused_compose_bytes_saved(const VkExtent2D extent, const VkFormat grid_format);
+    // Swaps any target format the device can't use for that target back to its default, saying so. Also picks the space depth format,
+    // turning the stencil jar mask off if the device has no depth/stencil format that will do
+    RenderSettings check_target_formats(const vk_types::Context& context, const RenderSettings& render_settings);
+    // Each render target the settings create, with one full write and one full read per frame at this extent. Direct compose
+    // leaves out the compose target, whose frames mostly go straight to the swapchain
+    std::vector<render_formats::TargetTraffic> target_traffic(const RenderSettings& render_settings, const VkExtent2D extent);
     Drawable make_drawable(vk_types::Context& context, const geometry::HostModel& model_data);
+    // Uploads the model once and sets aside transform buffers for up to capacity instances, starting with none
+    InstancedDrawable make_instanced_drawable(vk_types::Context& context, const geometry::HostModel& model_data, const uint32_t capacity);
+    // Returns the new instance's handle. Prints and exits if the drawable already has capacity instances
+    uint32_t add_instance(InstancedDrawable& drawable, const glm::mat4& transform);
+    void set_instance(InstancedDrawable& drawable, const uint32_t handle, const glm::mat4& transform);
+    // The last instance moves into the removed one's place, and the handle is free to be handed out again
+    void remove_instance(InstancedDrawable& drawable, const uint32_t handle);
     void immediate_submit(const vk_types::Context& res, std::function<void(VkCommandBuffer cmd)>&& function);
 
     DrawState draw( const vk_types::Context& res,
@@ -170,12 +461,18 @@ namespace vk_layer
                     const RenderTargets& render_targets, 
                     const std::vector<Drawable>& drawables, 
                     const std::vector<Drawable>& masking_jars, 
-                    const Drawable& skybox, 
+                    const std::vector<InstancedDrawable>& instanced_drawables,
+                    const VisibilityDrawRecords& visibility_draw_records,
                     const uint32_t skybox_texture_index, 
                     const DrawState& state);
 
     void cleanup(vk_types::Context& resources, vk_types::CleanupProcedures& cleanup_procedures);
 
+    // Slowly spins the camera in place, the default for interactive runs
+    UniformAnimation spin_view();
+    // Deterministic orbit of the camera and sun keyed purely on frame number, for reproducible benchmarking
+    UniformAnimation scripted_camera_path(const GlobalUniforms& start);
+
     template <class T>
     VkPushConstantRange push_constant_range(VkShaderStageFlagBits stage) {
         VkPushConstantRange range = {};
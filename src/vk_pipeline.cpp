@@ -1,9 +1,36 @@
 #include "vk_pipeline.hpp"
-#include <array>
+#include "vk_image.hpp"
+#include <chrono>
 #include <fstream>
 #include <ios>
+#include <optional>
+#include <vector>
 
 namespace vk_pipeline {
+    namespace {
+        // Compute shaders take their local size from specialization constants 0 and 1, any others follow from 2. The info points into the struct, so it stays put
+        struct WorkgroupSpecialization {
+            std::vector<uint32_t> data;
+            std::vector<VkSpecializationMapEntry> entries;
+            VkSpecializationInfo info;
+
+            explicit WorkgroupSpecialization(const VkExtent2D workgroup_size, const std::span<const uint32_t> extra_constants = {}) {
+                data = { workgroup_size.width, workgroup_size.height };
+                data.insert(data.end(), extra_constants.begin(), extra_constants.end());
+                for (uint32_t constant_id = 0; constant_id < data.size(); ++constant_id) {
+                    entries.push_back({ constant_id, constant_id * static_cast<uint32_t>(sizeof(uint32_t)), sizeof(uint32_t) });
+                }
+                info = {};
+                info.mapEntryCount = static_cast<uint32_t>(entries.size());
+                info.pMapEntries = entries.data();
+                info.dataSize = data.size() * sizeof(uint32_t);
+                info.pData = data.data();
+            }
+            WorkgroupSpecialization(const WorkgroupSpecialization&) = delete;
+            WorkgroupSpecialization& operator=(const WorkgroupSpecialization&) = delete;
+        };
+    }
+
     VkPipelineShaderStageCreateInfo make_shader_stage_info(VkShaderStageFlagBits stage_flags, VkShaderModule module) {
         // Then create the pipeline (this is somewhat specific to pipeline type)
         VkPipelineShaderStageCreateInfo stage_info{};
@@ -17,8 +44,10 @@ namespace vk_pipeline {
     }
 
     // Creates a compute pipeline with the specified compute shader
-    vk_types::Pipeline init_compute_pipeline(const VkDevice device, const VkPipelineLayout compute_pipeline_layout, const VkShaderModule shader_module, vk_types::CleanupProcedures& cleanup_procedures) {
+    vk_types::Pipeline init_compute_pipeline(const VkDevice device, const VkPipelineLayout compute_pipeline_layout, const VkShaderModule shader_module, const VkExtent2D workgroup_size, vk_types::CleanupProcedures& cleanup_procedures) {
+        WorkgroupSpecialization specialization(workgroup_size);
         VkPipelineShaderStageCreateInfo stage_info = make_shader_stage_info(VK_SHADER_STAGE_COMPUTE_BIT, shader_module);
+        stage_info.pSpecializationInfo = &specialization.info;
 
         VkComputePipelineCreateInfo compute_pipeline_info{};
         compute_pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -40,19 +69,63 @@ namespace vk_pipeline {
         pipeline.bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
         pipeline.handle = compute_pipeline;
         pipeline.layout = compute_pipeline_layout;
+        pipeline.workgroup_size = workgroup_size;
 
         return pipeline;
     }
 
+    vk_types::Pipeline init_compute_pipeline(const VkDevice device, const VkPipelineLayout compute_pipeline_layout, const VkShaderModule shader_module, const VkExtent2D workgroup_size, vk_pipeline_cache::PipelineCache& pipeline_cache, const std::span<const uint32_t> extra_constants) {
+        vk_pipeline_cache::KeyWriter key_writer;
+        key_writer.add(VK_PIPELINE_BIND_POINT_COMPUTE);
+        key_writer.add_handle(compute_pipeline_layout);
+        key_writer.add_handle(shader_module);
+        key_writer.add(workgroup_size);
+        key_writer.add_array(extra_constants.data(), static_cast<uint32_t>(extra_constants.size()));
+        const std::string& key = key_writer.key();
+
+        std::optional<vk_types::Pipeline> existing = vk_pipeline_cache::find(pipeline_cache, key);
+        if (existing.has_value()) {
+            return existing.value();
+        }
+
+        VkComputePipelineCreateInfo compute_pipeline_info{};
+        compute_pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        compute_pipeline_info.pNext = nullptr;
+        compute_pipeline_info.layout = compute_pipeline_layout;
+        WorkgroupSpecialization specialization(workgroup_size, extra_constants);
+        compute_pipeline_info.stage = make_shader_stage_info(VK_SHADER_STAGE_COMPUTE_BIT, shader_module);
+        compute_pipeline_info.stage.pSpecializationInfo = &specialization.info;
+
+        VkPipeline compute_pipeline = {};
+        auto start = std::chrono::steady_clock::now();
+        if(vkCreateComputePipelines(device, pipeline_cache.handle, 1, &compute_pipeline_info, nullptr, &compute_pipeline) != VK_SUCCESS) {
+            printf("Unable to create compute pipeline\n");
+            exit(EXIT_FAILURE);
+        }
+        double creation_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        vk_types::Pipeline pipeline = {};
+        pipeline.bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+        pipeline.handle = compute_pipeline;
+        pipeline.layout = compute_pipeline_layout;
+        pipeline.workgroup_size = workgroup_size;
+
+        return vk_pipeline_cache::insert(pipeline_cache, key, pipeline, creation_ms);
+    }
+
     // Creates a pipeline layout with the specified descriptor set layouts
     VkPipelineLayout init_pipeline_layout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts, const VkPushConstantRange pc_range, vk_types::CleanupProcedures& cleanup_procedures) {
+        return init_pipeline_layout(device, descriptor_set_layouts, std::span<const VkPushConstantRange>(&pc_range, 1), cleanup_procedures);
+    }
+
+    VkPipelineLayout init_pipeline_layout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts, const std::span<const VkPushConstantRange> pc_ranges, vk_types::CleanupProcedures& cleanup_procedures) {
         VkPipelineLayoutCreateInfo layout_info{};
         layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         layout_info.pNext = nullptr;
         layout_info.pSetLayouts = descriptor_set_layouts.data();
         layout_info.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size());
-        layout_info.pPushConstantRanges = &pc_range;
-        layout_info.pushConstantRangeCount = 1;
+        layout_info.pPushConstantRanges = pc_ranges.data();
+        layout_info.pushConstantRangeCount = static_cast<uint32_t>(pc_ranges.size());
 
         VkPipelineLayout pipeline_layout = {};
         if(vkCreatePipelineLayout(device, &layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
@@ -137,6 +210,34 @@ namespace vk_pipeline {
         return shader_module;
     }
 
+    VkShaderModule init_shader_module(const VkDevice device, const std::span<const uint32_t> code, const char* name, vk_types::CleanupProcedures& cleanup_procedures) {
+        VkShaderModuleCreateInfo shader_info = {};
+        shader_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        shader_info.pNext = nullptr;
+        shader_info.codeSize = code.size_bytes();
+        shader_info.pCode = code.data();
+
+        VkShaderModule shader_module = {};
+        if (vkCreateShaderModule(device, &shader_info, nullptr, &shader_module) != VK_SUCCESS)
+        {
+            printf("Unable to generate shader module from embedded shader: %s\n", name);
+            exit(EXIT_FAILURE);
+        }
+
+        cleanup_procedures.add([device, shader_module]() {
+            vkDestroyShaderModule(device, shader_module, nullptr);
+        });
+        return shader_module;
+    }
+
+    VkShaderModule init_shader_module(const VkDevice device, const shaders::EmbeddedShader& shader, const std::string& shader_directory, vk_types::CleanupProcedures& cleanup_procedures) {
+        if (shader_directory.empty()) {
+            return init_shader_module(device, shader.code, shader.file_name, cleanup_procedures);
+        }
+        std::string file_path = shader_directory + "/" + shader.file_name;
+        return init_shader_module(device, file_path.c_str(), cleanup_procedures);
+    }
+
     GraphicsPipelineBuilder::GraphicsPipelineBuilder(const VkDevice device, 
                                                      const VkPipelineLayout pipeline_layout, 
                                                      const VkShaderModule vert_shader_module, 
@@ -216,6 +317,7 @@ namespace vk_pipeline {
         }};
 
         default_dynamic_state = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        pulls_vertices = false;
 
         vertex_input_info = {};
         vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -260,8 +362,11 @@ namespace vk_pipeline {
         rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
         rendering_info.pNext = nullptr;
         rendering_info.colorAttachmentCount = 1;
-        rendering_info.pColorAttachmentFormats = &default_target_format;
+        // The member, not the constructor argument of the same name, so the pointer outlives the constructor
+        rendering_info.pColorAttachmentFormats = &this->default_target_format;
         rendering_info.depthAttachmentFormat = default_depth_format;
+        // A combined depth/stencil target is bound as both attachments
+        rendering_info.stencilAttachmentFormat = vk_image::has_stencil(default_depth_format) ? default_depth_format : VK_FORMAT_UNDEFINED;
 
         // Depth configuration. Default configures a depth target with no stencil test capability
         depth_stencil_info = {};
@@ -312,12 +417,21 @@ namespace vk_pipeline {
     void GraphicsPipelineBuilder::override(VkPipelineDynamicStateCreateInfo& dynamic_info) {
         this->dynamic_info = dynamic_info;
     }
+    void GraphicsPipelineBuilder::test_stencil(const VkStencilOpState& stencil) {
+        depth_stencil_info.stencilTestEnable = VK_TRUE;
+        depth_stencil_info.front = stencil;
+        depth_stencil_info.back = stencil;
+    }
 
-    vk_types::Pipeline GraphicsPipelineBuilder::build() {
-        std::vector<VkPipelineShaderStageCreateInfo> shader_stage_infos = {
-            make_shader_stage_info(VK_SHADER_STAGE_VERTEX_BIT, vertex_shader),
-            make_shader_stage_info(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_shader),
-        };
+    void GraphicsPipelineBuilder::pull_vertices() {
+        vertex_input_info.pVertexAttributeDescriptions = nullptr;
+        vertex_input_info.vertexAttributeDescriptionCount = 0;
+        vertex_input_info.pVertexBindingDescriptions = nullptr;
+        vertex_input_info.vertexBindingDescriptionCount = 0;
+        pulls_vertices = true;
+    }
+
+    VkGraphicsPipelineCreateInfo GraphicsPipelineBuilder::make_pipeline_info(const std::vector<VkPipelineShaderStageCreateInfo>& shader_stage_infos) const {
          /// Smoosh everything into the pipeline definition, unused stages like tesselation left as 0 initialized nullptr
         VkGraphicsPipelineCreateInfo pipeline_info = {};
         pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -334,6 +448,78 @@ namespace vk_pipeline {
         pipeline_info.pDynamicState = &dynamic_info;
         pipeline_info.layout = pipeline_layout;
 
+        return pipeline_info;
+    }
+
+    // Everything that feeds into the pipeline, with pointed-to arrays flattened out. Extension chains on the state structs aren't followed
+    std::string GraphicsPipelineBuilder::make_key() const {
+        vk_pipeline_cache::KeyWriter key_writer;
+        key_writer.add(VK_PIPELINE_BIND_POINT_GRAPHICS);
+        key_writer.add_handle(pipeline_layout);
+        key_writer.add_handle(vertex_shader);
+        key_writer.add_handle(fragment_shader);
+
+        key_writer.add_array(vertex_input_info.pVertexBindingDescriptions, vertex_input_info.vertexBindingDescriptionCount);
+        key_writer.add_array(vertex_input_info.pVertexAttributeDescriptions, vertex_input_info.vertexAttributeDescriptionCount);
+
+        key_writer.add(input_assembly_info.topology);
+        key_writer.add(input_assembly_info.primitiveRestartEnable);
+
+        key_writer.add(viewport_info.viewportCount);
+        key_writer.add(viewport_info.scissorCount);
+        key_writer.add_array(viewport_info.pViewports, viewport_info.pViewports == nullptr ? 0 : viewport_info.viewportCount);
+        key_writer.add_array(viewport_info.pScissors, viewport_info.pScissors == nullptr ? 0 : viewport_info.scissorCount);
+
+        key_writer.add(rasterization_info.depthClampEnable);
+        key_writer.add(rasterization_info.rasterizerDiscardEnable);
+        key_writer.add(rasterization_info.polygonMode);
+        key_writer.add(rasterization_info.cullMode);
+        key_writer.add(rasterization_info.frontFace);
+        key_writer.add(rasterization_info.depthBiasEnable);
+        key_writer.add(rasterization_info.depthBiasConstantFactor);
+        key_writer.add(rasterization_info.depthBiasClamp);
+        key_writer.add(rasterization_info.depthBiasSlopeFactor);
+        key_writer.add(rasterization_info.lineWidth);
+
+        key_writer.add(multisampling_info.rasterizationSamples);
+        key_writer.add(multisampling_info.sampleShadingEnable);
+        key_writer.add(multisampling_info.minSampleShading);
+        key_writer.add_array(multisampling_info.pSampleMask, multisampling_info.pSampleMask == nullptr ? 0 : (static_cast<uint32_t>(multisampling_info.rasterizationSamples) + 31) / 32);
+        key_writer.add(multisampling_info.alphaToCoverageEnable);
+        key_writer.add(multisampling_info.alphaToOneEnable);
+
+        key_writer.add(rendering_info.viewMask);
+        key_writer.add_array(rendering_info.pColorAttachmentFormats, rendering_info.colorAttachmentCount);
+        key_writer.add(rendering_info.depthAttachmentFormat);
+        key_writer.add(rendering_info.stencilAttachmentFormat);
+
+        key_writer.add(depth_stencil_info.depthTestEnable);
+        key_writer.add(depth_stencil_info.depthWriteEnable);
+        key_writer.add(depth_stencil_info.depthCompareOp);
+        key_writer.add(depth_stencil_info.depthBoundsTestEnable);
+        key_writer.add(depth_stencil_info.stencilTestEnable);
+        key_writer.add(depth_stencil_info.front);
+        key_writer.add(depth_stencil_info.back);
+        key_writer.add(depth_stencil_info.minDepthBounds);
+        key_writer.add(depth_stencil_info.maxDepthBounds);
+
+        key_writer.add(color_blend_info.logicOpEnable);
+        key_writer.add(color_blend_info.logicOp);
+        key_writer.add_array(color_blend_info.pAttachments, color_blend_info.attachmentCount);
+        key_writer.add(color_blend_info.blendConstants);
+
+        key_writer.add_array(dynamic_info.pDynamicStates, dynamic_info.dynamicStateCount);
+
+        return key_writer.key();
+    }
+
+    vk_types::Pipeline GraphicsPipelineBuilder::build() {
+        std::vector<VkPipelineShaderStageCreateInfo> shader_stage_infos = {
+            make_shader_stage_info(VK_SHADER_STAGE_VERTEX_BIT, vertex_shader),
+            make_shader_stage_info(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_shader),
+        };
+        VkGraphicsPipelineCreateInfo pipeline_info = make_pipeline_info(shader_stage_infos);
+
         VkPipeline graphics_pipeline = {};
         if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &graphics_pipeline) != VK_SUCCESS) {
             printf("Unable to create graphics pipeline\n");
@@ -350,7 +536,38 @@ namespace vk_pipeline {
         graphics_pipeline_bundle.handle = graphics_pipeline;
         graphics_pipeline_bundle.layout = pipeline_layout;
         graphics_pipeline_bundle.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        graphics_pipeline_bundle.pulls_vertices = pulls_vertices;
 
         return graphics_pipeline_bundle;
     }
+
+    vk_types::Pipeline GraphicsPipelineBuilder::build(vk_pipeline_cache::PipelineCache& pipeline_cache) {
+        std::string key = make_key();
+        std::optional<vk_types::Pipeline> existing = vk_pipeline_cache::find(pipeline_cache, key);
+        if (existing.has_value()) {
+            return existing.value();
+        }
+
+        std::vector<VkPipelineShaderStageCreateInfo> shader_stage_infos = {
+            make_shader_stage_info(VK_SHADER_STAGE_VERTEX_BIT, vertex_shader),
+            make_shader_stage_info(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_shader),
+        };
+        VkGraphicsPipelineCreateInfo pipeline_info = make_pipeline_info(shader_stage_infos);
+
+        VkPipeline graphics_pipeline = {};
+        auto start = std::chrono::steady_clock::now();
+        if (vkCreateGraphicsPipelines(device, pipeline_cache.handle, 1, &pipeline_info, nullptr, &graphics_pipeline) != VK_SUCCESS) {
+            printf("Unable to create graphics pipeline\n");
+            exit(EXIT_FAILURE);
+        }
+        double creation_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        vk_types::Pipeline graphics_pipeline_bundle = {};
+        graphics_pipeline_bundle.handle = graphics_pipeline;
+        graphics_pipeline_bundle.layout = pipeline_layout;
+        graphics_pipeline_bundle.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        graphics_pipeline_bundle.pulls_vertices = pulls_vertices;
+
+        return vk_pipeline_cache::insert(pipeline_cache, key, graphics_pipeline_bundle, creation_ms);
+    }
 }
\ No newline at end of file
@@ -3,20 +3,33 @@
 
 #include "vk_types.hpp"
 #include "vk_buffer.hpp"
+#include "vk_pipeline_cache.hpp"
+#include "shaders.hpp"
 #include <functional>
+#include <span>
+#include <string>
 
 namespace vk_pipeline {
     // Creates a shader stage info structure for the given shader stage and module.
     VkPipelineShaderStageCreateInfo make_shader_stage_info(VkShaderStageFlagBits stage_flags, VkShaderModule module);
 
-    // Creates a compute pipeline with the specified compute shader
-    vk_types::Pipeline init_compute_pipeline(const VkDevice device, const VkPipelineLayout compute_pipeline_layout, const VkShaderModule shader_module, vk_types::CleanupProcedures& cleanup_procedures);
+    // Creates a compute pipeline with the specified compute shader. The workgroup size goes to specialization constants 0 (x) and 1 (y)
+    vk_types::Pipeline init_compute_pipeline(const VkDevice device, const VkPipelineLayout compute_pipeline_layout, const VkShaderModule shader_module, const VkExtent2D workgroup_size, vk_types::CleanupProcedures& cleanup_procedures);
+    // Same, but goes through the pipeline cache. A layout, shader, workgroup size, and constants that were seen before get the existing pipeline back.
+    // Any extra constants go to specialization constants 2 onwards
+    vk_types::Pipeline init_compute_pipeline(const VkDevice device, const VkPipelineLayout compute_pipeline_layout, const VkShaderModule shader_module, const VkExtent2D workgroup_size, vk_pipeline_cache::PipelineCache& pipeline_cache, const std::span<const uint32_t> extra_constants = {});
 
     // Creates a pipeline layout with the specified descriptor set layouts
     VkPipelineLayout init_pipeline_layout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts, const VkPushConstantRange pc_range, vk_types::CleanupProcedures& cleanup_procedures);
     VkPipelineLayout init_pipeline_layout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts, vk_types::CleanupProcedures& cleanup_procedures);
+    // Same, for push constants split between stages. The ranges mustn't overlap
+    VkPipelineLayout init_pipeline_layout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts, const std::span<const VkPushConstantRange> pc_ranges, vk_types::CleanupProcedures& cleanup_procedures);
     // Creates a shader module from the given SPIR-V file.
     VkShaderModule init_shader_module(const VkDevice device, const char *file_path, vk_types::CleanupProcedures& cleanup_procedures);
+    // Creates a shader module straight from SPIR-V in memory. The code is handed to the driver without a copy
+    VkShaderModule init_shader_module(const VkDevice device, const std::span<const uint32_t> code, const char* name, vk_types::CleanupProcedures& cleanup_procedures);
+    // Creates a shader module from the copy embedded in the binary, or from the file of the same name in shader_directory when one is given
+    VkShaderModule init_shader_module(const VkDevice device, const shaders::EmbeddedShader& shader, const std::string& shader_directory, vk_types::CleanupProcedures& cleanup_procedures);
 
     class GraphicsPipelineBuilder {
         private:
@@ -30,6 +43,7 @@ namespace vk_pipeline {
         std::vector<VkDynamicState> default_dynamic_state;
         VkFormat default_target_format;
         VkPipelineColorBlendAttachmentState default_blend_attachment_state;
+        bool pulls_vertices;
 
         VkPipelineViewportStateCreateInfo viewport_info;
         VkPipelineColorBlendStateCreateInfo color_blend_info;
@@ -41,6 +55,9 @@ namespace vk_pipeline {
         VkPipelineDepthStencilStateCreateInfo depth_stencil_info;
         VkPipelineDynamicStateCreateInfo dynamic_info;
 
+        VkGraphicsPipelineCreateInfo make_pipeline_info(const std::vector<VkPipelineShaderStageCreateInfo>& shader_stage_infos) const;
+        std::string make_key() const;
+
         public:
         GraphicsPipelineBuilder(const VkDevice device, 
                                 const VkPipelineLayout pipeline_layout, 
@@ -59,7 +76,13 @@ namespace vk_pipeline {
         void override(VkPipelineRenderingCreateInfo& rendering_info);
         void override(VkPipelineDepthStencilStateCreateInfo& depth_stencil_info);
         void override(VkPipelineDynamicStateCreateInfo& dynamic_info);
+        // Turns on the stencil test for both faces on top of whatever depth state is set, so it goes after any override of that
+        void test_stencil(const VkStencilOpState& stencil);
+        // Drops the vertex input state for a vertex shader that fetches its own attributes, and marks the pipeline so draws skip binding vertex buffers
+        void pull_vertices();
         vk_types::Pipeline build();
+        // Builds through the pipeline cache. Identical builder state gets the existing pipeline back, and the cache owns the result
+        vk_types::Pipeline build(vk_pipeline_cache::PipelineCache& pipeline_cache);
     };
 }
 
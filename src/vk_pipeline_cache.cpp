@@ -0,0 +1,204 @@
+#include "vk_pipeline_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace vk_pipeline_cache {
+    namespace {
+        const uint32_t FILE_MAGIC = 0x43504A47; // "GJPC"
+        const uint32_t FILE_VERSION = 1;
+
+        // Sits in front of the driver's blob. Laid out without padding so it can be written as is
+        struct FileHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t vendor_id;
+            uint32_t device_id;
+            uint32_t driver_version;
+            uint8_t device_uuid[VK_UUID_SIZE];
+            uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+            uint32_t reserved;
+            uint64_t cold_creation_us;
+            uint64_t data_size;
+            uint64_t data_checksum;
+        };
+
+        // FNV-1a, only used to catch truncated or corrupted files
+        uint64_t checksum(const std::vector<char>& data) {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (char byte : data) {
+                hash ^= static_cast<uint8_t>(byte);
+                hash *= 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        // Returns the driver's blob if the file at path was written by this device and driver, otherwise nothing
+        std::vector<char> load_blob(PipelineCache& cache) {
+            std::ifstream file(cache.path, std::ios::binary);
+            if (!file.is_open()) {
+                return {};
+            }
+
+            FileHeader header = {};
+            if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+                printf("Ignoring pipeline cache %s, it isn't a pipeline cache file\n", cache.path.c_str());
+                return {};
+            }
+            if (header.vendor_id != cache.vendor_id
+                || header.device_id != cache.device_id
+                || header.driver_version != cache.driver_version
+                || memcmp(header.device_uuid, cache.device_uuid.data(), VK_UUID_SIZE) != 0
+                || memcmp(header.pipeline_cache_uuid, cache.pipeline_cache_uuid.data(), VK_UUID_SIZE) != 0) {
+                printf("Ignoring pipeline cache %s, it was written by a different device or driver\n", cache.path.c_str());
+                return {};
+            }
+
+            std::vector<char> data(static_cast<size_t>(header.data_size));
+            if (!file.read(data.data(), static_cast<std::streamsize>(data.size())) || checksum(data) != header.data_checksum) {
+                printf("Ignoring pipeline cache %s, it is truncated or corrupted\n", cache.path.c_str());
+                return {};
+            }
+
+            cache.cold_creation_ms = static_cast<double>(header.cold_creation_us) / 1000.0;
+            return data;
+        }
+    }
+
+    PipelineCache init_pipeline_cache(const vk_types::Context& context, const std::string& path, vk_types::CleanupProcedures& lifetime) {
+        PipelineCache cache = {};
+        cache.device = context.device;
+        cache.path = path;
+        cache.lifetime = &lifetime;
+        cache.mutex = std::make_shared<std::mutex>();
+
+        VkPhysicalDeviceIDProperties id_properties = {};
+        id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &id_properties;
+        vkGetPhysicalDeviceProperties2(context.gpu, &properties);
+
+        cache.vendor_id = properties.properties.vendorID;
+        cache.device_id = properties.properties.deviceID;
+        cache.driver_version = properties.properties.driverVersion;
+        memcpy(cache.device_uuid.data(), id_properties.deviceUUID, VK_UUID_SIZE);
+        memcpy(cache.pipeline_cache_uuid.data(), properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+        std::vector<char> blob;
+        if (!path.empty()) {
+            blob = load_blob(cache);
+        }
+        cache.warm = !blob.empty();
+
+        VkPipelineCacheCreateInfo cache_info = {};
+        cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cache_info.pNext = nullptr;
+        cache_info.initialDataSize = blob.size();
+        cache_info.pInitialData = blob.empty() ? nullptr : blob.data();
+
+        if (vkCreatePipelineCache(context.device, &cache_info, nullptr, &cache.handle) != VK_SUCCESS) {
+            printf("Unable to create pipeline cache\n");
+            exit(EXIT_FAILURE);
+        }
+
+        VkDevice device = context.device;
+        VkPipelineCache handle = cache.handle;
+        lifetime.add([device, handle]() {
+            vkDestroyPipelineCache(device, handle, nullptr);
+        });
+
+        return cache;
+    }
+
+    std::optional<vk_types::Pipeline> find(PipelineCache& cache, const std::string& key) {
+        std::lock_guard<std::mutex> lock(*cache.mutex);
+        auto found = cache.pipelines.find(key);
+        if (found == cache.pipelines.end()) {
+            return std::nullopt;
+        }
+        cache.deduplicated_count += 1;
+        return found->second;
+    }
+
+    vk_types::Pipeline insert(PipelineCache& cache, const std::string& key, const vk_types::Pipeline& pipeline, const double creation_ms) {
+        std::lock_guard<std::mutex> lock(*cache.mutex);
+        cache.creation_ms += creation_ms;
+        auto [entry, inserted] = cache.pipelines.insert({key, pipeline});
+        if (!inserted) {
+            // Lost a race with an identical build, the first one in is the one everybody shares
+            vkDestroyPipeline(cache.device, pipeline.handle, nullptr);
+            cache.deduplicated_count += 1;
+            return entry->second;
+        }
+        cache.created_count += 1;
+
+        VkDevice device = cache.device;
+        VkPipeline handle = pipeline.handle;
+        cache.lifetime->add([device, handle]() {
+            vkDestroyPipeline(device, handle, nullptr);
+        });
+        return pipeline;
+    }
+
+    void save(const PipelineCache& cache) {
+        if (cache.path.empty()) {
+            return;
+        }
+
+        size_t data_size = 0;
+        if (vkGetPipelineCacheData(cache.device, cache.handle, &data_size, nullptr) != VK_SUCCESS) {
+            printf("Unable to query the pipeline cache size, not saving it\n");
+            return;
+        }
+        std::vector<char> data(data_size);
+        if (vkGetPipelineCacheData(cache.device, cache.handle, &data_size, data.data()) != VK_SUCCESS) {
+            printf("Unable to read back the pipeline cache, not saving it\n");
+            return;
+        }
+        data.resize(data_size);
+
+        FileHeader header = {};
+        header.magic = FILE_MAGIC;
+        header.version = FILE_VERSION;
+        header.vendor_id = cache.vendor_id;
+        header.device_id = cache.device_id;
+        header.driver_version = cache.driver_version;
+        memcpy(header.device_uuid, cache.device_uuid.data(), VK_UUID_SIZE);
+        memcpy(header.pipeline_cache_uuid, cache.pipeline_cache_uuid.data(), VK_UUID_SIZE);
+        // A cold start is the one worth remembering, warm starts just pass it along
+        double cold_creation_ms = cache.warm ? cache.cold_creation_ms : cache.creation_ms;
+        header.cold_creation_us = static_cast<uint64_t>(cold_creation_ms * 1000.0);
+        header.data_size = data.size();
+        header.data_checksum = checksum(data);
+
+        std::string temporary_path = cache.path + ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()
+                || !file.write(reinterpret_cast<const char*>(&header), sizeof(header))
+                || !file.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+                printf("Unable to write the pipeline cache to %s\n", temporary_path.c_str());
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary_path, cache.path, error);
+        if (error) {
+            printf("Unable to move the pipeline cache into place at %s: %s\n", cache.path.c_str(), error.message().c_str());
+        }
+    }
+
+    void print_report(const PipelineCache& cache) {
+        printf("Created %u pipelines with %.3fms of compile time from a %s cache, %u duplicate requests reused\n",
+            cache.created_count, cache.creation_ms, cache.warm ? "warm" : "cold", cache.deduplicated_count);
+        if (cache.warm && cache.cold_creation_ms > 0.0) {
+            printf("Cold compile time on this device and driver was %.3fms\n", cache.cold_creation_ms);
+        }
+    }
+}
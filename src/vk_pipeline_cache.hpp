@@ -0,0 +1,91 @@
+#ifndef VK_PIPELINE_CACHE_H_
+#define VK_PIPELINE_CACHE_H_
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+#include "vk_types.hpp"
+
+namespace vk_pipeline_cache {
+    struct PipelineCache {
+        VkDevice device;
+        VkPipelineCache handle;
+        // Where the blob is loaded from and saved to. Empty keeps everything in memory
+        std::string path;
+        // Identity of the device and driver, a blob from anything else is thrown away
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        std::array<uint8_t, VK_UUID_SIZE> device_uuid;
+        std::array<uint8_t, VK_UUID_SIZE> pipeline_cache_uuid;
+        // A valid blob was loaded, so creation below is warm
+        bool warm;
+        // Creation time of the last run that started without a blob, carried along in the file for comparison
+        double cold_creation_ms;
+        // Pipelines created through the cache, keyed on all of the state that went into them
+        std::unordered_map<std::string, vk_types::Pipeline> pipelines;
+        // Pipelines are owned by the cache rather than by whoever asked for them, since they may be handed out more than once
+        vk_types::CleanupProcedures* lifetime;
+        uint32_t created_count;
+        uint32_t deduplicated_count;
+        // Summed over pipelines, so with parallel builds this can be more than the wall time
+        double creation_ms;
+        // Pipelines may be built from several threads at once. The VkPipelineCache is internally synchronized, the rest goes through here
+        std::shared_ptr<std::mutex> mutex;
+    };
+
+    // Appends plain values to a pipeline key, so equal state gives byte-equal keys. Only padding free types go in, and never pointers
+    class KeyWriter {
+        private:
+        std::string bytes;
+
+        public:
+        template <typename T>
+        void add(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>, "Pipeline keys are built from plain values");
+            const char* raw = reinterpret_cast<const char*>(&value);
+            bytes.append(raw, sizeof(T));
+        }
+
+        // Non-dispatchable handles are pointers on 64 bit platforms and integers elsewhere, either way the value identifies the object
+        template <typename T>
+        void add_handle(const T handle) {
+            add(static_cast<uint64_t>((uintptr_t)handle));
+        }
+
+        // Arrays are prefixed with their length so that adjacent arrays can't alias each other
+        template <typename T>
+        void add_array(const T* values, const uint32_t count) {
+            add(count);
+            for (uint32_t index = 0; index < count; ++index) {
+                add(values[index]);
+            }
+        }
+
+        const std::string& key() const {
+            return bytes;
+        }
+    };
+
+    // Creates the VkPipelineCache, seeded from the blob at path if it was written by this device and driver. An empty path skips the disk
+    PipelineCache init_pipeline_cache(const vk_types::Context& context, const std::string& path, vk_types::CleanupProcedures& lifetime);
+
+    // Returns the pipeline created from this key earlier, if there was one. Safe to call from any thread
+    std::optional<vk_types::Pipeline> find(PipelineCache& cache, const std::string& key);
+    // Records a freshly created pipeline and how long it took, handing its destruction over to the cache. Safe to call from any thread.
+    // If another thread got the same key in first, the new pipeline is destroyed and the existing one returned
+    vk_types::Pipeline insert(PipelineCache& cache, const std::string& key, const vk_types::Pipeline& pipeline, const double creation_ms);
+
+    // Writes the blob back out alongside the device identity. Written to a temporary file first so a crash can't leave a torn cache behind
+    void save(const PipelineCache& cache);
+    void print_report(const PipelineCache& cache);
+}
+
+#endif // VK_PIPELINE_CACHE_H_
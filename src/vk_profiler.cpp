@@ -0,0 +1,543 @@
+#include "vk_profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace vk_profiler {
+    namespace {
+        const uint32_t QUERIES_PER_PASS = 2;
+        const uint32_t QUERY_COUNT = static_cast<uint32_t>(PASS_COUNT) * QUERIES_PER_PASS;
+        const uint32_t STATISTICS_QUERY_COUNT = static_cast<uint32_t>(PASS_COUNT);
+
+        uint32_t begin_query(const Pass pass) {
+            return static_cast<uint32_t>(pass) * QUERIES_PER_PASS;
+        }
+
+        uint32_t end_query(const Pass pass) {
+            return begin_query(pass) + 1;
+        }
+
+        // Label colors so the passes are easy to tell apart in a capture
+        std::array<float, 4> pass_color(const Pass pass) {
+            switch (pass) {
+                case Pass::Grid:    return { 0.2f, 0.6f, 1.0f, 1.0f };
+                case Pass::Skybox:  return { 0.4f, 0.2f, 0.8f, 1.0f };
+                case Pass::JarMask: return { 0.9f, 0.6f, 0.1f, 1.0f };
+                case Pass::DepthPrepass: return { 0.5f, 0.5f, 0.5f, 1.0f };
+                case Pass::Visibility: return { 0.2f, 0.6f, 0.6f, 1.0f };
+                case Pass::EarlyCull: return { 0.8f, 0.4f, 0.1f, 1.0f };
+                case Pass::DepthPyramid: return { 0.3f, 0.3f, 0.7f, 1.0f };
+                case Pass::LateCull: return { 0.8f, 0.5f, 0.2f, 1.0f };
+                case Pass::LateDraw: return { 0.3f, 0.7f, 0.5f, 1.0f };
+                case Pass::LightCulling: return { 0.9f, 0.8f, 0.2f, 1.0f };
+                case Pass::VisibilityShade: return { 0.1f, 0.5f, 0.2f, 1.0f };
+                case Pass::Space:   return { 0.1f, 0.8f, 0.3f, 1.0f };
+                case Pass::ComposeClassify: return { 0.7f, 0.3f, 0.4f, 1.0f };
+                case Pass::Compose: return { 0.9f, 0.2f, 0.3f, 1.0f };
+                case Pass::Blit:    return { 0.6f, 0.6f, 0.6f, 1.0f };
+                default:            return { 1.0f, 1.0f, 1.0f, 1.0f };
+            }
+        }
+
+        void add_sample(GpuProfiler& profiler, const Pass pass, const double milliseconds) {
+            PassSamples& samples = profiler.samples[static_cast<size_t>(pass)];
+            samples.run.push_back(milliseconds);
+            samples.rolling.push_back(milliseconds);
+            while (samples.rolling.size() > profiler.settings.rolling_window) {
+                samples.rolling.pop_front();
+            }
+        }
+
+        // Each query comes back as a (fragment shader invocations, availability) pair, only the one counter is enabled
+        void resolve_statistics(GpuProfiler& profiler, FrameSlot& slot) {
+            std::array<uint64_t, STATISTICS_QUERY_COUNT * 2> results = {};
+            VkResult query_result = vkGetQueryPoolResults(profiler.device, slot.statistics_query_pool, 0, STATISTICS_QUERY_COUNT, sizeof(results), results.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            if ((query_result != VK_SUCCESS) && (query_result != VK_NOT_READY)) {
+                printf("Unable to read back pipeline statistics queries, result %d\n", query_result);
+                exit(EXIT_FAILURE);
+            }
+
+            for (size_t pass_index = 0; pass_index < PASS_COUNT; ++pass_index) {
+                if (!slot.statistics_recorded[pass_index] || results[pass_index * 2 + 1] == 0) {
+                    continue;
+                }
+                profiler.samples[pass_index].fragment_invocations.push_back(static_cast<double>(results[pass_index * 2]));
+            }
+            slot.statistics_recorded.fill(false);
+        }
+
+        double ticks_to_ms(const GpuProfiler& profiler, const uint64_t ticks) {
+            return static_cast<double>(ticks) * profiler.timestamp_period_ns / 1000000.0;
+        }
+
+        // Signed ticks from one timestamp to another within the valid bits, so stamps taken just before a wrap still come out earlier
+        int64_t ticks_between(const GpuProfiler& profiler, const uint64_t from, const uint64_t to) {
+            const uint64_t ticks = (to - from) & profiler.timestamp_mask;
+            return (ticks > (profiler.timestamp_mask >> 1)) ? -static_cast<int64_t>((profiler.timestamp_mask - ticks) + 1) : static_cast<int64_t>(ticks);
+        }
+
+        // Times the passes that ran on the compute queue, and how much of them fell inside the graphics frame. Timestamps from both queues
+        // come off the same device counter, so they're compared directly
+        void resolve_async(GpuProfiler& profiler, FrameSlot& slot, const std::array<uint64_t, QUERY_COUNT * 2>& graphics_results, const bool sampled) {
+            std::array<uint64_t, QUERY_COUNT * 2> results = {};
+            VkResult query_result = vkGetQueryPoolResults(profiler.device, slot.async_query_pool, 0, QUERY_COUNT, sizeof(results), results.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            if ((query_result != VK_SUCCESS) && (query_result != VK_NOT_READY)) {
+                printf("Unable to read back async timestamp queries, result %d\n", query_result);
+                exit(EXIT_FAILURE);
+            }
+
+            const uint32_t frame_begin = begin_query(Pass::Frame);
+            const uint32_t frame_end = end_query(Pass::Frame);
+            const bool frame_available = slot.recorded[static_cast<size_t>(Pass::Frame)] &&
+                (graphics_results[frame_begin * 2 + 1] != 0) && (graphics_results[frame_end * 2 + 1] != 0);
+            bool any_async = false;
+            int64_t overlap_ticks = 0;
+            for (size_t pass_index = 0; pass_index < PASS_COUNT; ++pass_index) {
+                Pass pass = static_cast<Pass>(pass_index);
+                uint32_t begin = begin_query(pass);
+                uint32_t end = end_query(pass);
+                if (!slot.async_recorded[pass_index] || (results[begin * 2 + 1] == 0) || (results[end * 2 + 1] == 0)) {
+                    continue;
+                }
+                any_async = true;
+                if (sampled) {
+                    add_sample(profiler, pass, ticks_to_ms(profiler, (results[end * 2] - results[begin * 2]) & profiler.timestamp_mask));
+                }
+                if (frame_available) {
+                    // Everything relative to the start of the graphics frame, async work that started first comes out negative
+                    const uint64_t frame_start = graphics_results[frame_begin * 2];
+                    const int64_t pass_begin = ticks_between(profiler, frame_start, results[begin * 2]);
+                    const int64_t pass_end = ticks_between(profiler, frame_start, results[end * 2]);
+                    const int64_t frame_length = ticks_between(profiler, frame_start, graphics_results[frame_end * 2]);
+                    overlap_ticks += std::max<int64_t>(0, std::min(pass_end, frame_length) - std::max<int64_t>(pass_begin, 0));
+                }
+            }
+            slot.async_recorded.fill(false);
+            if (sampled && any_async && frame_available) {
+                profiler.async_overlap.push_back(ticks_to_ms(profiler, static_cast<uint64_t>(overlap_ticks)));
+            }
+        }
+
+        // Pulls results for a slot that has finished executing. Queries that aren't available are skipped rather than waited on
+        void resolve_slot(GpuProfiler& profiler, FrameSlot& slot) {
+            if (!slot.pending) {
+                return;
+            }
+            slot.pending = false;
+            // Frames before first_sampled_frame still update the latest frame time, they just aren't kept as samples
+            const bool sampled = slot.frame_num >= profiler.first_sampled_frame;
+
+            if (profiler.settings.pipeline_statistics && sampled) {
+                resolve_statistics(profiler, slot);
+            }
+            slot.statistics_recorded.fill(false);
+            if (!profiler.settings.timing) {
+                profiler.frames_resolved += sampled ? 1 : 0;
+                return;
+            }
+
+            // Each query comes back as a (timestamp, availability) pair
+            std::array<uint64_t, QUERY_COUNT * 2> results = {};
+            VkResult query_result = vkGetQueryPoolResults(profiler.device, slot.query_pool, 0, QUERY_COUNT, sizeof(results), results.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            if ((query_result != VK_SUCCESS) && (query_result != VK_NOT_READY)) {
+                printf("Unable to read back timestamp queries, result %d\n", query_result);
+                exit(EXIT_FAILURE);
+            }
+
+            for (size_t pass_index = 0; pass_index < PASS_COUNT; ++pass_index) {
+                Pass pass = static_cast<Pass>(pass_index);
+                if (!slot.recorded[pass_index]) {
+                    continue;
+                }
+                uint32_t begin = begin_query(pass);
+                uint32_t end = end_query(pass);
+                bool available = (results[begin * 2 + 1] != 0) && (results[end * 2 + 1] != 0);
+                if (!available) {
+                    continue;
+                }
+                // Masking the difference handles counters that wrap within their valid bits
+                uint64_t ticks = (results[end * 2] - results[begin * 2]) & profiler.timestamp_mask;
+                double milliseconds = ticks_to_ms(profiler, ticks);
+                if (pass == Pass::Frame) {
+                    profiler.latest_frame_ms = milliseconds;
+                    profiler.latest_frame_num = slot.frame_num;
+                }
+                if (sampled) {
+                    add_sample(profiler, pass, milliseconds);
+                }
+            }
+            if (profiler.async_timing) {
+                resolve_async(profiler, slot, results, sampled);
+            }
+            slot.recorded.fill(false);
+            if (!sampled) {
+                return;
+            }
+
+            profiler.frames_resolved += 1;
+            if ((profiler.settings.report_interval > 0) && (profiler.frames_resolved % profiler.settings.report_interval == 0)) {
+                print_report(profiler, true);
+            }
+        }
+    }
+
+    const char* pass_name(const Pass pass) {
+        switch (pass) {
+            case Pass::Grid:    return "grid";
+            case Pass::Skybox:  return "skybox";
+            case Pass::JarMask: return "jar_mask";
+            case Pass::DepthPrepass: return "depth_prepass";
+            case Pass::Visibility: return "visibility";
+            case Pass::EarlyCull: return "early_cull";
+            case Pass::DepthPyramid: return "depth_pyramid";
+            case Pass::LateCull: return "late_cull";
+            case Pass::LateDraw: return "late_draw";
+            case Pass::LightCulling: return "light_culling";
+            case Pass::VisibilityShade: return "visibility_shade";
+            case Pass::Space:   return "space";
+            case Pass::ComposeClassify: return "compose_classify";
+            case Pass::Compose: return "compose";
+            case Pass::Blit:    return "blit";
+            case Pass::Frame:   return "frame";
+            default:            return "unknown";
+        }
+    }
+
+    std::vector<const char*> optional_instance_extensions() {
+        uint32_t extension_count = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
+        std::vector<VkExtensionProperties> available_extensions(extension_count);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, available_extensions.data());
+
+        std::vector<const char*> extensions;
+        for (const auto& extension : available_extensions) {
+            if (strcmp(extension.extensionName, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0) {
+                extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+            }
+        }
+        return extensions;
+    }
+
+    GpuProfiler init_profiler(const vk_types::Context& context, const Settings& settings, vk_types::CleanupProcedures& lifetime) {
+        GpuProfiler profiler = {};
+        profiler.device = context.device;
+        profiler.settings = settings;
+        profiler.frames_resolved = 0;
+        profiler.first_sampled_frame = 0;
+        profiler.latest_frame_ms = -1.0;
+        profiler.latest_frame_num = 0;
+
+        VkPhysicalDeviceProperties props = {};
+        vkGetPhysicalDeviceProperties(context.gpu, &props);
+        profiler.device_name = props.deviceName;
+        profiler.timestamp_period_ns = static_cast<double>(props.limits.timestampPeriod);
+
+        // Timestamps are only meaningful up to the queue family's valid bits, a count of 0 means no timestamp support at all
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, queue_families.data());
+        uint32_t valid_bits = queue_families[context.queues.graphics_family_index].timestampValidBits;
+        if (profiler.settings.timing && valid_bits == 0) {
+            printf("Graphics queue does not support timestamps, GPU pass timing disabled\n");
+            profiler.settings.timing = false;
+        }
+        profiler.timestamp_mask = (valid_bits >= 64) ? ~0ULL : ((1ULL << valid_bits) - 1);
+        // Both queues' timestamps go through the one mask, so the compute queue needs at least as many valid bits
+        if (profiler.settings.timing && profiler.settings.async_compute && (context.queues.compute != VK_NULL_HANDLE)) {
+            uint32_t compute_valid_bits = queue_families[context.queues.compute_family_index].timestampValidBits;
+            profiler.async_timing = compute_valid_bits >= valid_bits;
+            if (!profiler.async_timing) {
+                printf("Compute queue timestamps are narrower than the graphics queue's, async compute passes won't be timed\n");
+            }
+        }
+
+        // The device is created with pipeline statistics whenever they're supported
+        VkPhysicalDeviceFeatures features = {};
+        vkGetPhysicalDeviceFeatures(context.gpu, &features);
+        if (profiler.settings.pipeline_statistics && !features.pipelineStatisticsQuery) {
+            printf("Device does not support pipeline statistics queries, fragment invocation counts disabled\n");
+            profiler.settings.pipeline_statistics = false;
+        }
+
+        if (profiler.settings.timing || profiler.settings.pipeline_statistics) {
+            profiler.slots.resize(context.buffer_count, FrameSlot{});
+        }
+
+        if (profiler.settings.timing) {
+            VkQueryPoolCreateInfo query_pool_info = {};
+            query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_pool_info.pNext = nullptr;
+            query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_pool_info.queryCount = QUERY_COUNT;
+
+            for (size_t slot_index = 0; slot_index < profiler.slots.size(); ++slot_index) {
+                if (vkCreateQueryPool(context.device, &query_pool_info, nullptr, &(profiler.slots[slot_index].query_pool)) != VK_SUCCESS) {
+                    printf("Unable to create timestamp query pool for frame %zu\n", slot_index);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            VkDevice device = context.device;
+            std::vector<FrameSlot> slots = profiler.slots;
+            lifetime.add([device, slots]() {
+                for (auto& slot : slots) {
+                    vkDestroyQueryPool(device, slot.query_pool, nullptr);
+                }
+            });
+        }
+
+        if (profiler.async_timing) {
+            VkQueryPoolCreateInfo query_pool_info = {};
+            query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_pool_info.pNext = nullptr;
+            query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_pool_info.queryCount = QUERY_COUNT;
+
+            for (size_t slot_index = 0; slot_index < profiler.slots.size(); ++slot_index) {
+                if (vkCreateQueryPool(context.device, &query_pool_info, nullptr, &(profiler.slots[slot_index].async_query_pool)) != VK_SUCCESS) {
+                    printf("Unable to create async timestamp query pool for frame %zu\n", slot_index);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            VkDevice device = context.device;
+            std::vector<FrameSlot> slots = profiler.slots;
+            lifetime.add([device, slots]() {
+                for (auto& slot : slots) {
+                    vkDestroyQueryPool(device, slot.async_query_pool, nullptr);
+                }
+            });
+        }
+
+        if (profiler.settings.pipeline_statistics) {
+            VkQueryPoolCreateInfo statistics_pool_info = {};
+            statistics_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            statistics_pool_info.pNext = nullptr;
+            statistics_pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            statistics_pool_info.queryCount = STATISTICS_QUERY_COUNT;
+            statistics_pool_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+            for (size_t slot_index = 0; slot_index < profiler.slots.size(); ++slot_index) {
+                if (vkCreateQueryPool(context.device, &statistics_pool_info, nullptr, &(profiler.slots[slot_index].statistics_query_pool)) != VK_SUCCESS) {
+                    printf("Unable to create pipeline statistics query pool for frame %zu\n", slot_index);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            VkDevice device = context.device;
+            std::vector<FrameSlot> slots = profiler.slots;
+            lifetime.add([device, slots]() {
+                for (auto& slot : slots) {
+                    vkDestroyQueryPool(device, slot.statistics_query_pool, nullptr);
+                }
+            });
+        }
+
+        if (settings.debug_labels) {
+            profiler.begin_label = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(context.instance, "vkCmdBeginDebugUtilsLabelEXT"));
+            profiler.end_label = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(context.instance, "vkCmdEndDebugUtilsLabelEXT"));
+        }
+
+        return profiler;
+    }
+
+    void begin_frame(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot, const uint64_t frame_num) {
+        if (profiler.slots.empty()) {
+            return;
+        }
+        FrameSlot& slot = profiler.slots[frame_slot];
+        resolve_slot(profiler, slot);
+
+        slot.pending = true;
+        slot.frame_num = frame_num;
+        slot.async_cmd = VK_NULL_HANDLE;
+        if (profiler.settings.pipeline_statistics) {
+            vkCmdResetQueryPool(cmd, slot.statistics_query_pool, 0, STATISTICS_QUERY_COUNT);
+        }
+        if (profiler.settings.timing) {
+            vkCmdResetQueryPool(cmd, slot.query_pool, 0, QUERY_COUNT);
+            vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, slot.query_pool, begin_query(Pass::Frame));
+        }
+    }
+
+    void end_frame(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot) {
+        if (!profiler.settings.timing) {
+            return;
+        }
+        FrameSlot& slot = profiler.slots[frame_slot];
+        vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, slot.query_pool, end_query(Pass::Frame));
+        slot.recorded[static_cast<size_t>(Pass::Frame)] = true;
+    }
+
+    void begin_async_frame(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot) {
+        if (profiler.slots.empty()) {
+            return;
+        }
+        FrameSlot& slot = profiler.slots[frame_slot];
+        slot.async_cmd = cmd;
+        if (profiler.async_timing) {
+            vkCmdResetQueryPool(cmd, slot.async_query_pool, 0, QUERY_COUNT);
+        }
+    }
+
+    void begin_pass(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot, const Pass pass) {
+        if (profiler.begin_label != nullptr) {
+            VkDebugUtilsLabelEXT label = {};
+            label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+            label.pNext = nullptr;
+            label.pLabelName = pass_name(pass);
+            std::array<float, 4> color = pass_color(pass);
+            std::memcpy(label.color, color.data(), sizeof(label.color));
+            profiler.begin_label(cmd, &label);
+        }
+        const bool async = !profiler.slots.empty() && (cmd == profiler.slots[frame_slot].async_cmd);
+        if (async) {
+            if (profiler.async_timing) {
+                vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, profiler.slots[frame_slot].async_query_pool, begin_query(pass));
+            }
+            return;
+        }
+        if (profiler.settings.timing) {
+            vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, profiler.slots[frame_slot].query_pool, begin_query(pass));
+        }
+        if (profiler.settings.pipeline_statistics) {
+            vkCmdBeginQuery(cmd, profiler.slots[frame_slot].statistics_query_pool, static_cast<uint32_t>(pass), 0);
+        }
+    }
+
+    void end_pass(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot, const Pass pass) {
+        const bool async = !profiler.slots.empty() && (cmd == profiler.slots[frame_slot].async_cmd);
+        if (async) {
+            if (profiler.async_timing) {
+                FrameSlot& slot = profiler.slots[frame_slot];
+                vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, slot.async_query_pool, end_query(pass));
+                slot.async_recorded[static_cast<size_t>(pass)] = true;
+            }
+        }
+        else if (profiler.settings.pipeline_statistics) {
+            FrameSlot& slot = profiler.slots[frame_slot];
+            vkCmdEndQuery(cmd, slot.statistics_query_pool, static_cast<uint32_t>(pass));
+            slot.statistics_recorded[static_cast<size_t>(pass)] = true;
+        }
+        if (!async && profiler.settings.timing) {
+            FrameSlot& slot = profiler.slots[frame_slot];
+            vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, slot.query_pool, end_query(pass));
+            slot.recorded[static_cast<size_t>(pass)] = true;
+        }
+        if (profiler.end_label != nullptr) {
+            profiler.end_label(cmd);
+        }
+    }
+
+    void resolve_outstanding(GpuProfiler& profiler, const size_t next_frame_slot) {
+        if (profiler.slots.empty()) {
+            return;
+        }
+        // The slot about to be used next holds the oldest submission
+        for (size_t offset = 0; offset < profiler.slots.size(); ++offset) {
+            resolve_slot(profiler, profiler.slots[(next_frame_slot + offset) % profiler.slots.size()]);
+        }
+    }
+
+    frame_stats::Summary summarize_pass(const GpuProfiler& profiler, const Pass pass, const bool rolling) {
+        const PassSamples& samples = profiler.samples[static_cast<size_t>(pass)];
+        if (rolling) {
+            return frame_stats::summarize(std::vector<double>(samples.rolling.begin(), samples.rolling.end()));
+        }
+        return frame_stats::summarize(samples.run);
+    }
+
+    frame_stats::Summary summarize_fragment_invocations(const GpuProfiler& profiler, const Pass pass) {
+        return frame_stats::summarize(profiler.samples[static_cast<size_t>(pass)].fragment_invocations);
+    }
+
+    frame_stats::Summary summarize_async_overlap(const GpuProfiler& profiler) {
+        return frame_stats::summarize(profiler.async_overlap);
+    }
+
+    void print_report(const GpuProfiler& profiler, const bool rolling) {
+        // Invocation counts are only kept for the whole run, so they're left out of the rolling printouts
+        if (profiler.settings.pipeline_statistics && !rolling) {
+            printf("Fragment shader invocations per frame:\n");
+            for (size_t pass_index = 0; pass_index < PASS_COUNT; ++pass_index) {
+                Pass pass = static_cast<Pass>(pass_index);
+                frame_stats::Summary summary = summarize_fragment_invocations(profiler, pass);
+                if (summary.count == 0) {
+                    continue;
+                }
+                printf("%-16s n=%-6zu mean %.0f  min %.0f  max %.0f\n", pass_name(pass), summary.count, summary.mean, summary.min, summary.max);
+            }
+        }
+        if (!profiler.settings.timing) {
+            return;
+        }
+        if (rolling) {
+            printf("GPU pass times, last %zu frames as of frame %llu:\n", profiler.settings.rolling_window, static_cast<unsigned long long>(profiler.frames_resolved));
+        }
+        else {
+            printf("GPU pass times, all %llu frames:\n", static_cast<unsigned long long>(profiler.frames_resolved));
+        }
+        for (size_t pass_index = 0; pass_index < PASS_COUNT; ++pass_index) {
+            Pass pass = static_cast<Pass>(pass_index);
+            frame_stats::Summary summary = summarize_pass(profiler, pass, rolling);
+            // Passes that never ran, like the blit when headless, are left out
+            if (summary.count == 0) {
+                continue;
+            }
+            frame_stats::print_summary(pass_name(pass), "ms", summary);
+        }
+        // Like invocation counts, overlap is only kept for the whole run
+        frame_stats::Summary overlap = summarize_async_overlap(profiler);
+        if (!rolling && overlap.count > 0) {
+            frame_stats::print_summary("async overlap", "ms", overlap);
+        }
+    }
+
+    void write_json(const GpuProfiler& profiler, const std::string& path) {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            printf("Unable to open %s for writing the GPU profile\n", path.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"device\": ");
+        frame_stats::write_json_string(file, profiler.device_name);
+        fprintf(file, ",\n");
+        fprintf(file, "  \"frames_in_flight\": %zu,\n", profiler.slots.size());
+        fprintf(file, "  \"frames\": %llu,\n", static_cast<unsigned long long>(profiler.frames_resolved));
+        fprintf(file, "  \"rolling_window\": %zu,\n", profiler.settings.rolling_window);
+        fprintf(file, "  \"units\": \"ms\",\n");
+        fprintf(file, "  \"passes\": {");
+        bool first = true;
+        for (size_t pass_index = 0; pass_index < PASS_COUNT; ++pass_index) {
+            Pass pass = static_cast<Pass>(pass_index);
+            frame_stats::Summary run = summarize_pass(profiler, pass, false);
+            if (run.count == 0) {
+                continue;
+            }
+            fprintf(file, "%s\n    \"%s\": {\n      \"rolling\": ", first ? "" : ",", pass_name(pass));
+            frame_stats::write_summary_json(file, summarize_pass(profiler, pass, true));
+            fprintf(file, ",\n      \"run\": ");
+            frame_stats::write_summary_json(file, run);
+            frame_stats::Summary fragment_invocations = summarize_fragment_invocations(profiler, pass);
+            if (fragment_invocations.count > 0) {
+                fprintf(file, ",\n      \"fragment_invocations\": ");
+                frame_stats::write_summary_json(file, fragment_invocations);
+            }
+            fprintf(file, "\n    }");
+            first = false;
+        }
+        fprintf(file, "\n  }");
+        frame_stats::Summary overlap = summarize_async_overlap(profiler);
+        if (overlap.count > 0) {
+            fprintf(file, ",\n  \"async_overlap\": ");
+            frame_stats::write_summary_json(file, overlap);
+        }
+        fprintf(file, "\n}\n");
+        fclose(file);
+    }
+}
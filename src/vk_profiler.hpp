@@ -0,0 +1,132 @@
+#ifndef VK_PROFILER_H_
+#define VK_PROFILER_H_
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "vk_types.hpp"
+#include "frame_stats.hpp"
+
+namespace vk_profiler {
+    // Passes of a frame that get timed. Frame covers the whole command buffer
+    enum class Pass : uint32_t {
+        Grid = 0,
+        Skybox,
+        JarMask,
+        DepthPrepass,
+        Visibility,
+        EarlyCull,
+        DepthPyramid,
+        LateCull,
+        LateDraw,
+        LightCulling,
+        VisibilityShade,
+        Space,
+        ComposeClassify,
+        Compose,
+        Blit,
+        Frame,
+        Count
+    };
+
+    constexpr size_t PASS_COUNT = static_cast<size_t>(Pass::Count);
+
+    const char* pass_name(const Pass pass);
+
+    struct Settings {
+        // Record timestamps. Debug labels are emitted regardless
+        bool timing;
+        // Count fragment shader invocations per pass with pipeline statistics queries. Needs the pipelineStatisticsQuery feature
+        bool pipeline_statistics;
+        // Emit debug utils labels, requires VK_EXT_debug_utils to be enabled on the instance
+        bool debug_labels;
+        // Number of most recent frames that make up the rolling statistics
+        size_t rolling_window;
+        // Print the rolling statistics every this many resolved frames. 0 disables periodic printing
+        uint64_t report_interval;
+        // Time passes recorded on the compute queue. Only set when the renderer records work there, the async timestamps are only reset then
+        bool async_compute;
+    };
+
+    struct PassSamples {
+        // Milliseconds, most recent last
+        std::deque<double> rolling;
+        std::vector<double> run;
+        // Fragment shader invocations per frame over the whole run, when pipeline statistics are on
+        std::vector<double> fragment_invocations;
+    };
+
+    // Timestamp queries for one frame in flight. Two queries per pass, begin then end
+    struct FrameSlot {
+        VkQueryPool query_pool;
+        std::array<bool, PASS_COUNT> recorded;
+        // One pipeline statistics query per pass. Frame is left out since queries of the same type can't nest
+        VkQueryPool statistics_query_pool;
+        std::array<bool, PASS_COUNT> statistics_recorded;
+        // Timestamps of passes recorded into async_cmd, which runs on the compute queue. Only created when that queue supports timestamps
+        VkQueryPool async_query_pool;
+        std::array<bool, PASS_COUNT> async_recorded;
+        VkCommandBuffer async_cmd;
+        // Submitted but not yet read back
+        bool pending;
+        uint64_t frame_num;
+    };
+
+    struct GpuProfiler {
+        VkDevice device;
+        std::string device_name;
+        Settings settings;
+        double timestamp_period_ns;
+        uint64_t timestamp_mask;
+        // Whether async_query_pool exists in each slot
+        bool async_timing;
+        std::vector<FrameSlot> slots;
+        std::array<PassSamples, PASS_COUNT> samples;
+        // Milliseconds per frame that async compute passes ran while the graphics queue was working on the same frame
+        std::vector<double> async_overlap;
+        uint64_t frames_resolved;
+        // Frames before this one are read back but not sampled, e.g. to leave out a warmup
+        uint64_t first_sampled_frame;
+        // GPU time of the most recently resolved frame and which frame that was, warmup included. Negative until the first one comes back
+        double latest_frame_ms;
+        uint64_t latest_frame_num;
+        PFN_vkCmdBeginDebugUtilsLabelEXT begin_label;
+        PFN_vkCmdEndDebugUtilsLabelEXT end_label;
+    };
+
+    // Instance extensions the profiler can make use of, filtered down to the ones that are actually available
+    std::vector<const char*> optional_instance_extensions();
+
+    // Builds query pools per frame in flight. Timing is switched off with a warning if the graphics queue doesn't support timestamps,
+    // and likewise pipeline statistics if the device doesn't support them. Async compute passes are only timed when the compute queue has timestamps too
+    GpuProfiler init_profiler(const vk_types::Context& context, const Settings& settings, vk_types::CleanupProcedures& lifetime);
+
+    // Reads back the last results recorded into this frame slot, then resets its queries. The slot's fence must have already been waited on.
+    // Never blocks on the GPU
+    void begin_frame(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot, const uint64_t frame_num);
+    void end_frame(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot);
+    // Resets the async timestamps of a slot in a command buffer bound for the compute queue. After begin_frame, which reads the last ones back.
+    // Passes begun in this command buffer are timed against the async pool, and never get statistics queries
+    void begin_async_frame(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot);
+
+    // Brackets a pass with timestamps, a statistics query, and a debug label. Must be called outside of dynamic rendering
+    void begin_pass(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot, const Pass pass);
+    void end_pass(GpuProfiler& profiler, const VkCommandBuffer cmd, const size_t frame_slot, const Pass pass);
+
+    // Reads back every outstanding frame, oldest first starting from next_frame_slot. The device must be idle
+    void resolve_outstanding(GpuProfiler& profiler, const size_t next_frame_slot);
+
+    // Summarizes either the rolling window or the whole run for a pass
+    frame_stats::Summary summarize_pass(const GpuProfiler& profiler, const Pass pass, const bool rolling);
+    // Summarizes fragment shader invocations per frame for a pass over the whole run
+    frame_stats::Summary summarize_fragment_invocations(const GpuProfiler& profiler, const Pass pass);
+    // Summarizes how long async compute overlapped graphics per frame over the whole run
+    frame_stats::Summary summarize_async_overlap(const GpuProfiler& profiler);
+    void print_report(const GpuProfiler& profiler, const bool rolling);
+    void write_json(const GpuProfiler& profiler, const std::string& path);
+}
+
+#endif // VK_PROFILER_H_
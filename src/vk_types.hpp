@@ -2,8 +2,10 @@
 #define VK_TYPES_H_
 
 #include "vk_mem_alloc.h"
+#include "range_allocator.hpp"
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
+#include <array>
 #include <vector>
 #include <span>
 #include <deque>
@@ -52,17 +54,36 @@ namespace vk_types {
         VmaAllocationInfo info;
     };
 
-    struct GpuVertexAttribute {
+    // A device local buffer that shaders read directly through its address
+    struct AddressedBuffer {
+        AllocatedBuffer buffer;
+        VkDeviceAddress address;
+    };
+
+    // Every model's vertices and indices, sub-allocated out of one vertex buffer and one index buffer so a pass binds them once.
+    // The vertex buffer holds a stream per attribute, each vertex_ranges.capacity long, so a model's vertices sit at the same index in all of them
+    struct GeometryArena {
         AllocatedBuffer vertex_buffer;
+        AllocatedBuffer index_buffer;
         VkDeviceAddress vertex_buffer_address;
+        VkDeviceAddress index_buffer_address;
+        // Where the position, normal and texture coordinate streams start in the vertex buffer
+        std::array<VkDeviceSize, 3> stream_offsets;
+        range_allocator::RangeAllocator vertex_ranges;
+        range_allocator::RangeAllocator index_ranges;
     };
 
+    // One piece's slice of the geometry arena. Its indices count from its model's first vertex, which vertex_offset places in the arena
     struct GpuMeshBuffers {
-        AllocatedBuffer index_buffer;
-        GpuVertexAttribute position_buffer;
-        GpuVertexAttribute normal_buffer;
-        GpuVertexAttribute texture_coordinate_buffer;
+        uint32_t first_index;
         uint32_t index_count;
+        int32_t vertex_offset;
+        // Lets the visibility buffer's shading pass fetch a triangle's indices itself
+        VkDeviceAddress index_buffer_address;
+        // The model's first vertex in each stream, so the piece's own indices can be used on them as is
+        VkDeviceAddress position_buffer_address;
+        VkDeviceAddress normal_buffer_address;
+        VkDeviceAddress texture_coordinate_buffer_address;
     };
 
     template <class T>
@@ -113,6 +134,8 @@ namespace vk_types {
         VkExtent2D extent;
         std::vector<VkImage> images;
         std::vector<VkImageView> views;
+        // Images were created with storage usage, so compute can write them directly
+        bool storage;
     };
 
     struct Command {
@@ -123,17 +146,29 @@ namespace vk_types {
     struct Queues {
         VkQueue graphics;
         VkQueue presentation;
+        uint32_t graphics_family_index;
+        // From a family with compute but no graphics, so its work can run alongside rasterization. Null when the device has no such family
+        VkQueue compute;
+        uint32_t compute_family_index;
     };
 
     struct Pipeline {
         VkPipeline handle;
         VkPipelineLayout layout;
         VkPipelineBindPoint bind_point;
+        // Compute only, the local size given to the shader's specialization constants
+        VkExtent2D workgroup_size;
+        // Graphics only. The vertex shader reads its attributes through buffer addresses in push constants, so no vertex buffers get bound
+        bool pulls_vertices;
     };
 
     struct Synchronization {
         VkSemaphore swapchain_semaphore;
         VkSemaphore render_semaphore;
+        // Signaled by the frame's async compute submission, waited on by its graphics submission. The render fence covers both
+        VkSemaphore compute_semaphore;
+        // Signaled by the frame's graphics submission once it's done reading what async compute wrote, waited on by the next frame's compute submission
+        VkSemaphore graphics_semaphore;
         VkFence render_fence;
     };
 
@@ -146,12 +181,18 @@ namespace vk_types {
         Swapchain swapchain;
         Queues queues;
         std::vector<Command> command;
+        // One per frame in flight on the compute queue's family, empty without a compute queue
+        std::vector<Command> compute_command;
+        // One per frame in flight on the graphics queue's family, for the part of the frame that waits on async compute. Empty without a compute queue
+        std::vector<Command> compose_command;
         Command command_immediate;
         std::vector<Synchronization> synchronization;
         VkFence fence_immediate;
         VmaAllocator allocator;
         vk_descriptors::MegaDescriptorSet mega_descriptor_set;
         uint8_t buffer_count;
+        // Empty until vk_buffer::init_geometry_arena, which has to come before any model is uploaded
+        GeometryArena geometry;
     };
 
     struct DescriptorAllocator {
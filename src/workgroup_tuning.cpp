@@ -0,0 +1,88 @@
+#include "workgroup_tuning.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace workgroup_tuning {
+    namespace {
+        // Sizes that win on one driver version can lose on the next, so the driver is part of the key
+        std::string device_key(const VkPhysicalDevice gpu) {
+            VkPhysicalDeviceProperties properties = {};
+            vkGetPhysicalDeviceProperties(gpu, &properties);
+            return std::to_string(properties.vendorID) + ":" + std::to_string(properties.deviceID) + ":" + std::to_string(properties.driverVersion);
+        }
+    }
+
+    WorkgroupSizes default_sizes() {
+        return WorkgroupSizes { DEFAULT_SIZE, DEFAULT_SIZE };
+    }
+
+    bool fits_device_limits(const VkPhysicalDevice gpu, const VkExtent2D size) {
+        VkPhysicalDeviceProperties properties = {};
+        vkGetPhysicalDeviceProperties(gpu, &properties);
+        const VkPhysicalDeviceLimits& limits = properties.limits;
+        return size.width > 0 && size.height > 0
+            && size.width <= limits.maxComputeWorkGroupSize[0]
+            && size.height <= limits.maxComputeWorkGroupSize[1]
+            && size.width * size.height <= limits.maxComputeWorkGroupInvocations;
+    }
+
+    // One line per device: <vendor>:<device>:<driver> <grid width> <grid height> <compose width> <compose height>
+    std::optional<WorkgroupSizes> load(const std::string& path, const VkPhysicalDevice gpu) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return std::nullopt;
+        }
+
+        const std::string key = device_key(gpu);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream tokens(line);
+            std::string line_key;
+            WorkgroupSizes sizes = {};
+            if (!(tokens >> line_key) || line_key != key) {
+                continue;
+            }
+            if (!(tokens >> sizes.grid.width >> sizes.grid.height >> sizes.compose.width >> sizes.compose.height)
+                || !fits_device_limits(gpu, sizes.grid)
+                || !fits_device_limits(gpu, sizes.compose)) {
+                printf("Ignoring malformed workgroup sizes for this device in %s\n", path.c_str());
+                return std::nullopt;
+            }
+            return sizes;
+        }
+        return std::nullopt;
+    }
+
+    void save(const std::string& path, const VkPhysicalDevice gpu, const WorkgroupSizes& sizes) {
+        const std::string key = device_key(gpu);
+
+        // Carry over everybody else's entries
+        std::vector<std::string> kept_lines;
+        {
+            std::ifstream existing(path);
+            std::string line;
+            while (std::getline(existing, line)) {
+                std::istringstream tokens(line);
+                std::string line_key;
+                if ((tokens >> line_key) && line_key != key) {
+                    kept_lines.push_back(line);
+                }
+            }
+        }
+
+        std::ofstream file(path, std::ios::trunc);
+        if (!file.is_open()) {
+            printf("Unable to write workgroup sizes to %s\n", path.c_str());
+            return;
+        }
+        for (const auto& line : kept_lines) {
+            file << line << "\n";
+        }
+        file << key << " "
+            << sizes.grid.width << " " << sizes.grid.height << " "
+            << sizes.compose.width << " " << sizes.compose.height << "\n";
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef WORKGROUP_TUNING_H_
+#define WORKGROUP_TUNING_H_
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <optional>
+#include <string>
+
+// Compute workgroup sizes, picked per device by timing candidates and remembered between runs
+namespace workgroup_tuning {
+    struct WorkgroupSizes {
+        VkExtent2D grid;
+        VkExtent2D compose;
+    };
+
+    // What the shaders were written against before sizes became tunable
+    constexpr VkExtent2D DEFAULT_SIZE = { 16, 16 };
+    constexpr std::array<VkExtent2D, 4> CANDIDATES = {{ { 8, 8 }, { 16, 16 }, { 32, 8 }, { 64, 1 } }};
+
+    WorkgroupSizes default_sizes();
+
+    // Whether the device can run a workgroup of this size at all
+    bool fits_device_limits(const VkPhysicalDevice gpu, const VkExtent2D size);
+
+    // Looks up the sizes saved for this device and driver. Nothing if the file or the entry doesn't exist, or is malformed
+    std::optional<WorkgroupSizes> load(const std::string& path, const VkPhysicalDevice gpu);
+    // Saves the sizes for this device and driver, keeping entries for any others
+    void save(const std::string& path, const VkPhysicalDevice gpu, const WorkgroupSizes& sizes);
+}
+
+#endif // WORKGROUP_TUNING_H_